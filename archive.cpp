@@ -0,0 +1,369 @@
+#include "archive.h"
+#include "byte_order.h"
+#include "compression.h"
+#include "crc32c.h"
+#include "file.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[4] = {'R', 'G', 'R', 'A'};
+const char TRAILER_MAGIC[4] = {'R', 'G', 'R', 'I'};
+const uint16_t VERSION = 2;
+const size_t HEADER_SIZE = 40;  // магия, версия, шифр, флаги, соль и проверка ключа
+const uint16_t LEGACY_VERSION = 1;
+const size_t LEGACY_HEADER_SIZE = 16; // вместо соли и проверки - 64-битный отпечаток ключа
+const size_t TRAILER_SIZE = 32; // смещение и размер индекса, число записей, CRC32C индекса, магия
+const size_t ENTRY_FIXED_SIZE = 2 + 1 + 4 * 8 + 2 * 4; // запись индекса без имени
+const uint8_t FLAG_CRC32C = 1;
+const uint8_t ENTRY_COMPRESSED = 1;
+
+// Пачка упаковки: файлы пачки читаются и шифруются параллельно, затем
+// записываются в архив подряд; размер пачки ограничивает память
+const size_t BATCH_FILES = 4096;
+const uint64_t BATCH_BYTES = 64 << 20;
+const size_t WRITE_BUFFER = 4 << 20;
+
+string headerBytes(ContainerCipher cipher, uint8_t flags, const KeyCheck& check) {
+    string out(MAGIC, sizeof(MAGIC));
+    putLE(out, VERSION, 2);
+    out += static_cast<char>(cipher);
+    out += static_cast<char>(flags);
+    out.append(reinterpret_cast<const char*>(check.salt.data()), check.salt.size());
+    out.append(reinterpret_cast<const char*>(check.value.data()), check.value.size());
+    return out;
+}
+
+void putIndexEntry(string& out, const ArchiveEntry& entry) {
+    putLE(out, entry.name.size(), 2);
+    out += entry.name;
+    out += static_cast<char>(entry.compressed ? ENTRY_COMPRESSED : 0);
+    putLE(out, entry.dataOffset, 8);
+    putLE(out, entry.cipherLength, 8);
+    putLE(out, entry.plainLength, 8);
+    putLE(out, entry.streamOffset, 8);
+    putLE(out, entry.padding, 4);
+    putLE(out, entry.checksum, 4);
+}
+
+void checkKey(const ContainerKey& key, const ArchiveIndex& index) {
+    if (key.cipher != index.cipher) throw invalid_argument("Шифр ключа не совпадает с шифром архива");
+    if (!keyMatchesCheck(key, index.keyCheck)) throw invalid_argument("Ключ не подходит к архиву");
+}
+
+} // namespace
+
+void scanArchiveInputs(const vector<string>& inputs, vector<ArchiveSource>& sources, vector<string>& errors) {
+    for (const string& input : inputs) {
+        error_code ec;
+        if (fs::is_regular_file(input, ec)) {
+            sources.push_back({input, fs::path(input).filename().generic_string(), fs::file_size(input, ec)});
+            continue;
+        }
+        if (!fs::is_directory(input, ec)) {
+            errors.push_back(input + ": файл или каталог не найден");
+            continue;
+        }
+        fs::path base = fs::path(input).lexically_normal();
+        if (!base.has_filename()) base = base.parent_path(); //"каталог/"
+        fs::path prefix = base.filename() == "." || base.filename() == ".." ? fs::path() : base.filename();
+        size_t first = sources.size();
+        for (auto it = fs::recursive_directory_iterator(base, fs::directory_options::skip_permission_denied);
+             it != fs::recursive_directory_iterator(); ++it) {
+            if (!it->is_regular_file(ec)) continue;
+            ArchiveSource source;
+            source.path = it->path().string();
+            source.name = (prefix / it->path().lexically_relative(base)).generic_string();
+            source.size = it->file_size(ec);
+            sources.push_back(move(source));
+        }
+        sort(sources.begin() + first, sources.end(),
+             [](const ArchiveSource& a, const ArchiveSource& b) { return a.name < b.name; });
+    }
+}
+
+bool safeEntryName(const string& name) {
+    if (name.empty()) return false;
+    fs::path path(name);
+    if (path.is_absolute() || path.has_root_name()) return false;
+    for (const fs::path& part : path) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
+bool isArchive(const char* data, size_t size) {
+    return size >= sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+ArchiveIndex parseArchiveIndex(const char* data, size_t size) {
+    if (!isArchive(data, size)) throw runtime_error("Файл не является архивом");
+    if (size < LEGACY_HEADER_SIZE + TRAILER_SIZE) throw runtime_error("Архив обрезан: нет индекса");
+
+    uint16_t version = static_cast<uint16_t>(getLE(data + 4, 2));
+    if (version != VERSION && version != LEGACY_VERSION) {
+        throw runtime_error("Неподдерживаемая версия архива: " + to_string(version));
+    }
+    const size_t headerSize = version == VERSION ? HEADER_SIZE : LEGACY_HEADER_SIZE;
+    if (size < headerSize + TRAILER_SIZE) throw runtime_error("Архив обрезан: нет индекса");
+    ArchiveIndex index;
+    uint8_t cipher = static_cast<uint8_t>(data[6]);
+    if (cipher < 1 || cipher > 4) throw runtime_error("Неизвестный шифр в архиве: " + to_string(cipher));
+    index.cipher = static_cast<ContainerCipher>(cipher);
+    uint8_t flags = static_cast<uint8_t>(data[7]);
+    if (flags & ~FLAG_CRC32C) throw runtime_error("Неизвестные флаги архива: " + to_string(flags));
+    index.checksums = (flags & FLAG_CRC32C) != 0;
+    if (version == VERSION) {
+        memcpy(index.keyCheck.salt.data(), data + 8, KEY_SALT_SIZE);
+        memcpy(index.keyCheck.value.data(), data + 8 + KEY_SALT_SIZE, KEY_CHECK_SIZE);
+    } else {
+        index.keyCheck.legacy = true;
+        index.keyCheck.fingerprint = getLE(data + 8, 8);
+    }
+
+    // Хвост: по нему находится индекс; обрезанный архив теряет хвост
+    const char* trailer = data + size - TRAILER_SIZE;
+    if (memcmp(trailer + 28, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0) {
+        throw runtime_error("Архив обрезан или поврежден: нет хвоста индекса");
+    }
+    uint64_t indexOffset = getLE(trailer, 8);
+    uint64_t indexSize = getLE(trailer + 8, 8);
+    uint64_t count = getLE(trailer + 16, 8);
+    uint32_t indexChecksum = static_cast<uint32_t>(getLE(trailer + 24, 4));
+    if (indexOffset < headerSize || indexOffset > size - TRAILER_SIZE
+        || indexSize != size - TRAILER_SIZE - indexOffset || count > indexSize / ENTRY_FIXED_SIZE) {
+        throw runtime_error("Поврежденный хвост архива");
+    }
+    const char* cursor = data + indexOffset;
+    const char* end = cursor + indexSize;
+    if (crc32c(cursor, indexSize) != indexChecksum) throw runtime_error("Нарушена целостность индекса архива (CRC32C)");
+
+    index.entries.resize(count);
+    for (ArchiveEntry& entry : index.entries) {
+        if (end - cursor < 2) throw runtime_error("Поврежденный индекс архива");
+        size_t nameLength = getLE(cursor, 2);
+        if (static_cast<size_t>(end - cursor) < 2 + nameLength + ENTRY_FIXED_SIZE - 2) {
+            throw runtime_error("Поврежденный индекс архива");
+        }
+        entry.name.assign(cursor + 2, nameLength);
+        cursor += 2 + nameLength;
+        uint8_t entryFlags = static_cast<uint8_t>(cursor[0]);
+        if (entryFlags & ~ENTRY_COMPRESSED) throw runtime_error("Неизвестные флаги записи архива: " + entry.name);
+        entry.compressed = (entryFlags & ENTRY_COMPRESSED) != 0;
+        entry.dataOffset = getLE(cursor + 1, 8);
+        entry.cipherLength = getLE(cursor + 9, 8);
+        entry.plainLength = getLE(cursor + 17, 8);
+        entry.streamOffset = getLE(cursor + 25, 8);
+        entry.padding = static_cast<uint32_t>(getLE(cursor + 33, 4));
+        entry.checksum = static_cast<uint32_t>(getLE(cursor + 37, 4));
+        cursor += ENTRY_FIXED_SIZE - 2;
+        if (entry.dataOffset < headerSize || entry.dataOffset > indexOffset
+            || entry.cipherLength > indexOffset - entry.dataOffset || entry.padding > entry.cipherLength) {
+            throw runtime_error("Поврежденная запись архива: " + entry.name);
+        }
+    }
+    if (cursor != end) throw runtime_error("Поврежденный индекс архива");
+    return index;
+}
+
+ArchiveStats archivePack(const CipherLibs& libs, const ContainerKey& key, const vector<string>& inputs,
+                         const string& outputFile, const ContainerOptions& options) {
+    if (options.compressLevel < 0 || options.compressLevel > 9) throw invalid_argument("Уровень сжатия: 1..9");
+    if (options.compressLevel > 0 && key.cipher == ContainerCipher::RICHELIEU) {
+        throw invalid_argument("Сжатие несовместимо с шифром Ришелье");
+    }
+    ArchiveStats stats;
+    vector<ArchiveSource> sources;
+    {
+        MetricsScope metrics(MetricCipher::NONE, MetricStage::READ);
+        scanArchiveInputs(inputs, sources, stats.errors);
+    }
+
+    // Один большой буфер вместо записи на каждый файл
+    vector<char> buffer(WRITE_BUFFER);
+    ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), static_cast<streamsize>(buffer.size()));
+    out.open(outputFile, ios::binary | ios::trunc);
+    if (!out) throw runtime_error("Не удалось создать файл: " + outputFile);
+    const uint8_t flags = options.checksums ? FLAG_CRC32C : 0;
+    out << headerBytes(key.cipher, flags, makeKeyCheck(key));
+
+    vector<ArchiveEntry> entries;
+    set<string> names;
+    uint64_t position = HEADER_SIZE, stream = 0;
+    for (size_t first = 0; first < sources.size();) {
+        size_t last = first;
+        uint64_t batchBytes = 0;
+        while (last < sources.size() && last - first < BATCH_FILES && (last == first || batchBytes < BATCH_BYTES)) {
+            batchBytes += sources[last++].size;
+        }
+        size_t count = last - first;
+
+        // Чтение пачки; позиции в потоке архива - по фактическим длинам
+        vector<string> contents(count), errors(count);
+        forEachIndex(options.threads, count, [&](size_t k) {
+            try {
+                contents[k] = readFileAsBytes(sources[first + k].path);
+            } catch (const exception& e) {
+                errors[k] = e.what();
+            }
+        });
+        vector<ArchiveEntry> batch(count);
+        for (size_t k = 0; k < count; ++k) {
+            const ArchiveSource& source = sources[first + k];
+            if (errors[k].empty() && source.name.size() > UINT16_MAX) errors[k] = "слишком длинное имя";
+            if (errors[k].empty() && !names.insert(source.name).second) errors[k] = "повторяющееся имя записи";
+            batch[k].name = source.name;
+            batch[k].plainLength = contents[k].size();
+            batch[k].streamOffset = stream;
+            if (errors[k].empty()) stream += contents[k].size();
+        }
+
+        // Сжатие (если оно уменьшает запись) и шифрование в потоках
+        forEachIndex(options.threads, count, [&](size_t k) {
+            if (!errors[k].empty()) return;
+            ArchiveEntry& entry = batch[k];
+            string payload;
+            if (options.compressLevel > 0) {
+                RGR_TRACE_SCOPE("compress", "zlib", contents[k].size());
+                payload = compressChunk(contents[k].data(), contents[k].size(), options.compressLevel);
+                entry.compressed = payload.size() < contents[k].size();
+            }
+            if (!entry.compressed) payload = move(contents[k]);
+            MetricsScope metrics(metricCipher(key.cipher), MetricStage::ENCRYPT, entry.plainLength);
+            contents[k] = encryptPayload(libs, key, payload, entry.streamOffset);
+            entry.cipherLength = contents[k].size();
+            entry.padding = static_cast<uint32_t>(contents[k].size() - payload.size()); //"X" Ришелье
+            if (options.checksums) entry.checksum = crc32c(contents[k].data(), contents[k].size());
+        });
+
+        // Запись пачки подряд
+        {
+            MetricsScope metrics(MetricCipher::NONE, MetricStage::WRITE);
+            uint64_t written = 0;
+            for (size_t k = 0; k < count; ++k) {
+                if (!errors[k].empty()) {
+                    stats.errors.push_back(sources[first + k].path + ": " + errors[k]);
+                    continue;
+                }
+                batch[k].dataOffset = position;
+                out.write(contents[k].data(), static_cast<streamsize>(contents[k].size()));
+                position += contents[k].size();
+                written += contents[k].size();
+                stats.bytes += batch[k].plainLength;
+                ++stats.files;
+                entries.push_back(move(batch[k]));
+            }
+            metrics.setBytes(written);
+        }
+        if (!out) throw runtime_error("Ошибка записи в файл: " + outputFile);
+        first = last;
+    }
+
+    string index;
+    for (const ArchiveEntry& entry : entries) putIndexEntry(index, entry);
+    string trailer;
+    putLE(trailer, position, 8);
+    putLE(trailer, index.size(), 8);
+    putLE(trailer, entries.size(), 8);
+    putLE(trailer, crc32c(index.data(), index.size()), 4);
+    trailer.append(TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+    out << index << trailer;
+    out.close();
+    if (out.fail()) throw runtime_error("Ошибка записи в файл: " + outputFile);
+    return stats;
+}
+
+string archiveReadEntry(const CipherLibs& libs, const ContainerKey& key, const ArchiveIndex& index, const char* data,
+                        const ArchiveEntry& entry) {
+    checkKey(key, index);
+    const char* payload = data + entry.dataOffset;
+    if (index.checksums) {
+        RGR_TRACE_SCOPE("crc32c", "checksum", entry.cipherLength);
+        if (crc32c(payload, entry.cipherLength) != entry.checksum) {
+            throw runtime_error("Нарушена целостность записи " + entry.name + " (CRC32C)");
+        }
+    }
+    string plain;
+    {
+        MetricsScope metrics(metricCipher(key.cipher), MetricStage::DECRYPT, entry.cipherLength);
+        plain = decryptPayload(libs, key, payload, entry.cipherLength, entry.streamOffset);
+    }
+    if (plain.size() != entry.cipherLength) throw runtime_error("Повреждена запись " + entry.name);
+    plain.resize(plain.size() - entry.padding);
+    if (entry.compressed) {
+        RGR_TRACE_SCOPE("decompress", "zlib", entry.plainLength);
+        plain = decompressChunk(plain.data(), plain.size(), entry.plainLength);
+    }
+    if (plain.size() != entry.plainLength) throw runtime_error("Повреждена запись " + entry.name);
+    return plain;
+}
+
+ArchiveStats archiveExtract(const CipherLibs& libs, const ContainerKey& key, const ArchiveIndex& index,
+                            const char* data, const string& outputDir, const vector<string>& names,
+                            unsigned threads) {
+    checkKey(key, index);
+    ArchiveStats stats;
+    vector<const ArchiveEntry*> selected;
+    if (names.empty()) {
+        for (const ArchiveEntry& entry : index.entries) selected.push_back(&entry);
+    } else {
+        unordered_map<string, const ArchiveEntry*> byName;
+        for (const ArchiveEntry& entry : index.entries) byName[entry.name] = &entry;
+        for (const string& name : names) {
+            auto it = byName.find(name);
+            if (it == byName.end()) stats.errors.push_back(name + ": нет в архиве");
+            else selected.push_back(it->second);
+        }
+    }
+
+    // Каталоги создаются один раз на архив, а не на каждый файл
+    vector<const ArchiveEntry*> valid;
+    set<fs::path> directories{fs::path(outputDir)};
+    for (const ArchiveEntry* entry : selected) {
+        if (!safeEntryName(entry->name)) {
+            stats.errors.push_back(entry->name + ": недопустимое имя записи");
+            continue;
+        }
+        valid.push_back(entry);
+        directories.insert((fs::path(outputDir) / entry->name).parent_path());
+    }
+    for (const fs::path& directory : directories) fs::create_directories(directory);
+
+    vector<string> errors(valid.size());
+    forEachIndex(threads, valid.size(), [&](size_t k) {
+        const ArchiveEntry& entry = *valid[k];
+        try {
+            string plain = archiveReadEntry(libs, key, index, data, entry);
+            const string target = (fs::path(outputDir) / entry.name).string();
+            MetricsScope metrics(MetricCipher::NONE, MetricStage::WRITE, plain.size());
+            ofstream file(target, ios::binary | ios::trunc);
+            if (!file) throw runtime_error("не удалось создать файл " + target);
+            file.write(plain.data(), static_cast<streamsize>(plain.size()));
+            file.close();
+            if (file.fail()) throw runtime_error("ошибка записи в файл " + target);
+        } catch (const exception& e) {
+            errors[k] = e.what();
+        }
+    });
+    for (size_t k = 0; k < valid.size(); ++k) {
+        if (!errors[k].empty()) {
+            stats.errors.push_back(valid[k]->name + ": " + errors[k]);
+            continue;
+        }
+        ++stats.files;
+        stats.bytes += valid[k]->plainLength;
+    }
+    return stats;
+}
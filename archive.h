@@ -0,0 +1,85 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "container.h"
+
+// Архив множества файлов в одном зашифрованном файле - для большого числа
+// мелких файлов, где открытие и создание каждого файла стоят дороже шифра:
+//   заголовок (магия "RGRA", версия, шифр, флаги, соль и проверочное
+//   значение ключа),
+//   данные записей подряд, индекс (имя, смещение, длины, позиция гаммы,
+//   дополнение, CRC32C каждой записи), хвост (смещение, размер и CRC32C
+//   индекса, число записей, магия "RGRI").
+// Индекс в конце, поэтому архив пишется одним последовательным проходом;
+// чтение - через отображение в память: хвост, индекс, затем только нужные
+// записи. Индекс не зашифрован: список имен и размеров доступен без ключа.
+
+struct ArchiveEntry {
+    std::string name;         // относительный путь, разделитель "/"
+    uint64_t dataOffset = 0;  // от начала архива
+    uint64_t cipherLength = 0;
+    uint64_t plainLength = 0;
+    uint64_t streamOffset = 0; // позиция записи в потоке архива (гамма Виженера)
+    uint32_t padding = 0;      // символов "X", добавленных Ришелье
+    uint32_t checksum = 0;     // CRC32C шифртекста записи (если checksums)
+    bool compressed = false;   // запись сжата перед шифрованием (только если это ее уменьшило)
+};
+
+struct ArchiveIndex {
+    ContainerCipher cipher = ContainerCipher::VIGENERE;
+    KeyCheck keyCheck;
+    bool checksums = false;
+    std::vector<ArchiveEntry> entries; // в порядке данных
+};
+
+// Входной файл и имя его записи
+struct ArchiveSource {
+    std::string path;
+    std::string name;
+    uint64_t size = 0; // при обходе; в архив идет фактически прочитанная длина
+};
+
+// Файлы inputs с именами записей: каталог обходится рекурсивно, имена его
+// файлов начинаются с имени каталога, как у tar (внутри каталога - по имени).
+// Ненайденные входы перечисляются в errors.
+void scanArchiveInputs(const std::vector<std::string>& inputs, std::vector<ArchiveSource>& sources,
+                       std::vector<std::string>& errors);
+
+// Имя записи допустимо для извлечения: с ".." или абсолютным путем
+// запись вышла бы за каталог извлечения
+bool safeEntryName(const std::string& name);
+
+bool isArchive(const char* data, size_t size);
+
+// Разбор заголовка, хвоста и индекса; исключение, если архив обрезан или поврежден
+ArchiveIndex parseArchiveIndex(const char* data, size_t size);
+
+struct ArchiveStats {
+    size_t files = 0;
+    uint64_t bytes = 0; // открытого текста
+    std::vector<std::string> errors;
+};
+
+// Упаковка файлов и каталогов inputs (каталог - рекурсивно, имена записей
+// начинаются с имени каталога) в outputFile. Файлы читаются и шифруются
+// пачками в options.threads потоках, пачка записывается в архив подряд.
+// options.chunkSize не используется: запись шифруется целиком.
+// Непрочитанные файлы пропускаются и перечисляются в errors.
+ArchiveStats archivePack(const CipherLibs& libs, const ContainerKey& key, const std::vector<std::string>& inputs,
+                         const std::string& outputFile, const ContainerOptions& options);
+
+// Открытый текст одной записи (с проверкой CRC32C)
+std::string archiveReadEntry(const CipherLibs& libs, const ContainerKey& key, const ArchiveIndex& index,
+                             const char* data, const ArchiveEntry& entry);
+
+// Извлечение записей names (пусто - всех) в outputDir. Каталоги создаются
+// один раз на архив, записи расшифровываются и пишутся в threads потоках.
+// Имена с ".." или абсолютные пути отвергаются.
+ArchiveStats archiveExtract(const CipherLibs& libs, const ContainerKey& key, const ArchiveIndex& index,
+                            const char* data, const std::string& outputDir, const std::vector<std::string>& names,
+                            unsigned threads);
+
+#endif
@@ -0,0 +1,289 @@
+#include "autotune.h"
+#include "fast_hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* CACHE_HEADER = "# rgr-kernels 1";
+
+// Каждый вариант выполняется над не менее чем TUNE_BYTES байтов за замер,
+// берется лучший из TUNE_ROUNDS замеров (медленные варианты - меньше замеров)
+const size_t TUNE_BYTES = 64 << 10;
+const int TUNE_ROUNDS = 3;
+const double TUNE_ROUND_LIMIT = 0.05; //секунды
+
+struct Family {
+    string name;
+    kernelNamesFunc names;
+    selectKernelFunc select;
+    bool text; // образец - текст UTF-8, иначе случайные байты
+    function<void(const string&)> run;
+};
+
+vector<Family> families(const CipherLibs& libs) {
+    vector<Family> result;
+    if (libs.hillLib) {
+        auto key = libs.generateHillKey(2);
+        auto gfKey = libs.generateHillGfKey(16);
+        result.push_back({"hill", libs.hillKernelNames, libs.hillSelectKernel, false,
+                          [&libs, key](const string& s) { libs.hillEncrypt(s, key); }});
+        result.push_back({"hill-gf", libs.hillKernelNames, libs.hillSelectKernel, false,
+                          [&libs, gfKey](const string& s) { libs.hillGfEncrypt(s, gfKey); }});
+    }
+    if (libs.vigenereLib) {
+        string key = libs.generateVigenereKey(64);
+        string seedKey = libs.generateVigenereSeedKey();
+        result.push_back({"vigenere", libs.vigenereKernelNames, libs.vigenereSelectKernel, false,
+                          [&libs, key](const string& s) { libs.vigenereEncrypt(s, key); }});
+        result.push_back({"vigenere-seed", libs.vigenereKernelNames, libs.vigenereSelectKernel, false,
+                          [&libs, seedKey](const string& s) { libs.vigenereEncrypt(s, seedKey); }});
+    }
+    if (libs.richelieuLib) {
+        string key = libs.generateRichelieuKey(8);
+        result.push_back({"richelieu", libs.richelieuKernelNames, libs.richelieuSelectKernel, true,
+                          [&libs, key](const string& s) { libs.richelieuEncrypt(s, key); }});
+    }
+    return result;
+}
+
+string sampleInput(size_t size, bool text) {
+    string sample;
+    sample.reserve(size + 64);
+    if (text) {
+        const string phrase = "Шифр Ришелье переставляет символы блока; ASCII and UTF-8 mixed. ";
+        while (sample.size() < size) sample += phrase;
+        sample.resize(size); //обрезанный символ в конце - тоже допустимый вход
+    } else {
+        mt19937_64 gen(42);
+        while (sample.size() < size) sample.push_back(static_cast<char>(gen()));
+    }
+    return sample;
+}
+
+double measure(const Family& family, const string& sample) {
+    size_t repeats = max<size_t>(1, TUNE_BYTES / sample.size());
+    double best = INFINITY;
+    for (int round = 0; round < TUNE_ROUNDS; ++round) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < repeats; ++i) family.run(sample);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        best = min(best, seconds);
+        if (seconds > TUNE_ROUND_LIMIT) break;
+    }
+    return best;
+}
+
+// Выбор по умолчанию библиотек: последний (самый широкий) вариант
+KernelSelection cpuSelection(const vector<Family>& list) {
+    KernelSelection selection;
+    for (const Family& family : list) selection[family.name].fill(family.names(family.name).back());
+    return selection;
+}
+
+KernelSelection tune(const vector<Family>& list) {
+    KernelSelection selection = cpuSelection(list);
+    for (const Family& family : list) {
+        vector<string> names = family.names(family.name);
+        if (names.size() < 2) continue;
+        for (size_t bucket = 0; bucket < KERNEL_BUCKETS; ++bucket) {
+            string sample = sampleInput(kernelBucketSample(bucket), family.text);
+            double best = INFINITY;
+            for (const string& name : names) {
+                family.select(family.name, bucket, name);
+                double seconds = measure(family, sample);
+                if (seconds < best) {
+                    best = seconds;
+                    selection[family.name][bucket] = name;
+                }
+            }
+        }
+    }
+    return selection;
+}
+
+void applySelection(const vector<Family>& list, const KernelSelection& selection) {
+    for (const Family& family : list) {
+        auto it = selection.find(family.name);
+        if (it == selection.end()) continue;
+        for (size_t bucket = 0; bucket < KERNEL_BUCKETS; ++bucket) {
+            if (!family.select(family.name, bucket, it->second[bucket])) {
+                throw invalid_argument("Вариант ядра " + it->second[bucket] + " недоступен для " + family.name);
+            }
+        }
+    }
+}
+
+// Отпечаток машины: модель и флаги процессора и набор вариантов ядер
+// (кэш другой машины или другой сборки библиотек не применяется)
+string machineFingerprint(const vector<Family>& list) {
+    string description;
+    ifstream cpuinfo("/proc/cpuinfo");
+    string line;
+    bool model = false, flags = false;
+    while ((!model || !flags) && getline(cpuinfo, line)) {
+        if (!model && line.rfind("model name", 0) == 0) {
+            description += line + "\n";
+            model = true;
+        } else if (!flags && line.rfind("flags", 0) == 0) {
+            description += line + "\n";
+            flags = true;
+        }
+    }
+    for (const Family& family : list) {
+        description += family.name + ":";
+        for (const string& name : family.names(family.name)) description += " " + name;
+        description += "\n";
+    }
+    ostringstream out;
+    out << hex << fastHash64(description.data(), description.size());
+    return out.str();
+}
+
+optional<KernelSelection> loadCache(const string& path, const string& machine, const vector<Family>& list) {
+    ifstream file(path);
+    string line;
+    if (!file || !getline(file, line) || line != CACHE_HEADER) return nullopt;
+    if (!getline(file, line) || line != "machine " + machine) return nullopt;
+
+    KernelSelection selection;
+    while (getline(file, line)) {
+        istringstream fields(line);
+        string family;
+        array<string, KERNEL_BUCKETS> names;
+        fields >> family;
+        for (string& name : names) fields >> name;
+        if (family.empty() || names.back().empty()) return nullopt;
+        selection[family] = names;
+    }
+    for (const Family& family : list) {
+        auto it = selection.find(family.name);
+        if (it == selection.end()) return nullopt;
+        vector<string> available = family.names(family.name);
+        for (const string& name : it->second) {
+            if (find(available.begin(), available.end(), name) == available.end()) return nullopt;
+        }
+    }
+    return selection;
+}
+
+// Запись через временный файл и переименование; ошибка записи не мешает
+// работе - выбор просто подбирается заново при следующем запуске
+void saveCache(const string& path, const string& machine, const KernelSelection& selection) {
+    try {
+        fs::create_directories(fs::path(path).parent_path());
+        string temporary = path + ".tmp";
+        {
+            ofstream file(temporary, ios::trunc);
+            file << CACHE_HEADER << "\nmachine " << machine << "\n";
+            for (const auto& [family, names] : selection) {
+                file << family;
+                for (const string& name : names) file << " " << name;
+                file << "\n";
+            }
+            if (!file.flush()) throw runtime_error("ошибка записи");
+        }
+        fs::rename(temporary, path);
+    } catch (const exception& e) {
+        cerr << "Предупреждение: не удалось сохранить выбор ядер в " << path << " (" << e.what() << ")" << endl;
+    }
+}
+
+// СЕМЕЙСТВО=ВАРИАНТ[,...]
+KernelSelection parseFixed(const string& spec, const vector<Family>& list) {
+    KernelSelection selection = cpuSelection(list);
+    istringstream items(spec);
+    string item;
+    while (getline(items, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos || eq == 0 || eq + 1 == item.size()) {
+            throw invalid_argument("Неверное описание ядер: " + item + " (ожидается СЕМЕЙСТВО=ВАРИАНТ)");
+        }
+        string familyName = item.substr(0, eq), name = item.substr(eq + 1);
+        bool matched = false;
+        for (const Family& family : list) {
+            if (familyName != "all" && familyName != family.name) continue;
+            vector<string> available = family.names(family.name);
+            if (find(available.begin(), available.end(), name) == available.end()) {
+                if (familyName == "all") continue;
+                throw invalid_argument("Вариант ядра " + name + " недоступен для " + family.name);
+            }
+            selection[family.name].fill(name);
+            matched = true;
+        }
+        if (!matched) throw invalid_argument("Нет семейства ядер с вариантом: " + item);
+    }
+    return selection;
+}
+
+KernelSelection g_current;
+string g_pending; // auto или retune, еще не выполненный (см. prepareKernels)
+
+} // namespace
+
+string kernelCachePath() {
+    if (const char* config = getenv("XDG_CONFIG_HOME"); config && *config) {
+        return (fs::path(config) / "rgr" / "kernels").string();
+    }
+    if (const char* home = getenv("HOME"); home && *home) {
+        return (fs::path(home) / ".config" / "rgr" / "kernels").string();
+    }
+    return "";
+}
+
+map<string, vector<string>> availableKernels(const CipherLibs& libs) {
+    map<string, vector<string>> result;
+    for (const Family& family : families(libs)) result[family.name] = family.names(family.name);
+    return result;
+}
+
+const KernelSelection& currentKernels() {
+    return g_current;
+}
+
+void setupKernels(const CipherLibs& libs, const string& spec) {
+    vector<Family> list = families(libs);
+    if (spec == "cpu" || spec == "auto" || spec == "retune") {
+        g_current = cpuSelection(list);
+        g_pending = spec == "cpu" ? "" : spec;
+        return;
+    }
+    g_current = parseFixed(spec, list);
+    g_pending.clear();
+    applySelection(list, g_current);
+}
+
+void prepareKernels(const CipherLibs& libs) {
+    if (g_pending.empty()) return;
+    string spec = g_pending;
+    g_pending.clear();
+    vector<Family> list = families(libs);
+    if (list.empty()) return;
+
+    string path = kernelCachePath();
+    string machine = machineFingerprint(list);
+    if (spec == "auto" && !path.empty()) {
+        if (optional<KernelSelection> cached = loadCache(path, machine, list)) {
+            g_current = *cached;
+            applySelection(list, g_current);
+            return;
+        }
+    }
+    cerr << "Подбор ядер шифров для этой машины..." << endl;
+    g_current = tune(list);
+    applySelection(list, g_current);
+    if (!path.empty()) saveCache(path, machine, g_current);
+}
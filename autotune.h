@@ -0,0 +1,48 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+#include "cipher_libs.h"
+#include "kernel_table.h"
+
+// Автоподбор ядер шифров. У каждого семейства ядер ("hill", "hill-gf",
+// "vigenere", "vigenere-seed", "richelieu") несколько реализаций; лучшая
+// зависит от процессора и размера входа. При первом запуске варианты
+// сравниваются на характерном размере каждой корзины (kernel_table.h),
+// победители сохраняются в кэш в каталоге настроек пользователя и при
+// следующих запусках применяются без замеров.
+
+// Семейство -> имя варианта для каждой корзины размеров
+typedef std::map<std::string, std::array<std::string, KERNEL_BUCKETS>> KernelSelection;
+
+// Режим выбора (--kernels=...):
+//   auto    - из кэша, а если его нет или он от другой машины - замер и запись кэша
+//   retune  - замер и перезапись кэша
+//   cpu     - без замеров: самый широкий набор команд процессора
+//   СЕМЕЙСТВО=ВАРИАНТ[,...] - фиксированный выбор для всех размеров, для
+//             воспроизводимых запусков (all=ВАРИАНТ - для всех семейств,
+//             где такой вариант есть); остальные семейства - как cpu
+// Ошибка в описании - исключение invalid_argument. Для auto и retune здесь
+// только проверяется описание: кэш и замеры откладываются до prepareKernels,
+// чтобы справка, list, verify и ошибочные запуски не платили за подбор.
+void setupKernels(const CipherLibs& libs, const std::string& spec);
+
+// Отложенный подбор auto/retune перед первым шифрованием (повторные вызовы
+// ничего не делают). До него действует выбор cpu. Замеряются только
+// семейства загруженных библиотек; если ни одна не загружена, подбора нет.
+void prepareKernels(const CipherLibs& libs);
+
+// Файл кэша: $XDG_CONFIG_HOME/rgr/kernels или ~/.config/rgr/kernels
+// (пустая строка - каталог настроек неизвестен, кэш не используется)
+std::string kernelCachePath();
+
+// Доступные варианты каждого семейства загруженных библиотек
+std::map<std::string, std::vector<std::string>> availableKernels(const CipherLibs& libs);
+
+// Выбор, примененный setupKernels
+const KernelSelection& currentKernels();
+
+#endif
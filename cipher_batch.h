@@ -0,0 +1,34 @@
+#ifndef CIPHER_BATCH_H
+#define CIPHER_BATCH_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Пакетная обработка коротких сообщений: один вызов на весь пакет вместо
+// вызова (и строки результата) на каждое сообщение. Подготовка ключа
+// выполняется один раз на ключ, а не на сообщение.
+// Заголовочный, чтобы им пользовались и программа, и библиотеки шифров.
+
+// Сообщение пакета: size байтов по адресу data, key - номер ключа в массиве
+// ключей пакета. Данные должны жить до конца вызова.
+struct CipherMessage {
+    const char* data;
+    size_t size;
+    size_t key;
+};
+
+// Результат пакета: все сообщения подряд в одном буфере, в порядке
+// входного массива. Сообщение i - [offsets[i], offsets[i + 1]) буфера arena,
+// offsets.size() == количество сообщений + 1.
+struct CipherBatch {
+    std::string arena;
+    std::vector<uint64_t> offsets;
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    const char* data(size_t i) const { return arena.data() + offsets[i]; }
+    size_t length(size_t i) const { return static_cast<size_t>(offsets[i + 1] - offsets[i]); }
+};
+
+#endif // CIPHER_BATCH_H
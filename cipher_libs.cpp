@@ -0,0 +1,226 @@
+#include "cipher_libs.h"
+#include <iostream>
+
+#ifdef RGR_STATIC_CIPHERS
+#include "hill.h"
+#include "richelieu.h"
+#include "vigenere.h"
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+
+#ifdef RGR_STATIC_CIPHERS
+
+// Статическая сборка: шифры скомпонованы в программу, указатели на функции
+// берутся напрямую (LTO может встроить их через указатели)
+namespace {
+int builtinLibrary; //вместо дескриптора dlopen - признак доступности
+}
+
+CipherLibs loadCipherLibs() {
+    CipherLibs libs;
+    libs.hillLib = &builtinLibrary;
+    libs.richelieuLib = &builtinLibrary;
+    libs.vigenereLib = &builtinLibrary;
+
+    libs.hillEncrypt = hillEncrypt;
+    libs.hillDecrypt = hillDecrypt;
+    libs.generateHillKey = generateHillKey;
+    libs.saveHillKey = saveHillKey;
+    libs.loadHillKey = loadHillKey;
+    libs.hillDecryptFileRange = hillDecryptFileRange;
+    libs.generateHillGfKey = generateHillGfKey;
+    libs.hillGfEncrypt = hillGfEncrypt;
+    libs.hillGfDecrypt = hillGfDecrypt;
+    libs.saveHillGfKey = saveHillGfKey;
+    libs.loadHillGfKey = loadHillGfKey;
+    libs.hillEncryptBatch = hillEncryptBatch;
+    libs.hillDecryptBatch = hillDecryptBatch;
+    libs.hillComposeKeys = hillComposeKeys;
+    libs.hillGfComposeKeys = hillGfComposeKeys;
+    libs.hillInit = hillInit;
+    libs.hillGfInit = hillGfInit;
+    libs.hillUpdate = hillUpdate;
+    libs.hillFinal = hillFinal;
+    libs.hillFree = hillFree;
+    libs.hillRecoverKnownPlaintext = hillRecoverKnownPlaintext;
+    libs.hillSearchKey = hillSearchKey;
+    libs.hillKernelNames = hillKernelNames;
+    libs.hillSelectKernel = hillSelectKernel;
+
+    libs.richelieuEncrypt = richelieuEncrypt;
+    libs.richelieuDecrypt = richelieuDecrypt;
+    libs.generateRichelieuKey = generateRichelieuKey;
+    libs.saveRichelieuKey = saveRichelieuKey;
+    libs.loadRichelieuKey = loadRichelieuKey;
+    libs.richelieuComposeKeys = richelieuComposeKeys;
+    libs.richelieuInit = richelieuInit;
+    libs.richelieuUpdate = richelieuUpdate;
+    libs.richelieuFinal = richelieuFinal;
+    libs.richelieuFree = richelieuFree;
+    libs.richelieuEncryptFile = richelieuEncryptFile;
+    libs.richelieuDecryptFile = richelieuDecryptFile;
+    libs.richelieuSolve = richelieuSolve;
+    libs.richelieuKernelNames = richelieuKernelNames;
+    libs.richelieuSelectKernel = richelieuSelectKernel;
+
+    libs.vigenereEncrypt = vigenereEncrypt;
+    libs.vigenereDecrypt = vigenereDecrypt;
+    libs.generateVigenereKey = generateVigenereKey;
+    libs.generateVigenereSeedKey = generateVigenereSeedKey;
+    libs.saveVigenereKey = saveVigenereKey;
+    libs.loadVigenereKey = loadVigenereKey;
+    libs.vigenereEncryptAt = vigenereEncryptAt;
+    libs.vigenereDecryptAt = vigenereDecryptAt;
+    libs.vigenereDecryptFileRange = vigenereDecryptFileRange;
+    libs.vigenereApply = vigenereApply;
+    libs.vigenereEncryptFileKeyFile = vigenereEncryptFileKeyFile;
+    libs.vigenereDecryptFileKeyFile = vigenereDecryptFileKeyFile;
+    libs.vigenereEncryptBatch = vigenereEncryptBatch;
+    libs.vigenereDecryptBatch = vigenereDecryptBatch;
+    libs.vigenereRekeyApply = vigenereRekeyApply;
+    libs.vigenereInit = vigenereInit;
+    libs.vigenereUpdate = vigenereUpdate;
+    libs.vigenereFinal = vigenereFinal;
+    libs.vigenereFree = vigenereFree;
+    libs.vigenereAnalyze = vigenereAnalyze;
+    libs.vigenereKernelNames = vigenereKernelNames;
+    libs.vigenereSelectKernel = vigenereSelectKernel;
+    return libs;
+}
+
+void unloadCipherLibs(CipherLibs& libs) {
+    libs = CipherLibs();
+}
+
+#else
+
+CipherLibs loadCipherLibs() {
+    CipherLibs libs;
+
+    // Загрузка библиотек
+    libs.hillLib = dlopen("./libhill.so", RTLD_LAZY);
+    libs.richelieuLib = dlopen("./librichelieu.so", RTLD_LAZY);
+    libs.vigenereLib = dlopen("./libvigenere.so", RTLD_LAZY);
+
+    // Загрузка функций Hill
+    if (libs.hillLib) { //далее получение указателя на функцию по имени
+        libs.hillEncrypt = (hillEncryptFunc)dlsym(libs.hillLib, "hillEncrypt");
+        libs.hillDecrypt = (hillDecryptFunc)dlsym(libs.hillLib, "hillDecrypt");
+        libs.generateHillKey = (generateHillKeyFunc)dlsym(libs.hillLib, "generateHillKey");
+        libs.saveHillKey = (saveHillKeyFunc)dlsym(libs.hillLib, "saveHillKey");
+        libs.loadHillKey = (loadHillKeyFunc)dlsym(libs.hillLib, "loadHillKey");
+        libs.hillDecryptFileRange = (hillDecryptFileRangeFunc)dlsym(libs.hillLib, "hillDecryptFileRange");
+        libs.generateHillGfKey = (generateHillGfKeyFunc)dlsym(libs.hillLib, "generateHillGfKey");
+        libs.hillGfEncrypt = (hillGfProcessFunc)dlsym(libs.hillLib, "hillGfEncrypt");
+        libs.hillGfDecrypt = (hillGfProcessFunc)dlsym(libs.hillLib, "hillGfDecrypt");
+        libs.saveHillGfKey = (saveHillKeyFunc)dlsym(libs.hillLib, "saveHillGfKey");
+        libs.loadHillGfKey = (loadHillKeyFunc)dlsym(libs.hillLib, "loadHillGfKey");
+        libs.hillEncryptBatch = (hillBatchFunc)dlsym(libs.hillLib, "hillEncryptBatch");
+        libs.hillDecryptBatch = (hillBatchFunc)dlsym(libs.hillLib, "hillDecryptBatch");
+        libs.hillComposeKeys = (hillComposeKeysFunc)dlsym(libs.hillLib, "hillComposeKeys");
+        libs.hillGfComposeKeys = (hillComposeKeysFunc)dlsym(libs.hillLib, "hillGfComposeKeys");
+        libs.hillInit = (hillInitFunc)dlsym(libs.hillLib, "hillInit");
+        libs.hillGfInit = (hillInitFunc)dlsym(libs.hillLib, "hillGfInit");
+        libs.hillUpdate = (hillUpdateFunc)dlsym(libs.hillLib, "hillUpdate");
+        libs.hillFinal = (hillFinalFunc)dlsym(libs.hillLib, "hillFinal");
+        libs.hillFree = (hillFreeFunc)dlsym(libs.hillLib, "hillFree");
+        libs.hillRecoverKnownPlaintext = (hillRecoverKnownPlaintextFunc)dlsym(libs.hillLib, "hillRecoverKnownPlaintext");
+        libs.hillSearchKey = (hillSearchKeyFunc)dlsym(libs.hillLib, "hillSearchKey");
+        libs.hillKernelNames = (kernelNamesFunc)dlsym(libs.hillLib, "hillKernelNames");
+        libs.hillSelectKernel = (selectKernelFunc)dlsym(libs.hillLib, "hillSelectKernel");
+
+        if (!libs.hillEncrypt || !libs.hillDecrypt || !libs.generateHillKey || !libs.saveHillKey
+            || !libs.loadHillKey || !libs.hillDecryptFileRange || !libs.hillRecoverKnownPlaintext
+            || !libs.hillSearchKey || !libs.generateHillGfKey || !libs.hillGfEncrypt || !libs.hillGfDecrypt
+            || !libs.saveHillGfKey || !libs.loadHillGfKey || !libs.hillEncryptBatch || !libs.hillDecryptBatch
+            || !libs.hillKernelNames || !libs.hillSelectKernel || !libs.hillInit || !libs.hillGfInit
+            || !libs.hillUpdate || !libs.hillFinal || !libs.hillFree || !libs.hillComposeKeys
+            || !libs.hillGfComposeKeys) {
+            cerr << "Ошибка: При загрузке функций Hill: " << dlerror() << endl;
+            dlclose(libs.hillLib); //выгрузка библиотеки
+            libs.hillLib = nullptr; //библиотека недоступна
+        }
+    }
+
+    // Загрузка функций Richelieu
+    if (libs.richelieuLib) {
+        libs.richelieuEncrypt = (richelieuEncryptFunc)dlsym(libs.richelieuLib, "richelieuEncrypt");
+        libs.richelieuDecrypt = (richelieuDecryptFunc)dlsym(libs.richelieuLib, "richelieuDecrypt");
+        libs.generateRichelieuKey = (generateRichelieuKeyFunc)dlsym(libs.richelieuLib, "generateRichelieuKey");
+        libs.saveRichelieuKey = (saveRichelieuKeyFunc)dlsym(libs.richelieuLib, "saveRichelieuKey");
+        libs.loadRichelieuKey = (loadRichelieuKeyFunc)dlsym(libs.richelieuLib, "loadRichelieuKey");
+        libs.richelieuComposeKeys = (richelieuComposeKeysFunc)dlsym(libs.richelieuLib, "richelieuComposeKeys");
+        libs.richelieuInit = (richelieuInitFunc)dlsym(libs.richelieuLib, "richelieuInit");
+        libs.richelieuUpdate = (richelieuUpdateFunc)dlsym(libs.richelieuLib, "richelieuUpdate");
+        libs.richelieuFinal = (richelieuFinalFunc)dlsym(libs.richelieuLib, "richelieuFinal");
+        libs.richelieuFree = (richelieuFreeFunc)dlsym(libs.richelieuLib, "richelieuFree");
+        libs.richelieuEncryptFile = (richelieuFileFunc)dlsym(libs.richelieuLib, "richelieuEncryptFile");
+        libs.richelieuDecryptFile = (richelieuFileFunc)dlsym(libs.richelieuLib, "richelieuDecryptFile");
+        libs.richelieuSolve = (richelieuSolveFunc)dlsym(libs.richelieuLib, "richelieuSolve");
+        libs.richelieuKernelNames = (kernelNamesFunc)dlsym(libs.richelieuLib, "richelieuKernelNames");
+        libs.richelieuSelectKernel = (selectKernelFunc)dlsym(libs.richelieuLib, "richelieuSelectKernel");
+
+        if (!libs.richelieuEncrypt || !libs.richelieuDecrypt || !libs.generateRichelieuKey
+            || !libs.saveRichelieuKey || !libs.loadRichelieuKey || !libs.richelieuSolve
+            || !libs.richelieuKernelNames || !libs.richelieuSelectKernel || !libs.richelieuInit
+            || !libs.richelieuUpdate || !libs.richelieuFinal || !libs.richelieuFree
+            || !libs.richelieuComposeKeys || !libs.richelieuEncryptFile || !libs.richelieuDecryptFile) {
+            cerr << "Ошибка: При загрузке функций Richelieu: " << dlerror() << endl;
+            dlclose(libs.richelieuLib);
+            libs.richelieuLib = nullptr;
+        }
+    }
+
+    // Загрузка функций Vigenere
+    if (libs.vigenereLib) {
+        libs.vigenereEncrypt = (vigenereEncryptFunc)dlsym(libs.vigenereLib, "vigenereEncrypt");
+        libs.vigenereDecrypt = (vigenereDecryptFunc)dlsym(libs.vigenereLib, "vigenereDecrypt");
+        libs.generateVigenereKey = (generateVigenereKeyFunc)dlsym(libs.vigenereLib, "generateVigenereKey");
+        libs.generateVigenereSeedKey = (generateVigenereSeedKeyFunc)dlsym(libs.vigenereLib, "generateVigenereSeedKey");
+        libs.saveVigenereKey = (saveVigenereKeyFunc)dlsym(libs.vigenereLib, "saveVigenereKey");
+        libs.loadVigenereKey = (loadVigenereKeyFunc)dlsym(libs.vigenereLib, "loadVigenereKey");
+        libs.vigenereEncryptAt = (vigenereEncryptAtFunc)dlsym(libs.vigenereLib, "vigenereEncryptAt");
+        libs.vigenereDecryptAt = (vigenereDecryptAtFunc)dlsym(libs.vigenereLib, "vigenereDecryptAt");
+        libs.vigenereDecryptFileRange = (vigenereDecryptFileRangeFunc)dlsym(libs.vigenereLib, "vigenereDecryptFileRange");
+        libs.vigenereApply = (vigenereApplyFunc)dlsym(libs.vigenereLib, "vigenereApply");
+        libs.vigenereEncryptFileKeyFile = (vigenereFileKeyFileFunc)dlsym(libs.vigenereLib, "vigenereEncryptFileKeyFile");
+        libs.vigenereDecryptFileKeyFile = (vigenereFileKeyFileFunc)dlsym(libs.vigenereLib, "vigenereDecryptFileKeyFile");
+        libs.vigenereEncryptBatch = (vigenereBatchFunc)dlsym(libs.vigenereLib, "vigenereEncryptBatch");
+        libs.vigenereDecryptBatch = (vigenereBatchFunc)dlsym(libs.vigenereLib, "vigenereDecryptBatch");
+        libs.vigenereRekeyApply = (vigenereRekeyApplyFunc)dlsym(libs.vigenereLib, "vigenereRekeyApply");
+        libs.vigenereInit = (vigenereInitFunc)dlsym(libs.vigenereLib, "vigenereInit");
+        libs.vigenereUpdate = (vigenereUpdateFunc)dlsym(libs.vigenereLib, "vigenereUpdate");
+        libs.vigenereFinal = (vigenereFinalFunc)dlsym(libs.vigenereLib, "vigenereFinal");
+        libs.vigenereFree = (vigenereFreeFunc)dlsym(libs.vigenereLib, "vigenereFree");
+        libs.vigenereAnalyze = (vigenereAnalyzeFunc)dlsym(libs.vigenereLib, "vigenereAnalyze");
+        libs.vigenereKernelNames = (kernelNamesFunc)dlsym(libs.vigenereLib, "vigenereKernelNames");
+        libs.vigenereSelectKernel = (selectKernelFunc)dlsym(libs.vigenereLib, "vigenereSelectKernel");
+
+        if (!libs.vigenereEncrypt || !libs.vigenereDecrypt || !libs.generateVigenereKey || !libs.generateVigenereSeedKey
+            || !libs.saveVigenereKey || !libs.loadVigenereKey || !libs.vigenereEncryptAt
+            || !libs.vigenereDecryptAt || !libs.vigenereDecryptFileRange || !libs.vigenereApply
+            || !libs.vigenereEncryptFileKeyFile || !libs.vigenereDecryptFileKeyFile || !libs.vigenereAnalyze
+            || !libs.vigenereEncryptBatch || !libs.vigenereDecryptBatch
+            || !libs.vigenereKernelNames || !libs.vigenereSelectKernel || !libs.vigenereInit
+            || !libs.vigenereUpdate || !libs.vigenereFinal || !libs.vigenereFree
+            || !libs.vigenereRekeyApply) {
+            cerr << "Ошибка: При загрузке функций Vigenere: " << dlerror() << endl;
+            dlclose(libs.vigenereLib);
+            libs.vigenereLib = nullptr;
+        }
+    }
+
+    return libs;
+}
+
+void unloadCipherLibs(CipherLibs& libs) {
+    if (libs.hillLib) dlclose(libs.hillLib);
+    if (libs.richelieuLib) dlclose(libs.richelieuLib);
+    if (libs.vigenereLib) dlclose(libs.vigenereLib);
+    libs = CipherLibs();
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef CIPHER_LIBS_H
+#define CIPHER_LIBS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "cipher_batch.h"
+#include "vigenere_analysis.h"
+#include "hill_analysis.h"
+#include "richelieu_analysis.h"
+
+// Контексты потоковой обработки (определены в библиотеках шифров)
+struct HillContext;
+struct RichelieuContext;
+struct VigenereContext;
+
+// Создание безопасных указателей на функции из динамических библиотек
+typedef std::vector<std::string> (*kernelNamesFunc)(const std::string&);
+typedef bool (*selectKernelFunc)(const std::string&, size_t, const std::string&);
+typedef std::string (*hillEncryptFunc)(const std::string&, const std::vector<std::vector<int>>&);
+typedef std::string (*hillDecryptFunc)(const std::string&, const std::vector<std::vector<int>>&);
+typedef std::vector<std::vector<int>> (*generateHillKeyFunc)(size_t);
+typedef void (*saveHillKeyFunc)(const std::vector<std::vector<int>>&, const std::string&);
+typedef std::vector<std::vector<int>> (*loadHillKeyFunc)(const std::string&);
+typedef std::string (*hillDecryptFileRangeFunc)(const std::string&, uint64_t, uint64_t,
+                                                const std::vector<std::vector<int>>&);
+typedef std::vector<std::vector<int>> (*generateHillGfKeyFunc)(size_t);
+typedef std::string (*hillGfProcessFunc)(const std::string&, const std::vector<std::vector<int>>&);
+typedef CipherBatch (*hillBatchFunc)(const CipherMessage*, size_t, const std::vector<std::vector<int>>*, size_t);
+typedef std::vector<std::vector<int>> (*hillComposeKeysFunc)(const std::vector<std::vector<int>>&,
+                                                             const std::vector<std::vector<int>>&);
+typedef HillContext* (*hillInitFunc)(const std::vector<std::vector<int>>&, bool);
+typedef void (*hillUpdateFunc)(HillContext*, const char*, size_t, std::string&);
+typedef void (*hillFinalFunc)(HillContext*, std::string&);
+typedef void (*hillFreeFunc)(HillContext*);
+typedef HillRecovery (*hillRecoverKnownPlaintextFunc)(const std::string&, const std::string&, unsigned);
+typedef HillRecovery (*hillSearchKeyFunc)(const std::string&, const std::string&, size_t,
+                                          const std::string&, unsigned);
+
+typedef std::string (*richelieuEncryptFunc)(const std::string&, const std::string&);
+typedef std::string (*richelieuDecryptFunc)(const std::string&, const std::string&);
+typedef std::string (*generateRichelieuKeyFunc)(int);
+typedef void (*saveRichelieuKeyFunc)(const std::string&, const std::string&);
+typedef std::string (*loadRichelieuKeyFunc)(const std::string&);
+typedef std::string (*richelieuComposeKeysFunc)(const std::string&, const std::string&);
+typedef RichelieuContext* (*richelieuInitFunc)(const std::string&, bool);
+typedef void (*richelieuUpdateFunc)(RichelieuContext*, const char*, size_t, std::string&);
+typedef void (*richelieuFinalFunc)(RichelieuContext*, std::string&);
+typedef void (*richelieuFreeFunc)(RichelieuContext*);
+typedef void (*richelieuFileFunc)(const std::string&, const std::string&, const std::string&);
+typedef RichelieuSolution (*richelieuSolveFunc)(const std::string&, int, const std::string&,
+                                                const std::string&, unsigned, unsigned);
+
+typedef std::string (*vigenereEncryptFunc)(const std::string&, const std::string&);
+typedef std::string (*vigenereDecryptFunc)(const std::string&, const std::string&);
+typedef std::string (*generateVigenereKeyFunc)(int);
+typedef std::string (*generateVigenereSeedKeyFunc)();
+typedef void (*saveVigenereKeyFunc)(const std::string&, const std::string&);
+typedef std::string (*loadVigenereKeyFunc)(const std::string&);
+typedef std::string (*vigenereEncryptAtFunc)(const std::string&, const std::string&, uint64_t);
+typedef std::string (*vigenereDecryptAtFunc)(const std::string&, const std::string&, uint64_t);
+typedef std::string (*vigenereDecryptFileRangeFunc)(const std::string&, uint64_t, uint64_t, const std::string&);
+typedef void (*vigenereApplyFunc)(const char*, size_t, const char*, size_t, uint64_t, bool, char*);
+typedef void (*vigenereFileKeyFileFunc)(const std::string&, const std::string&, const std::string&);
+typedef CipherBatch (*vigenereBatchFunc)(const CipherMessage*, size_t, const std::string*, size_t);
+typedef void (*vigenereRekeyApplyFunc)(const char*, size_t, const char*, size_t, const char*, size_t, uint64_t, char*);
+typedef VigenereContext* (*vigenereInitFunc)(const char*, size_t, bool);
+typedef void (*vigenereUpdateFunc)(VigenereContext*, const char*, size_t, std::string&);
+typedef void (*vigenereFinalFunc)(VigenereContext*, std::string&);
+typedef void (*vigenereFreeFunc)(VigenereContext*);
+typedef VigenereAnalysis (*vigenereAnalyzeFunc)(const char*, size_t, size_t,
+                                                const std::string&, unsigned);
+
+// Загруженные библиотеки шифров (nullptr - библиотека недоступна)
+struct CipherLibs {
+    void* hillLib = nullptr;
+    void* richelieuLib = nullptr;
+    void* vigenereLib = nullptr;
+
+    hillEncryptFunc hillEncrypt = nullptr;
+    hillDecryptFunc hillDecrypt = nullptr;
+    generateHillKeyFunc generateHillKey = nullptr;
+    saveHillKeyFunc saveHillKey = nullptr;
+    loadHillKeyFunc loadHillKey = nullptr;
+    hillDecryptFileRangeFunc hillDecryptFileRange = nullptr;
+    generateHillGfKeyFunc generateHillGfKey = nullptr;
+    hillGfProcessFunc hillGfEncrypt = nullptr;
+    hillGfProcessFunc hillGfDecrypt = nullptr;
+    saveHillKeyFunc saveHillGfKey = nullptr;
+    loadHillKeyFunc loadHillGfKey = nullptr;
+    hillBatchFunc hillEncryptBatch = nullptr;
+    hillBatchFunc hillDecryptBatch = nullptr;
+    hillComposeKeysFunc hillComposeKeys = nullptr;
+    hillComposeKeysFunc hillGfComposeKeys = nullptr;
+    hillInitFunc hillInit = nullptr;
+    hillInitFunc hillGfInit = nullptr;
+    hillUpdateFunc hillUpdate = nullptr;
+    hillFinalFunc hillFinal = nullptr;
+    hillFreeFunc hillFree = nullptr;
+    hillRecoverKnownPlaintextFunc hillRecoverKnownPlaintext = nullptr;
+    hillSearchKeyFunc hillSearchKey = nullptr;
+    kernelNamesFunc hillKernelNames = nullptr;
+    selectKernelFunc hillSelectKernel = nullptr;
+
+    richelieuEncryptFunc richelieuEncrypt = nullptr;
+    richelieuDecryptFunc richelieuDecrypt = nullptr;
+    generateRichelieuKeyFunc generateRichelieuKey = nullptr;
+    saveRichelieuKeyFunc saveRichelieuKey = nullptr;
+    loadRichelieuKeyFunc loadRichelieuKey = nullptr;
+    richelieuComposeKeysFunc richelieuComposeKeys = nullptr;
+    richelieuInitFunc richelieuInit = nullptr;
+    richelieuUpdateFunc richelieuUpdate = nullptr;
+    richelieuFinalFunc richelieuFinal = nullptr;
+    richelieuFreeFunc richelieuFree = nullptr;
+    richelieuFileFunc richelieuEncryptFile = nullptr;
+    richelieuFileFunc richelieuDecryptFile = nullptr;
+    richelieuSolveFunc richelieuSolve = nullptr;
+    kernelNamesFunc richelieuKernelNames = nullptr;
+    selectKernelFunc richelieuSelectKernel = nullptr;
+
+    vigenereEncryptFunc vigenereEncrypt = nullptr;
+    vigenereDecryptFunc vigenereDecrypt = nullptr;
+    generateVigenereKeyFunc generateVigenereKey = nullptr;
+    generateVigenereSeedKeyFunc generateVigenereSeedKey = nullptr;
+    saveVigenereKeyFunc saveVigenereKey = nullptr;
+    loadVigenereKeyFunc loadVigenereKey = nullptr;
+    vigenereEncryptAtFunc vigenereEncryptAt = nullptr;
+    vigenereDecryptAtFunc vigenereDecryptAt = nullptr;
+    vigenereDecryptFileRangeFunc vigenereDecryptFileRange = nullptr;
+    vigenereApplyFunc vigenereApply = nullptr;
+    vigenereFileKeyFileFunc vigenereEncryptFileKeyFile = nullptr;
+    vigenereFileKeyFileFunc vigenereDecryptFileKeyFile = nullptr;
+    vigenereBatchFunc vigenereEncryptBatch = nullptr;
+    vigenereBatchFunc vigenereDecryptBatch = nullptr;
+    vigenereRekeyApplyFunc vigenereRekeyApply = nullptr;
+    vigenereInitFunc vigenereInit = nullptr;
+    vigenereUpdateFunc vigenereUpdate = nullptr;
+    vigenereFinalFunc vigenereFinal = nullptr;
+    vigenereFreeFunc vigenereFree = nullptr;
+    vigenereAnalyzeFunc vigenereAnalyze = nullptr;
+    kernelNamesFunc vigenereKernelNames = nullptr;
+    selectKernelFunc vigenereSelectKernel = nullptr;
+};
+
+// Загрузка библиотек и получение указателей на функции
+CipherLibs loadCipherLibs();
+
+// Выгрузка библиотек
+void unloadCipherLibs(CipherLibs& libs);
+
+#endif
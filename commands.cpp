@@ -0,0 +1,1209 @@
+#include "commands.h"
+#include "file.h"
+#include "metrics.h"
+#include "container.h"
+#include "incremental.h"
+#include "archive.h"
+#include "dedup.h"
+#include "autotune.h"
+#include "trace.h"
+#include "planner.h"
+#include "staged_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// Параметры команды: --имя значение, --имя=значение или флаг --имя
+class CommandArgs {
+public:
+    CommandArgs(const vector<string>& args, const set<string>& valueOptions,
+                const set<string>& flagOptions) {
+        for (size_t i = 1; i < args.size(); ++i) {
+            const string& arg = args[i];
+            if (arg.rfind("--", 0) != 0) {
+                throw invalid_argument("Неожиданный аргумент: " + arg);
+            }
+            string name = arg.substr(2);
+            string value;
+            size_t eq = name.find('=');
+            if (eq != string::npos) {
+                value = name.substr(eq + 1);
+                name = name.substr(0, eq);
+            }
+
+            if (flagOptions.count(name)) {
+                if (eq != string::npos) throw invalid_argument("Параметр --" + name + " не принимает значение");
+                values_.emplace(name, "");
+            } else if (valueOptions.count(name)) {
+                if (eq == string::npos) {
+                    if (i + 1 >= args.size()) throw invalid_argument("Не указано значение для --" + name);
+                    value = args[++i];
+                }
+                values_.emplace(name, value);
+            } else {
+                throw invalid_argument("Неизвестный параметр команды " + args[0] + ": " + arg);
+            }
+        }
+    }
+
+    bool has(const string& name) const { return values_.count(name) > 0; }
+
+    // Все значения повторяющегося параметра
+    vector<string> getAll(const string& name) const {
+        vector<string> result;
+        auto range = values_.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) result.push_back(it->second);
+        return result;
+    }
+
+    string get(const string& name, const string& defaultValue = "") const {
+        auto it = values_.find(name);
+        return it == values_.end() ? defaultValue : it->second;
+    }
+
+    string require(const string& name) const {
+        if (!has(name)) throw invalid_argument("Не указан обязательный параметр --" + name);
+        return get(name);
+    }
+
+    uint64_t getNumber(const string& name, uint64_t defaultValue) const {
+        if (!has(name)) return defaultValue;
+        const string value = get(name);
+        size_t pos = 0;
+        unsigned long long number = 0;
+        try {
+            number = stoull(value, &pos);
+        } catch (const exception&) {
+            pos = 0;
+        }
+        if (value.empty() || pos != value.size() || value[0] == '-') {
+            throw invalid_argument("Ожидалось неотрицательное число для --" + name + ": " + value);
+        }
+        return number;
+    }
+
+private:
+    multimap<string, string> values_;
+};
+
+// Печать данных с заменой непечатаемых байтов на '.'
+string printable(const string& data) {
+    string out;
+    for (unsigned char c : data) {
+        out += (c >= 0x20 && c != 0x7F) || c == '\n' ? static_cast<char>(c) : '.';
+    }
+    return out;
+}
+
+string toHex(const string& data) {
+    ostringstream out;
+    for (unsigned char c : data) out << hex << setw(2) << setfill('0') << static_cast<int>(c);
+    return out.str();
+}
+
+// vigenere-analyze: оценка длины ключа и восстановление ключа по шифртексту
+int commandVigenereAnalyze(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"in", "max-period", "reference", "threads", "key-out"}, {});
+    if (!libs.vigenereLib) throw runtime_error("Библиотека Vigenere не загружена");
+
+    MappedFile input(options.require("in"));
+    string reference;
+    if (options.has("reference")) reference = readFileAsBytes(options.get("reference"));
+
+    VigenereAnalysis analysis = libs.vigenereAnalyze(
+        input.data(), input.size(), options.getNumber("max-period", 256),
+        reference, static_cast<unsigned>(options.getNumber("threads", 0)));
+
+    // Лучшие периоды по убыванию оценки
+    vector<size_t> periods(analysis.periodScores.size());
+    for (size_t p = 0; p < periods.size(); ++p) periods[p] = p + 1;
+    sort(periods.begin(), periods.end(), [&](size_t a, size_t b) {
+        return analysis.periodScores[a - 1] > analysis.periodScores[b - 1];
+    });
+
+    cout << "Длина ключа: " << analysis.keyLength << "\n";
+    cout << "Лучшие периоды:";
+    for (size_t i = 0; i < min<size_t>(5, periods.size()); ++i) {
+        cout << " " << periods[i] << " (" << fixed << setprecision(4)
+             << analysis.periodScores[periods[i] - 1] << ")";
+    }
+    cout << "\n";
+    cout << "Ключ (hex): " << toHex(analysis.key) << "\n";
+
+    string preview(input.data(), min<size_t>(input.size(), 160));
+    cout << "Начало расшифровки:\n" << printable(libs.vigenereDecrypt(preview, analysis.key)) << "\n";
+
+    if (options.has("key-out")) {
+        libs.saveVigenereKey(analysis.key, options.get("key-out"));
+        cout << "Ключ сохранен в " << options.get("key-out") << endl;
+    }
+    return 0;
+}
+
+// hill-recover: восстановление ключа Хилла по известному или частично известному тексту
+int commandHillRecover(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"in", "plain", "crib", "crib-offset", "reference", "threads", "key-out"}, {});
+    if (!libs.hillLib) throw runtime_error("Библиотека Hill не загружена");
+
+    string ciphertext = readFileAsBytes(options.require("in"));
+    unsigned threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    HillRecovery recovery;
+    if (options.has("plain")) {
+        if (options.has("crib")) throw invalid_argument("Укажите либо --plain, либо --crib");
+        recovery = libs.hillRecoverKnownPlaintext(readFileAsBytes(options.get("plain")), ciphertext, threads);
+    } else {
+        string reference;
+        if (options.has("reference")) reference = readFileAsBytes(options.get("reference"));
+        recovery = libs.hillSearchKey(ciphertext, options.get("crib"), options.getNumber("crib-offset", 0),
+                                      reference, threads);
+    }
+
+    if (!recovery.found) {
+        cerr << "Ошибка: ключ, согласный с известным текстом, не найден" << endl;
+        return 1;
+    }
+
+    cout << (recovery.solvedDirectly ? "Ключ найден решением системы по известным парам\n"
+                                     : "Ключ найден перебором строк матрицы\n");
+    cout << "Ключ: [" << recovery.key[0][0] << " " << recovery.key[0][1] << "; "
+         << recovery.key[1][0] << " " << recovery.key[1][1] << "]\n";
+    cout << "Согласных ключей: " << recovery.consistentKeys << "\n";
+    if (!recovery.solvedDirectly) {
+        cout << "Оценка расшифровки: " << fixed << setprecision(3) << recovery.score << "\n";
+    }
+
+    string preview = ciphertext.substr(0, 160);
+    cout << "Начало расшифровки:\n" << printable(libs.hillDecrypt(preview, recovery.key)) << "\n";
+
+    if (options.has("key-out")) {
+        libs.saveHillKey(recovery.key, options.get("key-out"));
+        cout << "Ключ сохранен в " << options.get("key-out") << endl;
+    }
+    return 0;
+}
+
+// richelieu-solve: подбор перестановки Ришелье по шифртексту
+int commandRichelieuSolve(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"in", "block", "lang", "corpus", "threads", "restarts", "key-out"}, {});
+    if (!libs.richelieuLib) throw runtime_error("Библиотека Richelieu не загружена");
+
+    string ciphertext = readFileAsBytes(options.require("in"));
+    uint64_t blockSize = options.getNumber("block", 0);
+    if (blockSize == 0 || blockSize > 100000) throw invalid_argument("Укажите размер блока --block");
+    string corpus;
+    if (options.has("corpus")) corpus = readFileAsBytes(options.get("corpus"));
+
+    RichelieuSolution solution = libs.richelieuSolve(
+        ciphertext, static_cast<int>(blockSize), options.get("lang"), corpus,
+        static_cast<unsigned>(options.getNumber("threads", 0)),
+        static_cast<unsigned>(options.getNumber("restarts", 0)));
+
+    cout << "Язык: " << solution.language << "\n";
+    cout << "Ключ: " << solution.key << "\n";
+    cout << "Оценка (log10 на символ): " << fixed << setprecision(3) << solution.score << "\n";
+
+    string preview = libs.richelieuDecrypt(ciphertext.substr(0, 400), solution.key);
+    cout << "Начало расшифровки:\n" << printable(preview) << "\n";
+
+    if (options.has("key-out")) {
+        libs.saveRichelieuKey(solution.key, options.get("key-out"));
+        cout << "Ключ сохранен в " << options.get("key-out") << endl;
+    }
+    return 0;
+}
+
+// Вывод результата в файл --out или в stdout
+void writeOutput(const CommandArgs& options, const string& data) {
+    if (options.has("out")) {
+        writeFileAsBytes(options.get("out"), data);
+    } else {
+        cout.write(data.data(), static_cast<streamsize>(data.size()));
+        cout.flush();
+    }
+}
+
+// keygen: генерация ключа. --size - размер блока (hill-gf: 2..64, по умолчанию 16;
+// richelieu: по умолчанию 8) или длина ключа Виженера (0 - ключ-зерно, по умолчанию 64)
+int commandKeygen(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "out", "size"}, {});
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    const string keyFile = options.require("out");
+    MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_GENERATE);
+    switch (cipher) {
+        case ContainerCipher::HILL:
+            if (!libs.hillLib) throw runtime_error("Библиотека Hill не загружена");
+            libs.saveHillKey(libs.generateHillKey(2), keyFile);
+            break;
+        case ContainerCipher::HILL_GF:
+            if (!libs.hillLib) throw runtime_error("Библиотека Hill не загружена");
+            libs.saveHillGfKey(libs.generateHillGfKey(options.getNumber("size", 16)), keyFile);
+            break;
+        case ContainerCipher::RICHELIEU: {
+            if (!libs.richelieuLib) throw runtime_error("Библиотека Richelieu не загружена");
+            uint64_t size = options.getNumber("size", 8);
+            if (size == 0 || size > 100000) throw invalid_argument("Недопустимый размер блока --size");
+            libs.saveRichelieuKey(libs.generateRichelieuKey(static_cast<int>(size)), keyFile);
+            break;
+        }
+        case ContainerCipher::VIGENERE: {
+            if (!libs.vigenereLib) throw runtime_error("Библиотека Vigenere не загружена");
+            uint64_t size = options.getNumber("size", 64);
+            if (size > INT32_MAX) throw invalid_argument("Недопустимая длина ключа --size");
+            libs.saveVigenereKey(size > 0 ? libs.generateVigenereKey(static_cast<int>(size))
+                                          : libs.generateVigenereSeedKey(), keyFile);
+            break;
+        }
+    }
+    cout << "Ключ сохранен в " << keyFile << endl;
+    return 0;
+}
+
+// encrypt: шифрование файла в контейнер
+int commandEncrypt(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "out", "chunk-size", "compress", "threads"}, {"checksum"});
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    uint64_t chunkSize = options.getNumber("chunk-size", CONTAINER_DEFAULT_CHUNK);
+    if (chunkSize == 0 || chunkSize > UINT32_MAX) throw invalid_argument("Недопустимый размер фрагмента");
+    uint64_t compressLevel = options.getNumber("compress", 0);
+    if (compressLevel > 9) throw invalid_argument("Уровень сжатия --compress: 1..9");
+
+    ContainerOptions containerOptions;
+    containerOptions.chunkSize = static_cast<uint32_t>(chunkSize);
+    containerOptions.checksums = options.has("checksum");
+    containerOptions.compressLevel = static_cast<int>(compressLevel);
+    containerOptions.threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        key = loadContainerKey(libs, cipher, options.require("key"));
+    }
+    vector<string> inputFiles = options.getAll("in");
+    if (inputFiles.empty()) throw invalid_argument("Не указан обязательный параметр --in");
+    if (inputFiles.size() == 1) {
+        // В памяти держатся вход, открытые и зашифрованные фрагменты и
+        // результат; потоковый способ пишет группы фрагментов сразу в --out
+        PlanJob job;
+        job.name = "encrypt";
+        job.inputSize = filesystem::file_size(inputFiles[0]);
+        job.chunkSize = containerOptions.chunkSize;
+        job.threads = containerOptions.threads;
+        job.chunkAdjustable = !options.has("chunk-size");
+        job.streamable = options.has("out");
+        ExecutionPlan plan = planExecution(job);
+
+        MetricsScope metrics(metricCipher(cipher), MetricStage::ENCRYPT, job.inputSize);
+        if (plan.strategy == PlanStrategy::IN_MEMORY) {
+            string plaintext = readFileAsBytes(inputFiles[0]);
+            writeOutput(options, containerEncrypt(libs, key, plaintext, containerOptions));
+            return 0;
+        }
+        MappedFile input(inputFiles[0]);
+        if (plan.strategy == PlanStrategy::MAPPED) {
+            writeOutput(options, containerEncrypt(libs, key, input.data(), input.size(), containerOptions));
+            return 0;
+        }
+        containerOptions.chunkSize = static_cast<uint32_t>(plan.chunkSize);
+        containerOptions.threads = plan.threads;
+        containerEncryptFanOut(libs, {key}, input.data(), input.size(), {options.get("out")}, containerOptions);
+        return 0;
+    }
+
+    // Несколько файлов: пары --in/--out по порядку, чтение и запись пачками,
+    // чтобы с --io=uring запросы всех файлов пачки шли одновременно
+    vector<string> outputFiles = options.getAll("out");
+    if (outputFiles.size() != inputFiles.size()) throw invalid_argument("Укажите по одному --out для каждого --in");
+    const size_t FILE_BATCH = 64;
+    containerOptions.keyCheck = makeKeyCheck(key); //одна соль на все файлы: PBKDF2 один раз
+    for (size_t first = 0; first < inputFiles.size(); first += FILE_BATCH) {
+        size_t last = min(inputFiles.size(), first + FILE_BATCH);
+        vector<string> batchOutputs(outputFiles.begin() + first, outputFiles.begin() + last);
+        vector<string> contents = readFilesAsBytes(vector<string>(inputFiles.begin() + first, inputFiles.begin() + last));
+        for (string& content : contents) {
+            MetricsScope metrics(metricCipher(cipher), MetricStage::ENCRYPT, content.size());
+            content = containerEncrypt(libs, key, content, containerOptions);
+        }
+        writeFilesAsBytes(batchOutputs, contents);
+    }
+    return 0;
+}
+
+// encrypt-tree: инкрементальное шифрование дерева каталогов по манифесту
+int commandEncryptTree(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "out", "manifest", "chunk-size", "compress", "threads"},
+                        {"checksum"});
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    uint64_t chunkSize = options.getNumber("chunk-size", CONTAINER_DEFAULT_CHUNK);
+    if (chunkSize == 0 || chunkSize > UINT32_MAX) throw invalid_argument("Недопустимый размер фрагмента");
+    uint64_t compressLevel = options.getNumber("compress", 0);
+    if (compressLevel > 9) throw invalid_argument("Уровень сжатия --compress: 1..9");
+
+    ContainerOptions containerOptions;
+    containerOptions.chunkSize = static_cast<uint32_t>(chunkSize);
+    containerOptions.checksums = options.has("checksum");
+    containerOptions.compressLevel = static_cast<int>(compressLevel);
+    containerOptions.threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        key = loadContainerKey(libs, cipher, options.require("key"));
+    }
+    IncrementalStats stats = encryptTreeIncremental(libs, key, options.require("in"), options.require("out"),
+                                                    options.get("manifest"), containerOptions);
+
+    cout << "Файлов: " << stats.scanned << ", зашифровано: " << stats.encrypted << ", без изменений: "
+         << stats.unchanged + stats.touched << " (из них сверено по хешу: " << stats.touched << ")"
+         << ", удалено: " << stats.removed << endl;
+    for (const string& error : stats.errors) cerr << "Ошибка: " << error << endl;
+    return stats.errors.empty() ? 0 : 1;
+}
+
+// fanout: шифрование одного файла под несколькими ключами за одно чтение.
+// Пары --key/--out сопоставляются по порядку.
+int commandFanOut(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "out", "chunk-size", "compress", "threads"}, {"checksum"});
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    vector<string> keyFiles = options.getAll("key");
+    vector<string> outputFiles = options.getAll("out");
+    if (keyFiles.empty() || keyFiles.size() != outputFiles.size()) {
+        throw invalid_argument("Укажите по одному --out для каждого --key");
+    }
+    uint64_t chunkSize = options.getNumber("chunk-size", FANOUT_DEFAULT_CHUNK);
+    if (chunkSize == 0 || chunkSize > UINT32_MAX - 1) throw invalid_argument("Недопустимый размер фрагмента");
+    uint64_t compressLevel = options.getNumber("compress", 0);
+    if (compressLevel > 9) throw invalid_argument("Уровень сжатия --compress: 1..9");
+
+    ContainerOptions containerOptions;
+    containerOptions.chunkSize = static_cast<uint32_t>(chunkSize);
+    containerOptions.checksums = options.has("checksum");
+    containerOptions.compressLevel = static_cast<int>(compressLevel);
+    containerOptions.threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    vector<ContainerKey> keys;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        for (const string& keyFile : keyFiles) keys.push_back(loadContainerKey(libs, cipher, keyFile));
+    }
+
+    const string inputFile = options.require("in");
+    for (const string& outputFile : outputFiles) {
+        if (sameFile(inputFile, outputFile)) throw invalid_argument("Выходной файл совпадает со входным: " + outputFile);
+    }
+    MappedFile input(inputFile);
+    MetricsScope metrics(metricCipher(cipher), MetricStage::ENCRYPT, input.size() * keys.size());
+    containerEncryptFanOut(libs, keys, input.data(), input.size(), outputFiles, containerOptions);
+    return 0;
+}
+
+// decrypt: дешифрование контейнера или файла без заголовка, целиком
+// или диапазона [--offset, --offset + --length)
+int commandDecrypt(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "out", "offset", "length", "threads"}, {});
+    const string inputFile = options.require("in");
+    const vector<string> keyFiles = options.getAll("key");
+    if (keyFiles.empty()) throw invalid_argument("Не указан обязательный параметр --key");
+    const bool range = options.has("offset") || options.has("length");
+    const uint64_t offset = options.getNumber("offset", 0);
+    const uint64_t length = options.getNumber("length", UINT64_MAX);
+
+    MappedFile input(inputFile);
+    string plaintext;
+    if (isContainer(input.data(), input.size())) {
+        // Шифр из заголовка, ключ - по проверочному значению среди --key (файлы или каталоги)
+        ContainerHeader header = parseContainerHeader(input.data(), input.size());
+        if (options.has("cipher") && parseContainerCipher(options.get("cipher")) != header.cipher) {
+            throw invalid_argument(string("Контейнер зашифрован шифром ") + containerCipherName(header.cipher));
+        }
+        ContainerKey key;
+        {
+            MetricsScope metrics(metricCipher(header.cipher), MetricStage::KEY_LOAD);
+            key = selectContainerKey(libs, header, keyFiles);
+        }
+        MetricsScope metrics(metricCipher(header.cipher), MetricStage::DECRYPT);
+        const unsigned threads = static_cast<unsigned>(options.getNumber("threads", 0));
+        if (range) {
+            plaintext = containerDecrypt(libs, key, header, input.data(), offset, length, threads);
+            metrics.setBytes(plaintext.size());
+            writeOutput(options, plaintext);
+            return 0;
+        }
+
+        // Вход уже отображен: в памяти результат и копии фрагментов. Потоковый
+        // способ пишет окна фрагментов по порядку (в файл или stdout), поэтому
+        // доступен всегда; размер фрагмента задан контейнером.
+        PlanJob job;
+        job.name = "decrypt";
+        job.inputSize = header.plainLength;
+        job.chunkSize = header.chunkSize;
+        job.threads = threads;
+        job.chunkAdjustable = false;
+        job.streamable = true;
+        job.inMemoryFactor = 2;
+        job.mappedFactor = 2;
+        ExecutionPlan plan = planExecution(job);
+        metrics.setBytes(header.plainLength);
+        if (plan.strategy != PlanStrategy::STREAMING) {
+            writeOutput(options, containerDecrypt(libs, key, header, input.data(), 0, UINT64_MAX, plan.threads));
+            return 0;
+        }
+
+        // Результат во временный файл: --out может совпадать с отображенным
+        // входом, который читается до конца записи
+        unique_ptr<StagedFile> staged;
+        ofstream outputFile;
+        if (options.has("out")) {
+            staged = make_unique<StagedFile>(options.get("out"));
+            outputFile.open(staged->path(), ios::binary | ios::trunc);
+            if (!outputFile) throw runtime_error("Не удалось создать файл: " + options.get("out"));
+        }
+        ostream& out = options.has("out") ? static_cast<ostream&>(outputFile) : cout;
+        containerDecryptTo(libs, key, header, input.data(), out, plan.threads);
+        if (!out.flush()) throw runtime_error("Ошибка записи результата");
+        if (staged) {
+            outputFile.close();
+            staged->commit();
+        }
+        return 0;
+    }
+
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    if (keyFiles.size() != 1) throw invalid_argument("Для файла без контейнера укажите один ключ");
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        key = loadContainerKey(libs, cipher, keyFiles[0]);
+    }
+
+    MetricsScope metrics(metricCipher(cipher), MetricStage::DECRYPT);
+    switch (cipher) {
+        case ContainerCipher::VIGENERE: {
+            // Ключ в отображении: целый файл с --out проходится потоком вместе
+            // с ключом, иначе расшифровывается диапазон отображения
+            if (!range && options.has("out")) {
+                libs.vigenereDecryptFileKeyFile(inputFile, options.get("out"), keyFiles[0]);
+                metrics.setBytes(input.size());
+                return 0;
+            }
+            uint64_t begin = min<uint64_t>(offset, input.size());
+            size_t size = static_cast<size_t>(min<uint64_t>(length, input.size() - begin));
+            plaintext.resize(size);
+            libs.vigenereApply(input.data() + begin, size, key.bytes(), key.size(), begin, true, &plaintext[0]);
+            break;
+        }
+        case ContainerCipher::HILL:
+            plaintext = range ? libs.hillDecryptFileRange(inputFile, offset, length, key.matrix)
+                              : libs.hillDecrypt(string(input.data(), input.size()), key.matrix);
+            break;
+        case ContainerCipher::HILL_GF: {
+            // Блоки выровнены по началу файла: диапазон расширяется до целых
+            // блоков (неполный последний блок не шифруется), лишнее отрезается
+            uint64_t block = key.matrix.size();
+            uint64_t begin = min<uint64_t>(offset, input.size());
+            uint64_t end = begin + min<uint64_t>(length, input.size() - begin);
+            uint64_t alignedBegin = begin / block * block;
+            uint64_t alignedEnd = min<uint64_t>(input.size(), (end + block - 1) / block * block);
+            plaintext = libs.hillGfDecrypt(string(input.data() + alignedBegin, alignedEnd - alignedBegin), key.matrix)
+                            .substr(begin - alignedBegin, end - begin);
+            break;
+        }
+        case ContainerCipher::RICHELIEU:
+            // Блоки Ришелье состоят из символов UTF-8 переменной длины, поэтому
+            // байтовое смещение не определяет границу блока (в контейнере можно)
+            if (range) throw invalid_argument("Шифр richelieu не поддерживает дешифрование диапазона вне контейнера");
+            plaintext = libs.richelieuDecrypt(string(input.data(), input.size()), key.text);
+            break;
+    }
+    metrics.setBytes(plaintext.size());
+    writeOutput(options, plaintext);
+    return 0;
+}
+
+// Потоковая обработка порциями: контекст шифра и его функции (контекст
+// освобождается вместе с объектом)
+struct CipherStream {
+    shared_ptr<void> context;
+    function<void(const char*, size_t, string&)> update;
+    function<void(string&)> finish;
+};
+
+// Освобождение страниц отображенного ключа Виженера, пройденных на позициях
+// [position, position + size): бегущий ключ длиной с данные не копится в
+// памяти. Короткий повторяющийся ключ нужен целиком и не освобождается.
+void releaseKeyPages(const MappedFile* key, uint64_t position, size_t size) {
+    const size_t RELEASE_MIN_KEY = 4 << 20;
+    if (!key || key->size() < RELEASE_MIN_KEY) return;
+    size_t keyPos = static_cast<size_t>(position % key->size());
+    size_t first = min(size, key->size() - keyPos);
+    key->release(keyPos, first);
+    if (first < size) key->release(0, min(size - first, key->size()));
+}
+
+CipherStream openCipherStream(const CipherLibs& libs, const ContainerKey& key, bool decrypt) {
+    CipherStream stream;
+    switch (key.cipher) {
+        case ContainerCipher::HILL:
+        case ContainerCipher::HILL_GF: {
+            HillContext* hill = key.cipher == ContainerCipher::HILL ? libs.hillInit(key.matrix, decrypt)
+                                                                    : libs.hillGfInit(key.matrix, decrypt);
+            stream.context.reset(hill, [&libs](void* p) { libs.hillFree(static_cast<HillContext*>(p)); });
+            stream.update = [&libs, hill](const char* data, size_t size, string& out) {
+                libs.hillUpdate(hill, data, size, out);
+            };
+            stream.finish = [&libs, hill](string& out) { libs.hillFinal(hill, out); };
+            break;
+        }
+        case ContainerCipher::RICHELIEU: {
+            RichelieuContext* richelieu = libs.richelieuInit(key.text, decrypt);
+            stream.context.reset(richelieu, [&libs](void* p) { libs.richelieuFree(static_cast<RichelieuContext*>(p)); });
+            stream.update = [&libs, richelieu](const char* data, size_t size, string& out) {
+                libs.richelieuUpdate(richelieu, data, size, out);
+            };
+            stream.finish = [&libs, richelieu](string& out) { libs.richelieuFinal(richelieu, out); };
+            break;
+        }
+        case ContainerCipher::VIGENERE: {
+            // Ключ не копируется: контекст ссылается на отображение ключа,
+            // которое лямбда держит живым и освобождает по мере прохода
+            VigenereContext* vigenere = libs.vigenereInit(key.bytes(), key.size(), decrypt);
+            stream.context.reset(vigenere, [&libs](void* p) { libs.vigenereFree(static_cast<VigenereContext*>(p)); });
+            auto position = make_shared<uint64_t>(0);
+            stream.update = [&libs, vigenere, mapped = key.mapped, position](const char* data, size_t size,
+                                                                              string& out) {
+                libs.vigenereUpdate(vigenere, data, size, out);
+                releaseKeyPages(mapped.get(), *position, size);
+                *position += size;
+            };
+            stream.finish = [&libs, vigenere](string& out) { libs.vigenereFinal(vigenere, out); };
+            break;
+        }
+    }
+    return stream;
+}
+
+// Вход (--in, по умолчанию stdin) читается порциями chunkSize, готовый
+// результат каждой порции сразу пишется в --out (по умолчанию stdout),
+// поэтому память не зависит от длины входа. Возвращает число байтов входа.
+uint64_t pipeStream(const CommandArgs& options, uint64_t chunkSize, CipherStream& stream) {
+    ifstream inputFile;
+    if (options.has("in")) {
+        inputFile.open(options.get("in"), ios::binary);
+        if (!inputFile) throw runtime_error("Не удалось открыть файл: " + options.get("in"));
+    }
+    ofstream outputFile;
+    if (options.has("out")) {
+        outputFile.open(options.get("out"), ios::binary | ios::trunc);
+        if (!outputFile) throw runtime_error("Не удалось создать файл: " + options.get("out"));
+    }
+    istream& in = options.has("in") ? static_cast<istream&>(inputFile) : cin;
+    ostream& out = options.has("out") ? static_cast<ostream&>(outputFile) : cout;
+
+    string chunk(chunkSize, '\0'), result;
+    uint64_t total = 0;
+    while (in) {
+        size_t size;
+        {
+            RGR_TRACE_SCOPE("read chunk", "stream");
+            in.read(&chunk[0], static_cast<streamsize>(chunk.size()));
+            size = static_cast<size_t>(in.gcount());
+        }
+        if (size == 0) break;
+        total += size;
+        result.clear();
+        {
+            RGR_TRACE_SCOPE("update", "stream", size);
+            stream.update(chunk.data(), size, result);
+        }
+        RGR_TRACE_SCOPE("write chunk", "stream", result.size());
+        out.write(result.data(), static_cast<streamsize>(result.size()));
+    }
+    if (in.bad()) throw runtime_error("Ошибка чтения входа");
+    result.clear();
+    stream.finish(result);
+    out.write(result.data(), static_cast<streamsize>(result.size()));
+    if (!out.flush()) throw runtime_error("Ошибка записи результата");
+    return total;
+}
+
+uint64_t streamChunkSize(const CommandArgs& options) {
+    uint64_t chunkSize = options.getNumber("chunk-size", 64 << 10);
+    if (chunkSize == 0 || chunkSize > (1ULL << 30)) throw invalid_argument("Недопустимый размер порции --chunk-size");
+    return chunkSize;
+}
+
+// stream: шифрование/дешифрование без контейнера через потоковые контексты
+// библиотек порциями --chunk-size
+int commandStream(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "out", "chunk-size"}, {"decrypt"});
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    const bool decrypt = options.has("decrypt");
+    uint64_t chunkSize = streamChunkSize(options);
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        key = loadContainerKey(libs, cipher, options.require("key"));
+    }
+    CipherStream stream = openCipherStream(libs, key, decrypt);
+    MetricsScope metrics(metricCipher(cipher), decrypt ? MetricStage::DECRYPT : MetricStage::ENCRYPT);
+    metrics.setBytes(pipeStream(options, chunkSize, stream));
+    return 0;
+}
+
+// rekey: смена ключа без открытого текста. Контейнер (шифр - из заголовка,
+// --old-key может быть каталогом) преобразуется целиком с пересчетом CRC32C;
+// файл без контейнера (нужен --cipher) - потоком порциями --chunk-size
+int commandRekey(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "old-key", "new-key", "in", "out", "chunk-size", "threads"}, {});
+    const string inputFile = options.require("in");
+    unsigned threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    MappedFile input(inputFile);
+    if (isContainer(input.data(), input.size())) {
+        ContainerHeader header = parseContainerHeader(input.data(), input.size());
+        if (options.has("cipher") && parseContainerCipher(options.get("cipher")) != header.cipher) {
+            throw invalid_argument(string("Контейнер зашифрован шифром ") + containerCipherName(header.cipher));
+        }
+        RekeyTransform transform;
+        {
+            MetricsScope metrics(metricCipher(header.cipher), MetricStage::KEY_LOAD);
+            ContainerKey oldKey = selectContainerKey(libs, header, options.getAll("old-key"));
+            transform = makeRekeyTransform(libs, oldKey, loadContainerKey(libs, header.cipher, options.require("new-key")));
+        }
+        string container;
+        {
+            MetricsScope metrics(metricCipher(header.cipher), MetricStage::ENCRYPT, header.plainLength);
+            container = containerRekey(libs, transform, header, input.data(), threads);
+        }
+        writeOutput(options, container);
+        return 0;
+    }
+
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    uint64_t chunkSize = streamChunkSize(options);
+    RekeyTransform transform;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        transform = makeRekeyTransform(libs, loadContainerKey(libs, cipher, options.require("old-key")),
+                                       loadContainerKey(libs, cipher, options.require("new-key")));
+    }
+    // Хилл и Ришелье - шифрование составным ключом (контекст переносит неполный
+    // блок между порциями), Виженер - разность гамм с текущей позиции потока
+    CipherStream stream;
+    if (cipher == ContainerCipher::VIGENERE) {
+        auto position = make_shared<uint64_t>(0);
+        stream.update = [&libs, &transform, position](const char* data, size_t size, string& out) {
+            size_t at = out.size();
+            out.resize(at + size);
+            libs.vigenereRekeyApply(data, size, transform.oldKey.bytes(), transform.oldKey.size(),
+                                    transform.newKey.bytes(), transform.newKey.size(), *position, &out[at]);
+            releaseKeyPages(transform.oldKey.mapped.get(), *position, size);
+            releaseKeyPages(transform.newKey.mapped.get(), *position, size);
+            *position += size;
+        };
+        stream.finish = [](string&) {};
+    } else {
+        stream = openCipherStream(libs, transform.composed, false);
+    }
+    MetricsScope metrics(metricCipher(cipher), MetricStage::ENCRYPT);
+    metrics.setBytes(pipeStream(options, chunkSize, stream));
+    return 0;
+}
+
+// pack: упаковка множества файлов и каталогов в один зашифрованный архив
+int commandPack(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "out", "compress", "threads"}, {"checksum"});
+    ContainerCipher cipher = parseContainerCipher(options.require("cipher"));
+    uint64_t compressLevel = options.getNumber("compress", 0);
+    if (compressLevel > 9) throw invalid_argument("Уровень сжатия --compress: 1..9");
+    vector<string> inputs = options.getAll("in");
+    if (inputs.empty()) throw invalid_argument("Не указан обязательный параметр --in");
+
+    ContainerOptions archiveOptions;
+    archiveOptions.checksums = options.has("checksum");
+    archiveOptions.compressLevel = static_cast<int>(compressLevel);
+    archiveOptions.threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        key = loadContainerKey(libs, cipher, options.require("key"));
+    }
+    ArchiveStats stats = archivePack(libs, key, inputs, options.require("out"), archiveOptions);
+    cout << "Упаковано файлов: " << stats.files << ", байт: " << stats.bytes << endl;
+    for (const string& error : stats.errors) cerr << "Ошибка: " << error << endl;
+    return stats.errors.empty() ? 0 : 1;
+}
+
+// unpack: извлечение всех записей архива или записей --file в каталог --out;
+// одна запись без --out выводится в stdout
+int commandUnpack(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"key", "in", "out", "file", "threads"}, {});
+    MappedFile input(options.require("in"));
+    ArchiveIndex index = parseArchiveIndex(input.data(), input.size());
+    vector<string> names = options.getAll("file");
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(index.cipher), MetricStage::KEY_LOAD);
+        ContainerHeader header; //подбор ключа по шифру и проверочному значению, как у контейнера
+        header.cipher = index.cipher;
+        header.keyCheck = index.keyCheck;
+        key = selectContainerKey(libs, header, options.getAll("key"));
+    }
+    if (!options.has("out")) {
+        if (names.size() != 1) throw invalid_argument("Без --out укажите ровно одну запись --file");
+        auto it = find_if(index.entries.begin(), index.entries.end(),
+                          [&](const ArchiveEntry& entry) { return entry.name == names[0]; });
+        if (it == index.entries.end()) throw runtime_error("Нет записи в архиве: " + names[0]);
+        writeOutput(options, archiveReadEntry(libs, key, index, input.data(), *it));
+        return 0;
+    }
+    ArchiveStats stats = archiveExtract(libs, key, index, input.data(), options.get("out"), names,
+                                        static_cast<unsigned>(options.getNumber("threads", 0)));
+    cout << "Извлечено файлов: " << stats.files << ", байт: " << stats.bytes << endl;
+    for (const string& error : stats.errors) cerr << "Ошибка: " << error << endl;
+    return stats.errors.empty() ? 0 : 1;
+}
+
+// dedup: добавление файлов и каталогов в хранилище с дедупликацией
+// (создается при первом добавлении; --cipher и --chunk-size - только тогда)
+int commandDedup(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"cipher", "key", "in", "store", "chunk-size", "compress", "threads"}, {});
+    const string storeDir = options.require("store");
+    vector<string> inputs = options.getAll("in");
+    if (inputs.empty()) throw invalid_argument("Не указан обязательный параметр --in");
+    uint64_t compressLevel = options.getNumber("compress", 0);
+    if (compressLevel > 9) throw invalid_argument("Уровень сжатия --compress: 1..9");
+    uint64_t chunkSize = options.getNumber("chunk-size", DEDUP_DEFAULT_CHUNK);
+    if (chunkSize > UINT32_MAX) throw invalid_argument("Недопустимый размер фрагмента");
+
+    ContainerCipher cipher;
+    if (isDedupStore(storeDir)) {
+        cipher = loadDedupCatalog(storeDir).cipher;
+        if (options.has("cipher") && parseContainerCipher(options.get("cipher")) != cipher) {
+            throw invalid_argument(string("Хранилище зашифровано шифром ") + containerCipherName(cipher));
+        }
+    } else {
+        cipher = parseContainerCipher(options.require("cipher"));
+    }
+
+    ContainerOptions storeOptions;
+    storeOptions.chunkSize = static_cast<uint32_t>(chunkSize);
+    storeOptions.compressLevel = static_cast<int>(compressLevel);
+    storeOptions.threads = static_cast<unsigned>(options.getNumber("threads", 0));
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(cipher), MetricStage::KEY_LOAD);
+        key = loadContainerKey(libs, cipher, options.require("key"));
+    }
+    DedupStats stats = dedupAdd(libs, key, inputs, storeDir, storeOptions);
+    cout << "Добавлено файлов: " << stats.files << ", байт: " << stats.bytes << ", фрагментов: " << stats.chunks
+         << " (новых " << stats.newChunks << "), записано байт: " << stats.storedBytes << endl;
+    for (const string& error : stats.errors) cerr << "Ошибка: " << error << endl;
+    return stats.errors.empty() ? 0 : 1;
+}
+
+// dedup-restore: восстановление всех файлов хранилища или файлов --file в
+// каталог --out; один файл без --out выводится в stdout
+int commandDedupRestore(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"key", "store", "out", "file", "threads"}, {});
+    const string storeDir = options.require("store");
+    DedupCatalog catalog = loadDedupCatalog(storeDir);
+    vector<string> names = options.getAll("file");
+
+    ContainerKey key;
+    {
+        MetricsScope metrics(metricCipher(catalog.cipher), MetricStage::KEY_LOAD);
+        ContainerHeader header; //подбор ключа по шифру и проверочному значению, как у контейнера
+        header.cipher = catalog.cipher;
+        header.keyCheck = catalog.keyCheck;
+        key = selectContainerKey(libs, header, options.getAll("key"));
+    }
+    if (!options.has("out")) {
+        if (names.size() != 1) throw invalid_argument("Без --out укажите ровно один файл --file");
+        auto it = find_if(catalog.files.begin(), catalog.files.end(),
+                          [&](const DedupFile& file) { return file.name == names[0]; });
+        if (it == catalog.files.end()) throw runtime_error("Нет файла в хранилище: " + names[0]);
+        MappedFile chunks(dedupChunksFile(storeDir));
+        if (chunks.size() < catalog.dataSize) throw runtime_error("Хранилище повреждено: файл фрагментов короче каталога");
+        dedupWriteFile(libs, key, catalog, chunks.data(), *it, cout);
+        if (!cout.flush()) throw runtime_error("Ошибка записи результата");
+        return 0;
+    }
+    DedupStats stats = dedupRestore(libs, key, catalog, storeDir, options.get("out"), names,
+                                    static_cast<unsigned>(options.getNumber("threads", 0)));
+    cout << "Восстановлено файлов: " << stats.files << ", байт: " << stats.bytes << endl;
+    for (const string& error : stats.errors) cerr << "Ошибка: " << error << endl;
+    return stats.errors.empty() ? 0 : 1;
+}
+
+// Содержимое хранилища с дедупликацией по каталогу
+void listDedupStore(const string& storeDir) {
+    DedupCatalog catalog = loadDedupCatalog(storeDir);
+    uint64_t plainTotal = 0, references = 0;
+    for (const DedupFile& file : catalog.files) {
+        cout << setw(12) << file.size << " " << setw(8) << file.chunks.size() << "  " << file.name << "\n";
+        plainTotal += file.size;
+        references += file.chunks.size();
+    }
+    cout << "Шифр: " << containerCipherName(catalog.cipher) << ", файлов: " << catalog.files.size()
+         << ", байт: " << plainTotal << ", фрагментов: " << references << " (уникальных " << catalog.chunks.size()
+         << ", средний размер " << catalog.averageChunk << "), в хранилище байт: " << catalog.dataSize << endl;
+}
+
+// list: содержимое архива по индексу или хранилища с дедупликацией по
+// каталогу (ключ не нужен)
+int commandList(const vector<string>& args, const CipherLibs&) {
+    CommandArgs options(args, {"in"}, {});
+    if (isDedupStore(options.require("in"))) {
+        listDedupStore(options.get("in"));
+        return 0;
+    }
+    MappedFile input(options.require("in"));
+    ArchiveIndex index = parseArchiveIndex(input.data(), input.size());
+    uint64_t plainTotal = 0, cipherTotal = 0;
+    for (const ArchiveEntry& entry : index.entries) {
+        cout << setw(12) << entry.plainLength << " " << setw(12) << entry.cipherLength
+             << (entry.compressed ? " z " : "   ") << entry.name << "\n";
+        plainTotal += entry.plainLength;
+        cipherTotal += entry.cipherLength;
+    }
+    cout << "Шифр: " << containerCipherName(index.cipher) << ", записей: " << index.entries.size()
+         << ", байт: " << plainTotal << " (в архиве " << cipherTotal << ")"
+         << (index.checksums ? ", CRC32C" : "") << endl;
+    return 0;
+}
+
+// verify: проверка целостности контейнера по CRC32C без ключа
+int commandVerify(const vector<string>& args, const CipherLibs&) {
+    CommandArgs options(args, {"in", "threads"}, {});
+    MappedFile input(options.require("in"));
+    ContainerHeader header = parseContainerHeader(input.data(), input.size());
+
+    vector<size_t> corrupted;
+    {
+        MetricsScope metrics(metricCipher(header.cipher), MetricStage::READ, input.size());
+        corrupted = containerVerify(header, input.data(), static_cast<unsigned>(options.getNumber("threads", 0)));
+    }
+    if (corrupted.empty()) {
+        cout << "Фрагментов: " << header.chunks.size() << ", все целы" << endl;
+        return 0;
+    }
+    cout << "Поврежденные фрагменты (" << corrupted.size() << " из " << header.chunks.size() << "):";
+    for (size_t i : corrupted) cout << " " << i;
+    cout << endl;
+    return 1;
+}
+
+// Синтетический текст из английских и русских слов (детерминированный)
+string benchmarkText(size_t size) {
+    static const char* const words[] = {
+        "the", "river", "town", "morning", "boats", "water", "houses", "harbour", "storm", "music",
+        "город", "река", "утро", "лодки", "вода", "дома", "пристань", "буря", "музыка", "площадь"};
+    mt19937 gen(2024);
+    uniform_int_distribution<size_t> pick(0, sizeof(words) / sizeof(words[0]) - 1);
+    string text;
+    text.reserve(size + 32);
+    while (text.size() < size) {
+        text += words[pick(gen)];
+        text += gen() % 12 == 0 ? ".\n" : " ";
+    }
+    // Обрезка по границе символа UTF-8
+    size_t end = size;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) --end;
+    text.resize(end);
+    return text;
+}
+
+// Строка профиля операции над bytes байтами: IPC и события на байт/МБ
+string profileSummary(const PerfCounts& counters, uint64_t bytes) {
+    ostringstream out;
+    out << fixed;
+    auto value = [&](PerfEvent event) { return static_cast<double>(counters[event]); };
+    if (perfAvailable(PerfEvent::CYCLES) && perfAvailable(PerfEvent::INSTRUCTIONS) && counters[PerfEvent::CYCLES] > 0) {
+        out << " IPC " << setprecision(2) << value(PerfEvent::INSTRUCTIONS) / value(PerfEvent::CYCLES);
+    }
+    if (bytes == 0) return out.str();
+    if (perfAvailable(PerfEvent::CYCLES)) {
+        out << ", тактов/Б " << setprecision(2) << value(PerfEvent::CYCLES) / bytes;
+    }
+    if (perfAvailable(PerfEvent::CACHE_MISSES)) {
+        out << ", кэш-промахов/Б " << setprecision(5) << value(PerfEvent::CACHE_MISSES) / bytes;
+    }
+    if (perfAvailable(PerfEvent::BRANCH_MISSES)) {
+        out << ", промахов ветвлений/Б " << setprecision(5) << value(PerfEvent::BRANCH_MISSES) / bytes;
+    }
+    if (perfAvailable(PerfEvent::TASK_CLOCK)) {
+        out << ", ЦП нс/Б " << setprecision(2) << value(PerfEvent::TASK_CLOCK) / bytes;
+    }
+    if (perfAvailable(PerfEvent::PAGE_FAULTS)) {
+        out << ", стр. ошибок/МБ " << setprecision(1) << value(PerfEvent::PAGE_FAULTS) * 1e6 / bytes;
+    }
+    string summary = out.str();
+    return summary.rfind(", ", 0) == 0 ? summary.substr(1) : summary;
+}
+
+// bench: скорость шифров на синтетическом тексте. Это же нагрузка, на которой
+// обучается профиль PGO статической сборки (make static).
+int commandBench(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {"size", "iterations", "threads"}, {});
+    uint64_t sizeMiB = options.getNumber("size", 4);
+    uint64_t iterations = options.getNumber("iterations", 3);
+    if (sizeMiB == 0 || sizeMiB > 4096 || iterations == 0) throw invalid_argument("Недопустимые --size или --iterations");
+    const string text = benchmarkText(sizeMiB << 20);
+
+    cout << "Объем: " << sizeMiB << " МиБ, повторов: " << iterations << "\n";
+    cout << "Шифр                       шифр., МБ/с   дешифр., МБ/с\n"; //setw считает байты, а не символы
+
+    // Лучшее время из повторов; результат дешифрования сверяется с текстом
+    // С --profile под строкой шифра - счетчики за все повторы
+    auto run = [&](const string& name, MetricCipher cipher, const function<string(const string&)>& encrypt,
+                   const function<string(const string&)>& decrypt) {
+        double bestEncrypt = INFINITY, bestDecrypt = INFINITY;
+        PerfCounts encryptCounters, decryptCounters;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            PerfCounts before = perfRead();
+            auto start = chrono::steady_clock::now();
+            string ciphertext;
+            {
+                MetricsScope metrics(cipher, MetricStage::ENCRYPT, text.size());
+                ciphertext = encrypt(text);
+            }
+            auto middle = chrono::steady_clock::now();
+            PerfCounts between = perfRead();
+            string plaintext;
+            {
+                MetricsScope metrics(cipher, MetricStage::DECRYPT, ciphertext.size());
+                plaintext = decrypt(ciphertext);
+            }
+            auto finish = chrono::steady_clock::now();
+            PerfCounts after = perfRead();
+            for (size_t e = 0; e < PERF_EVENTS; ++e) {
+                encryptCounters.values[e] += between.values[e] - before.values[e];
+                decryptCounters.values[e] += after.values[e] - between.values[e];
+            }
+            if (plaintext.compare(0, text.size(), text) != 0) throw runtime_error("Ошибка проверки: " + name);
+            bestEncrypt = min(bestEncrypt, chrono::duration<double>(middle - start).count());
+            bestDecrypt = min(bestDecrypt, chrono::duration<double>(finish - middle).count());
+        }
+        double megabytes = text.size() / 1e6;
+        cout << left << setw(22) << name << right << fixed << setprecision(1)
+             << setw(16) << megabytes / bestEncrypt << setw(16) << megabytes / bestDecrypt << endl;
+        if (perfEnabled()) {
+            cout << "  шифр.:  " << profileSummary(encryptCounters, text.size() * iterations) << "\n";
+            cout << "  дешифр.:" << profileSummary(decryptCounters, text.size() * iterations) << endl;
+        }
+    };
+
+    // Короткие сообщения (16-200 байтов) с 16 ключами по кругу: отдельные
+    // вызовы на каждое сообщение против одного пакетного вызова
+    const size_t BATCH_KEYS = 16;
+    auto splitMessages = [&](const string& s) {
+        vector<CipherMessage> messages;
+        for (size_t pos = 0, i = 0; pos < s.size(); ++i) {
+            size_t size = min<size_t>(16 + (i * 37) % 185, s.size() - pos);
+            messages.push_back({s.data() + pos, size, i % BATCH_KEYS});
+            pos += size;
+        }
+        return messages;
+    };
+    auto perMessage = [&](const string& s, const function<string(const string&, size_t)>& process) {
+        string result;
+        result.reserve(s.size());
+        for (const CipherMessage& message : splitMessages(s)) {
+            result += process(string(message.data, message.size), message.key);
+        }
+        return result;
+    };
+
+    unsigned threads = static_cast<unsigned>(options.getNumber("threads", 0));
+    if (libs.hillLib) {
+        vector<vector<int>> key = libs.generateHillKey(2);
+        run("hill", MetricCipher::HILL, [&](const string& s) { return libs.hillEncrypt(s, key); },
+            [&](const string& s) { return libs.hillDecrypt(s, key); });
+
+        vector<vector<vector<int>>> keys;
+        for (size_t k = 0; k < BATCH_KEYS; ++k) keys.push_back(libs.generateHillKey(2));
+        run("hill short calls", MetricCipher::HILL,
+            [&](const string& s) { return perMessage(s, [&](const string& m, size_t k) { return libs.hillEncrypt(m, keys[k]); }); },
+            [&](const string& s) { return perMessage(s, [&](const string& m, size_t k) { return libs.hillDecrypt(m, keys[k]); }); });
+        run("hill short batch", MetricCipher::HILL,
+            [&](const string& s) {
+                vector<CipherMessage> messages = splitMessages(s);
+                return libs.hillEncryptBatch(messages.data(), messages.size(), keys.data(), keys.size()).arena;
+            },
+            [&](const string& s) {
+                vector<CipherMessage> messages = splitMessages(s);
+                return libs.hillDecryptBatch(messages.data(), messages.size(), keys.data(), keys.size()).arena;
+            });
+    }
+    if (libs.hillLib) {
+        vector<vector<int>> key = libs.generateHillGfKey(16);
+        run("hill-gf 16x16", MetricCipher::HILL, [&](const string& s) { return libs.hillGfEncrypt(s, key); },
+            [&](const string& s) { return libs.hillGfDecrypt(s, key); });
+    }
+    if (libs.vigenereLib) {
+        string key = libs.generateVigenereKey(64);
+        run("vigenere", MetricCipher::VIGENERE, [&](const string& s) { return libs.vigenereEncrypt(s, key); },
+            [&](const string& s) { return libs.vigenereDecrypt(s, key); });
+
+        string seedKey = libs.generateVigenereSeedKey();
+        run("vigenere seeded", MetricCipher::VIGENERE, [&](const string& s) { return libs.vigenereEncrypt(s, seedKey); },
+            [&](const string& s) { return libs.vigenereDecrypt(s, seedKey); });
+
+        vector<string> keys;
+        for (size_t k = 0; k < BATCH_KEYS; ++k) keys.push_back(libs.generateVigenereKey(32));
+        run("vigenere short calls", MetricCipher::VIGENERE,
+            [&](const string& s) { return perMessage(s, [&](const string& m, size_t k) { return libs.vigenereEncrypt(m, keys[k]); }); },
+            [&](const string& s) { return perMessage(s, [&](const string& m, size_t k) { return libs.vigenereDecrypt(m, keys[k]); }); });
+        run("vigenere short batch", MetricCipher::VIGENERE,
+            [&](const string& s) {
+                vector<CipherMessage> messages = splitMessages(s);
+                return libs.vigenereEncryptBatch(messages.data(), messages.size(), keys.data(), keys.size()).arena;
+            },
+            [&](const string& s) {
+                vector<CipherMessage> messages = splitMessages(s);
+                return libs.vigenereDecryptBatch(messages.data(), messages.size(), keys.data(), keys.size()).arena;
+            });
+
+        // Путь контейнера: фрагменты, CRC32C и сжатие
+        ContainerKey containerKey;
+        containerKey.cipher = ContainerCipher::VIGENERE;
+        containerKey.text = key;
+        ContainerOptions containerOptions;
+        containerOptions.checksums = true;
+        containerOptions.compressLevel = 1;
+        containerOptions.threads = threads;
+        containerOptions.keyCheck = makeKeyCheck(containerKey); //PBKDF2 не входит в замер
+        run("vigenere container", MetricCipher::VIGENERE,
+            [&](const string& s) { return containerEncrypt(libs, containerKey, s, containerOptions); },
+            [&](const string& s) {
+                ContainerHeader header = parseContainerHeader(s.data(), s.size());
+                return containerDecrypt(libs, containerKey, header, s.data(), 0, UINT64_MAX, threads);
+            });
+    }
+    if (libs.richelieuLib) {
+        string key = libs.generateRichelieuKey(8);
+        run("richelieu", MetricCipher::RICHELIEU, [&](const string& s) { return libs.richelieuEncrypt(s, key); },
+            [&](const string& s) { return libs.richelieuDecrypt(s, key); });
+    }
+    return 0;
+}
+
+// kernels: доступные варианты ядер и выбранный вариант для каждой корзины
+// размеров (после автоподбора или --kernels=...)
+int commandKernels(const vector<string>& args, const CipherLibs& libs) {
+    CommandArgs options(args, {}, {});
+    string cache = kernelCachePath();
+    cout << "Кэш выбора: " << (cache.empty() ? "не используется" : cache) << "\n";
+    const KernelSelection& selection = currentKernels();
+    for (const auto& [family, names] : availableKernels(libs)) {
+        cout << family << ":";
+        for (const string& name : names) cout << " " << name;
+        cout << "\n";
+        auto chosen = selection.find(family);
+        if (chosen == selection.end()) continue;
+        for (size_t bucket = 0; bucket < KERNEL_BUCKETS; ++bucket) {
+            cout << "  ~" << kernelBucketSample(bucket) << " байт: " << chosen->second[bucket] << "\n";
+        }
+    }
+    return 0;
+}
+
+struct CommandInfo {
+    int (*run)(const vector<string>&, const CipherLibs&);
+    const char* usage;
+    bool ciphers = false; // работает ядрами шифров: перед запуском выполняется отложенный подбор
+};
+
+const map<string, CommandInfo>& commandTable() {
+    static const map<string, CommandInfo> table = {
+        {"bench", {commandBench, "[--size МиБ] [--iterations N] [--threads N]", true}},
+        {"decrypt", {commandDecrypt,
+            "--key КЛЮЧ|КАТАЛОГ [--key ...] --in ФАЙЛ [--cipher hill|hill-gf|richelieu|vigenere] [--out ФАЙЛ]"
+            " [--offset N] [--length N] [--threads N]", true}},
+        {"dedup", {commandDedup,
+            "--key КЛЮЧ --in ФАЙЛ|КАТАЛОГ [--in ...] --store КАТАЛОГ [--cipher hill|hill-gf|richelieu|vigenere]"
+            " [--chunk-size N] [--compress 1..9] [--threads N]", true}},
+        {"dedup-restore", {commandDedupRestore,
+            "--key КЛЮЧ|КАТАЛОГ [--key ...] --store КАТАЛОГ [--out КАТАЛОГ] [--file ИМЯ ...] [--threads N]", true}},
+        {"encrypt", {commandEncrypt,
+            "--cipher hill|hill-gf|richelieu|vigenere --key КЛЮЧ --in ФАЙЛ [--out ФАЙЛ] [--in ФАЙЛ --out ФАЙЛ ...] [--chunk-size N] [--checksum]"
+            " [--compress 1..9] [--threads N]", true}},
+        {"encrypt-tree", {commandEncryptTree,
+            "--cipher hill|hill-gf|richelieu|vigenere --key КЛЮЧ --in КАТАЛОГ --out КАТАЛОГ [--manifest ФАЙЛ]"
+            " [--chunk-size N] [--checksum] [--compress 1..9] [--threads N]", true}},
+        {"fanout", {commandFanOut,
+            "--cipher hill|hill-gf|vigenere --in ФАЙЛ --key КЛЮЧ --out ФАЙЛ [--key КЛЮЧ --out ФАЙЛ ...] [--chunk-size N]"
+            " [--checksum] [--compress 1..9] [--threads N]", true}},
+        {"hill-recover", {commandHillRecover,
+            "--in ШИФРТЕКСТ [--plain ОТКРЫТЫЙ | --crib ТЕКСТ [--crib-offset N]] [--reference ОБРАЗЕЦ]"
+            " [--threads N] [--key-out ФАЙЛ]"}},
+        {"kernels", {commandKernels, "", true}},
+        {"keygen", {commandKeygen,
+            "--cipher hill|hill-gf|richelieu|vigenere --out ФАЙЛ [--size N]"}},
+        {"list", {commandList, "--in АРХИВ|ХРАНИЛИЩЕ"}},
+        {"pack", {commandPack,
+            "--cipher hill|hill-gf|richelieu|vigenere --key КЛЮЧ --in ФАЙЛ|КАТАЛОГ [--in ...] --out АРХИВ [--checksum]"
+            " [--compress 1..9] [--threads N]", true}},
+        {"rekey", {commandRekey,
+            "--old-key КЛЮЧ|КАТАЛОГ --new-key КЛЮЧ --in ФАЙЛ [--out ФАЙЛ] [--cipher hill|hill-gf|richelieu|vigenere]"
+            " [--chunk-size N] [--threads N]", true}},
+        {"richelieu-solve", {commandRichelieuSolve,
+            "--in ШИФРТЕКСТ --block N [--lang ru|en] [--corpus ОБРАЗЕЦ] [--threads N] [--restarts N]"
+            " [--key-out ФАЙЛ]"}},
+        {"stream", {commandStream,
+            "--cipher hill|hill-gf|richelieu|vigenere --key КЛЮЧ [--in ФАЙЛ] [--out ФАЙЛ] [--decrypt]"
+            " [--chunk-size N]", true}},
+        {"unpack", {commandUnpack,
+            "--key КЛЮЧ|КАТАЛОГ [--key ...] --in АРХИВ [--out КАТАЛОГ] [--file ИМЯ ...] [--threads N]", true}},
+        {"verify", {commandVerify, "--in КОНТЕЙНЕР [--threads N]"}},
+        {"vigenere-analyze", {commandVigenereAnalyze,
+            "--in ФАЙЛ [--max-period N] [--reference ОБРАЗЕЦ] [--threads N] [--key-out ФАЙЛ]"}},
+    };
+    return table;
+}
+
+} // namespace
+
+void printCommandsUsage(ostream& out) {
+    out << "Команды:\n";
+    for (const auto& [name, info] : commandTable()) {
+        out << "  " << name << " " << info.usage << "\n";
+    }
+}
+
+int runCommand(const vector<string>& args, const CipherLibs& libs) {
+    auto it = commandTable().find(args[0]);
+    if (it == commandTable().end()) {
+        cerr << "Ошибка: неизвестная команда: " << args[0] << endl;
+        printCommandsUsage(cerr);
+        return 1;
+    }
+
+    try {
+        if (it->second.ciphers) prepareKernels(libs);
+        return it->second.run(args, libs);
+    } catch (const exception& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "cipher_libs.h"
+
+// Выполнение команды пакетного режима (args[0] - имя команды).
+// Возвращает код завершения программы.
+int runCommand(const std::vector<std::string>& args, const CipherLibs& libs);
+
+// Список команд для справки
+void printCommandsUsage(std::ostream& out);
+
+#endif
@@ -0,0 +1,26 @@
+#include "compression.h"
+#include <stdexcept>
+#include <zlib.h>
+
+using namespace std;
+
+string compressChunk(const char* data, size_t size, int level) {
+    uLongf compressedSize = compressBound(static_cast<uLong>(size));
+    string out(compressedSize, '\0');
+    int status = compress2(reinterpret_cast<Bytef*>(&out[0]), &compressedSize,
+                           reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size), level);
+    if (status != Z_OK) throw runtime_error("Ошибка сжатия: " + string(zError(status)));
+    out.resize(compressedSize);
+    return out;
+}
+
+string decompressChunk(const char* data, size_t size, size_t originalSize) {
+    string out(originalSize, '\0');
+    uLongf outSize = static_cast<uLongf>(originalSize);
+    int status = uncompress(reinterpret_cast<Bytef*>(&out[0]), &outSize,
+                            reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size));
+    if (status != Z_OK || outSize != originalSize) {
+        throw runtime_error("Ошибка распаковки: " + string(status != Z_OK ? zError(status) : "неверный размер"));
+    }
+    return out;
+}
@@ -0,0 +1,13 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+
+// Сжатие фрагмента перед шифрованием (zlib deflate, level 1..9)
+std::string compressChunk(const char* data, size_t size, int level);
+
+// Распаковка фрагмента; исходный размер известен из таблицы контейнера
+std::string decompressChunk(const char* data, size_t size, size_t originalSize);
+
+#endif
@@ -0,0 +1,872 @@
+#include "container.h"
+#include "byte_order.h"
+#include "parallel.h"
+#include "crc32c.h"
+#include "compression.h"
+#include "sha256.h"
+#include "staged_file.h"
+#include "trace.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <random>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[4] = {'R', 'G', 'R', 'C'};
+const uint16_t VERSION = 2;
+const size_t HEADER_SIZE = 60; // магия, версия, шифр, флаги, фрагмент, соль, проверка ключа, длина, число фрагментов
+const uint16_t LEGACY_VERSION = 1;
+const size_t LEGACY_HEADER_SIZE = 36; // вместо соли и проверки - 64-битный отпечаток ключа
+const size_t CHUNK_ENTRY_SIZE = 25;        // длины, дополнение, CRC32C, флаги фрагмента
+const size_t LEGACY_CHUNK_ENTRY_SIZE = 24; // без флагов: при FLAG_COMPRESSED сжаты все фрагменты
+const uint8_t FLAG_CRC32C = 1;     // в записях фрагментов хранится CRC32C
+const uint8_t FLAG_COMPRESSED = 2; // включено сжатие zlib перед шифрованием
+const uint8_t CHUNK_COMPRESSED = 1; // фрагмент сжат (только если это его уменьшило)
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Заголовок контейнера без таблицы фрагментов
+string headerBytes(ContainerCipher cipher, uint8_t flags, uint32_t chunkSize, const KeyCheck& check,
+                   uint64_t plainLength, uint64_t chunkCount) {
+    string out(MAGIC, sizeof(MAGIC));
+    putLE(out, VERSION, 2);
+    putLE(out, static_cast<uint8_t>(cipher), 1);
+    putLE(out, flags, 1);
+    putLE(out, chunkSize, 4);
+    out.append(reinterpret_cast<const char*>(check.salt.data()), check.salt.size());
+    out.append(reinterpret_cast<const char*>(check.value.data()), check.value.size());
+    putLE(out, plainLength, 8);
+    putLE(out, chunkCount, 8);
+    return out;
+}
+
+void putChunkEntry(string& out, const ContainerChunk& chunk) {
+    putLE(out, chunk.plainLength, 8);
+    putLE(out, chunk.cipherLength, 8);
+    putLE(out, chunk.padding, 4);
+    putLE(out, chunk.checksum, 4);
+    out += static_cast<char>(chunk.compressed ? CHUNK_COMPRESSED : 0);
+}
+
+// Данные фрагмента для шифрования: сжатые, если сжатие их уменьшило, иначе
+// как есть. Иначе сжатый фрагмент длиннее исходного зашел бы на гамму
+// Виженера следующего фрагмента (гамма берется с позиции фрагмента в тексте).
+string chunkPayload(const char* data, size_t size, int compressLevel, bool& compressed) {
+    compressed = false;
+    if (compressLevel > 0) {
+        RGR_TRACE_SCOPE("compress", "zlib", size);
+        string payload = compressChunk(data, size, compressLevel);
+        if (payload.size() < size) {
+            compressed = true;
+            return payload;
+        }
+    }
+    return string(data, size);
+}
+
+uint8_t containerFlags(const ContainerOptions& options) {
+    return (options.checksums ? FLAG_CRC32C : 0) | (options.compressLevel > 0 ? FLAG_COMPRESSED : 0);
+}
+
+// Шифрование данных фрагмента, начинающегося с offset открытого текста
+// Размер блока шифра: фрагмент должен состоять из целых блоков
+uint64_t cipherBlock(const ContainerKey& key) {
+    switch (key.cipher) {
+        case ContainerCipher::HILL: return 2;
+        case ContainerCipher::HILL_GF: return key.matrix.size();
+        default: return 1;
+    }
+}
+
+// Границы фрагментов открытого текста. Фрагмент кратен блоку шифра (пары
+// байтов Хилла не разрываются), для Ришелье граница не попадает внутрь символа UTF-8.
+vector<uint64_t> chunkBoundaries(ContainerCipher cipher, const char* text, size_t size, uint32_t chunkSize,
+                                 uint64_t block) {
+    uint64_t step = (chunkSize + block - 1) / block * block;
+
+    vector<uint64_t> bounds{0};
+    while (bounds.back() < size) {
+        uint64_t begin = bounds.back();
+        uint64_t end = min<uint64_t>(size, begin + step);
+        if (cipher == ContainerCipher::RICHELIEU) {
+            uint64_t boundary = end;
+            while (boundary > begin && boundary < size
+                   && (static_cast<unsigned char>(text[boundary]) & 0xC0) == 0x80) {
+                --boundary;
+            }
+            if (boundary > begin) end = boundary;
+        }
+        bounds.push_back(end);
+    }
+    return bounds;
+}
+
+// Раздача фрагментов рабочим потокам (см. forEachIndex) с именем потока в трассировке
+template <typename Func>
+void forEachChunk(unsigned threads, size_t count, Func func) {
+    forEachIndex(threads, count, func, [] { RGR_TRACE_THREAD("worker"); });
+}
+
+// Готовность фрагментов между стадиями конвейера
+class ChunkReadiness {
+public:
+    explicit ChunkReadiness(size_t count) : ready_(count, 0) {}
+
+    void markReady(size_t i) {
+        { lock_guard<mutex> lock(mutex_); ready_[i] = 1; }
+        changed_.notify_all();
+    }
+
+    // Остановка конвейера: ожидающие получат исключение
+    void fail() {
+        { lock_guard<mutex> lock(mutex_); failed_ = true; }
+        changed_.notify_all();
+    }
+
+    void waitFor(size_t i) {
+        unique_lock<mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return ready_[i] || failed_; });
+        if (!ready_[i]) throw runtime_error("Конвейер остановлен из-за ошибки");
+    }
+
+private:
+    mutex mutex_;
+    condition_variable changed_;
+    vector<char> ready_;
+    bool failed_ = false;
+};
+
+} // namespace
+
+ContainerCipher parseContainerCipher(const string& name) {
+    if (name == "hill") return ContainerCipher::HILL;
+    if (name == "richelieu") return ContainerCipher::RICHELIEU;
+    if (name == "vigenere") return ContainerCipher::VIGENERE;
+    if (name == "hill-gf") return ContainerCipher::HILL_GF;
+    throw invalid_argument("Неизвестный шифр: " + name + " (hill, richelieu, vigenere, hill-gf)");
+}
+
+const char* containerCipherName(ContainerCipher cipher) {
+    switch (cipher) {
+        case ContainerCipher::HILL: return "hill";
+        case ContainerCipher::RICHELIEU: return "richelieu";
+        case ContainerCipher::VIGENERE: return "vigenere";
+        case ContainerCipher::HILL_GF: return "hill-gf";
+    }
+    return "unknown";
+}
+
+MetricCipher metricCipher(ContainerCipher cipher) {
+    switch (cipher) {
+        case ContainerCipher::HILL:
+        case ContainerCipher::HILL_GF: return MetricCipher::HILL;
+        case ContainerCipher::RICHELIEU: return MetricCipher::RICHELIEU;
+        case ContainerCipher::VIGENERE: return MetricCipher::VIGENERE;
+    }
+    return MetricCipher::NONE;
+}
+
+ContainerKey loadContainerKey(const CipherLibs& libs, ContainerCipher cipher, const string& keyFile) {
+    ContainerKey key;
+    key.cipher = cipher;
+    switch (cipher) {
+        case ContainerCipher::HILL:
+            if (!libs.hillLib) throw runtime_error("Библиотека Hill не загружена");
+            key.matrix = libs.loadHillKey(keyFile);
+            break;
+        case ContainerCipher::HILL_GF:
+            if (!libs.hillLib) throw runtime_error("Библиотека Hill не загружена");
+            key.matrix = libs.loadHillGfKey(keyFile);
+            break;
+        case ContainerCipher::RICHELIEU:
+            if (!libs.richelieuLib) throw runtime_error("Библиотека Richelieu не загружена");
+            key.text = libs.loadRichelieuKey(keyFile);
+            break;
+        case ContainerCipher::VIGENERE:
+            if (!libs.vigenereLib) throw runtime_error("Библиотека Vigenere не загружена");
+            key.mapped = make_shared<const MappedFile>(keyFile);
+            if (key.size() == 0) throw invalid_argument("Ключ не может быть пустым");
+            break;
+    }
+    return key;
+}
+
+namespace {
+
+// Ключ Виженера длиннее этого входит в проверку длиной и началом: иначе
+// одноразовый ключ в гигабайты читался бы целиком еще до данных
+const size_t FINGERPRINT_PREFIX = 64 << 10;
+
+// Итерации PBKDF2: около 10 мс на проверку одного ключа
+const uint32_t KEY_CHECK_ITERATIONS = 10000;
+
+// Шифр и ключ в каноническом виде (байты те же, что хешировал отпечаток
+// версии 1, поэтому он считается по этой же строке)
+string keyMaterial(const ContainerKey& key) {
+    string material(1, static_cast<char>(key.cipher));
+    switch (key.cipher) {
+        case ContainerCipher::HILL:
+        case ContainerCipher::HILL_GF: //размер блока задан числом байтов
+            for (const auto& row : key.matrix) {
+                for (int value : row) material += static_cast<char>(((value % 256) + 256) % 256);
+            }
+            break;
+        case ContainerCipher::RICHELIEU: {
+            // Перестановка, а не строка: лишние пробелы ключа не меняют проверку
+            istringstream numbers(key.text);
+            uint32_t number;
+            while (numbers >> number) material.append(reinterpret_cast<const char*>(&number), sizeof(number));
+            break;
+        }
+        case ContainerCipher::VIGENERE: {
+            // Короткий ключ - целиком; длинный - префикс и длина
+            material.append(key.bytes(), min(key.size(), FINGERPRINT_PREFIX));
+            if (key.size() > FINGERPRINT_PREFIX) {
+                uint64_t length = key.size();
+                material.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            }
+            break;
+        }
+    }
+    return material;
+}
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+// Отпечаток версии 1 по всему ключу (так считался до ограничения префиксом)
+uint64_t fullVigenereFingerprint(const ContainerKey& key) {
+    uint8_t id = static_cast<uint8_t>(key.cipher);
+    return fnv1a(fnv1a(FNV_OFFSET, &id, 1), key.bytes(), key.size());
+}
+
+// Ключ, растянутый PBKDF2 с солью проверки; из него HMAC выводит и
+// проверочное значение, и секреты по назначению
+string keyMaster(const ContainerKey& key, const KeySalt& salt) {
+    string material = keyMaterial(key);
+    return pbkdf2Sha256(material.data(), material.size(), salt.data(), salt.size(), KEY_CHECK_ITERATIONS, 32);
+}
+
+array<uint8_t, 16> deriveFromMaster(const string& master, const string& purpose) {
+    Sha256Digest digest = hmacSha256(master.data(), master.size(), purpose.data(), purpose.size());
+    array<uint8_t, 16> result;
+    copy(digest.begin(), digest.begin() + result.size(), result.begin());
+    return result;
+}
+
+const char CHECK_PURPOSE[] = "rgr key check";
+
+// Проверки, уже сосчитанные в этом процессе (ключ - по SHA-256 его
+// материала): повторная проверка того же ключа с той же солью - дешифрование
+// частями, bench - не повторяет PBKDF2
+struct KnownCheck {
+    Sha256Digest material;
+    KeySalt salt;
+    array<uint8_t, KEY_CHECK_SIZE> value;
+};
+const size_t KNOWN_CHECKS = 16;
+mutex g_knownMutex;
+deque<KnownCheck> g_known;
+
+bool findKnownCheck(const Sha256Digest& material, const KeySalt& salt, array<uint8_t, KEY_CHECK_SIZE>& value) {
+    lock_guard<mutex> lock(g_knownMutex);
+    for (const KnownCheck& known : g_known) {
+        if (known.material == material && known.salt == salt) {
+            value = known.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void rememberCheck(const Sha256Digest& material, const KeySalt& salt, const array<uint8_t, KEY_CHECK_SIZE>& value) {
+    lock_guard<mutex> lock(g_knownMutex);
+    g_known.push_front({material, salt, value});
+    if (g_known.size() > KNOWN_CHECKS) g_known.pop_back();
+}
+
+array<uint8_t, KEY_CHECK_SIZE> checkValue(const ContainerKey& key, const KeySalt& salt) {
+    string material = keyMaterial(key);
+    Sha256Digest digest = sha256(material.data(), material.size());
+    array<uint8_t, KEY_CHECK_SIZE> value;
+    if (findKnownCheck(digest, salt, value)) return value;
+    value = deriveFromMaster(keyMaster(key, salt), CHECK_PURPOSE);
+    rememberCheck(digest, salt, value);
+    return value;
+}
+
+} // namespace
+
+KeySalt randomKeySalt() {
+    KeySalt salt;
+    random_device device;
+    for (size_t i = 0; i < salt.size(); i += 4) {
+        uint32_t value = device();
+        memcpy(salt.data() + i, &value, 4);
+    }
+    return salt;
+}
+
+KeyCheck makeKeyCheck(const ContainerKey& key) {
+    KeyCheck check;
+    check.salt = randomKeySalt();
+    check.value = checkValue(key, check.salt);
+    return check;
+}
+
+bool keyMatchesCheck(const ContainerKey& key, const KeyCheck& check) {
+    if (check.legacy) {
+        string material = keyMaterial(key);
+        if (fnv1a(FNV_OFFSET, material.data(), material.size()) == check.fingerprint) return true;
+        // Файлы, записанные с отпечатком по всему длинному ключу: полное чтение
+        // ключа только при несовпадении короткого отпечатка
+        return key.cipher == ContainerCipher::VIGENERE && key.size() > FINGERPRINT_PREFIX
+               && fullVigenereFingerprint(key) == check.fingerprint;
+    }
+    array<uint8_t, KEY_CHECK_SIZE> value = checkValue(key, check.salt);
+    uint8_t difference = 0; //сравнение без раннего выхода
+    for (size_t i = 0; i < value.size(); ++i) difference |= value[i] ^ check.value[i];
+    return difference == 0;
+}
+
+array<uint8_t, 16> keyDerivedSecret(const ContainerKey& key, const KeySalt& salt, const string& purpose) {
+    return deriveFromMaster(keyMaster(key, salt), "rgr " + purpose);
+}
+
+bool isContainer(const char* data, size_t size) {
+    return size >= sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+ContainerHeader parseContainerHeader(const char* data, size_t size) {
+    if (!isContainer(data, size)) throw runtime_error("Файл не является контейнером");
+    if (size < LEGACY_HEADER_SIZE) throw runtime_error("Контейнер обрезан: неполный заголовок");
+
+    uint16_t version = static_cast<uint16_t>(getLE(data + 4, 2));
+    if (version != VERSION && version != LEGACY_VERSION) {
+        throw runtime_error("Неподдерживаемая версия контейнера: " + to_string(version));
+    }
+    const size_t headerSize = version == VERSION ? HEADER_SIZE : LEGACY_HEADER_SIZE;
+    const size_t entrySize = version == VERSION ? CHUNK_ENTRY_SIZE : LEGACY_CHUNK_ENTRY_SIZE;
+    if (size < headerSize) throw runtime_error("Контейнер обрезан: неполный заголовок");
+
+    ContainerHeader header;
+    uint8_t cipher = static_cast<uint8_t>(data[6]);
+    if (cipher < 1 || cipher > 4) throw runtime_error("Неизвестный шифр в контейнере: " + to_string(cipher));
+    header.cipher = static_cast<ContainerCipher>(cipher);
+    uint8_t flags = static_cast<uint8_t>(data[7]);
+    if (flags & ~(FLAG_CRC32C | FLAG_COMPRESSED)) {
+        throw runtime_error("Неизвестные флаги контейнера: " + to_string(flags));
+    }
+    header.checksums = (flags & FLAG_CRC32C) != 0;
+    header.compressed = (flags & FLAG_COMPRESSED) != 0;
+    header.chunkSize = static_cast<uint32_t>(getLE(data + 8, 4));
+    const char* lengths = data + headerSize - 16;
+    if (version == VERSION) {
+        memcpy(header.keyCheck.salt.data(), data + 12, KEY_SALT_SIZE);
+        memcpy(header.keyCheck.value.data(), data + 12 + KEY_SALT_SIZE, KEY_CHECK_SIZE);
+    } else {
+        header.keyCheck.legacy = true;
+        header.keyCheck.fingerprint = getLE(data + 12, 8);
+    }
+    header.plainLength = getLE(lengths, 8);
+    uint64_t chunkCount = getLE(lengths + 8, 8);
+
+    if (chunkCount > (size - headerSize) / entrySize) {
+        throw runtime_error("Контейнер обрезан: неполная таблица фрагментов");
+    }
+    header.dataOffset = headerSize + chunkCount * entrySize;
+
+    // Сумма длин фрагментов должна совпасть с длиной текста и размером файла
+    header.chunks.resize(chunkCount);
+    uint64_t plainTotal = 0, cipherTotal = 0;
+    for (uint64_t i = 0; i < chunkCount; ++i) {
+        const char* entry = data + headerSize + i * entrySize;
+        ContainerChunk& chunk = header.chunks[i];
+        chunk.plainLength = getLE(entry, 8);
+        chunk.cipherLength = getLE(entry + 8, 8);
+        chunk.padding = static_cast<uint32_t>(getLE(entry + 16, 4));
+        chunk.checksum = static_cast<uint32_t>(getLE(entry + 20, 4));
+        uint8_t chunkFlags = version == VERSION ? static_cast<uint8_t>(entry[24])
+                                                : (header.compressed ? CHUNK_COMPRESSED : 0);
+        chunk.compressed = (chunkFlags & CHUNK_COMPRESSED) != 0;
+        if (chunk.cipherLength > size || chunk.padding > chunk.cipherLength || (chunkFlags & ~CHUNK_COMPRESSED)
+            || (chunk.compressed && !header.compressed)) {
+            throw runtime_error("Поврежденная таблица фрагментов");
+        }
+        plainTotal += chunk.plainLength;
+        cipherTotal += chunk.cipherLength;
+    }
+    if (plainTotal != header.plainLength) throw runtime_error("Поврежденная таблица фрагментов");
+    if (header.dataOffset + cipherTotal > size) {
+        throw runtime_error("Контейнер обрезан: ожидалось " + to_string(header.dataOffset + cipherTotal)
+                            + " байт, получено " + to_string(size));
+    }
+    if (header.dataOffset + cipherTotal < size) throw runtime_error("Лишние данные после последнего фрагмента");
+    return header;
+}
+
+ContainerKey selectContainerKey(const CipherLibs& libs, const ContainerHeader& header,
+                                const vector<string>& candidates) {
+    vector<string> files;
+    for (const string& candidate : candidates) {
+        if (fs::is_directory(candidate)) {
+            for (const auto& entry : fs::directory_iterator(candidate)) {
+                if (entry.is_regular_file()) files.push_back(entry.path().string());
+            }
+        } else {
+            files.push_back(candidate);
+        }
+    }
+
+    for (const string& file : files) {
+        try {
+            ContainerKey key = loadContainerKey(libs, header.cipher, file);
+            if (keyMatchesCheck(key, header.keyCheck)) return key;
+        } catch (const exception&) {
+            //файл не является ключом этого шифра
+        }
+    }
+    throw runtime_error(string("Не найден ключ ") + containerCipherName(header.cipher) + ", подходящий к контейнеру");
+}
+
+string containerEncrypt(const CipherLibs& libs, const ContainerKey& key, const string& plaintext,
+                        const ContainerOptions& options) {
+    return containerEncrypt(libs, key, plaintext.data(), plaintext.size(), options);
+}
+
+string containerEncrypt(const CipherLibs& libs, const ContainerKey& key, const char* data, size_t size,
+                        const ContainerOptions& options) {
+    if (options.chunkSize == 0) throw invalid_argument("Размер фрагмента должен быть положительным");
+    if (options.compressLevel < 0 || options.compressLevel > 9) throw invalid_argument("Уровень сжатия: 1..9");
+    const bool compress = options.compressLevel > 0;
+    // Ришелье переставляет символы UTF-8, а сжатые данные не являются
+    // корректным UTF-8: после перестановки символы разбились бы иначе
+    if (compress && key.cipher == ContainerCipher::RICHELIEU) {
+        throw invalid_argument("Сжатие несовместимо с шифром Ришелье");
+    }
+    vector<uint64_t> bounds = chunkBoundaries(key.cipher, data, size, options.chunkSize,
+                                              cipherBlock(key));
+    size_t count = bounds.size() - 1;
+
+    // Сжатие идет в отдельном потоке впереди шифрования
+    vector<string> payload(count);
+    vector<bool> chunkCompressed(count, false);
+    ChunkReadiness compressed(count);
+    exception_ptr compressError;
+    thread compressor;
+    if (compress) {
+        compressor = thread([&] {
+            RGR_TRACE_THREAD("compress");
+            try {
+                for (size_t i = 0; i < count; ++i) {
+                    bool shrunk;
+                    payload[i] = chunkPayload(data + bounds[i], bounds[i + 1] - bounds[i], options.compressLevel, shrunk);
+                    chunkCompressed[i] = shrunk;
+                    compressed.markReady(i);
+                }
+            } catch (...) {
+                compressError = current_exception();
+                compressed.fail();
+            }
+        });
+    }
+
+    vector<string> encrypted(count);
+    vector<uint32_t> crc(count, 0);
+    try {
+        forEachChunk(options.threads, count, [&](size_t i) {
+            if (compress) {
+                RGR_TRACE_SCOPE("wait compress", "pipeline");
+                compressed.waitFor(i);
+            } else {
+                payload[i].assign(data + bounds[i], bounds[i + 1] - bounds[i]);
+            }
+            encrypted[i] = encryptPayload(libs, key, payload[i], bounds[i]);
+            if (options.checksums) {
+                RGR_TRACE_SCOPE("crc32c", "checksum", encrypted[i].size());
+                crc[i] = crc32c(encrypted[i].data(), encrypted[i].size());
+            }
+        });
+    } catch (...) {
+        if (compressor.joinable()) compressor.join();
+        if (compressError) rethrow_exception(compressError); //первопричина остановки
+        throw;
+    }
+    if (compressor.joinable()) compressor.join();
+    if (compressError) rethrow_exception(compressError);
+
+    string out = headerBytes(key.cipher, containerFlags(options), options.chunkSize,
+                             options.keyCheck ? *options.keyCheck : makeKeyCheck(key), size, count);
+    uint64_t dataSize = 0;
+    for (size_t i = 0; i < count; ++i) {
+        ContainerChunk chunk;
+        chunk.plainLength = bounds[i + 1] - bounds[i];
+        chunk.compressed = chunkCompressed[i];
+        chunk.cipherLength = encrypted[i].size();
+        chunk.padding = static_cast<uint32_t>(encrypted[i].size() - payload[i].size()); //"X" Ришелье
+        chunk.checksum = crc[i];
+        putChunkEntry(out, chunk);
+        dataSize += encrypted[i].size();
+    }
+
+    out.reserve(out.size() + dataSize);
+    for (const string& chunk : encrypted) out += chunk;
+    return out;
+}
+
+void containerEncryptFanOut(const CipherLibs& libs, const vector<ContainerKey>& keys, const char* data,
+                            size_t size, const vector<string>& outputFiles, const ContainerOptions& options) {
+    if (keys.size() != outputFiles.size()) throw invalid_argument("Число ключей и выходных файлов не совпадает");
+    if (options.chunkSize == 0) throw invalid_argument("Размер фрагмента должен быть положительным");
+    if (options.compressLevel < 0 || options.compressLevel > 9) throw invalid_argument("Уровень сжатия: 1..9");
+    for (const ContainerKey& key : keys) {
+        // У Ришелье границы фрагментов и дополнение зависят от ключа, поэтому
+        // он допустим только один (потоковое шифрование в файл)
+        if (key.cipher == ContainerCipher::RICHELIEU && keys.size() > 1) {
+            throw invalid_argument("Шифр Ришелье не поддерживает рассылку");
+        }
+        if (key.cipher == ContainerCipher::RICHELIEU && options.compressLevel > 0) {
+            throw invalid_argument("Сжатие несовместимо с шифром Ришелье");
+        }
+    }
+
+    // Общие границы для всех ключей: фрагмент кратен наибольшему блоку
+    // (размеры блоков - степени двойки, поэтому кратен и остальным)
+    uint64_t block = 1;
+    for (const ContainerKey& key : keys) block = max(block, cipherBlock(key));
+    uint64_t alignedChunk = (options.chunkSize + block - 1) / block * block;
+    if (alignedChunk > UINT32_MAX) throw invalid_argument("Недопустимый размер фрагмента");
+    uint32_t chunkSize = static_cast<uint32_t>(alignedChunk);
+    vector<uint64_t> bounds = chunkBoundaries(keys.size() == 1 ? keys[0].cipher : ContainerCipher::HILL, data, size,
+                                              chunkSize, block);
+    size_t count = bounds.size() - 1;
+
+    // Контейнеры пишутся во временные файлы и заменяют выходные только
+    // целиком: при ошибке не остается обрезанных файлов с нулевой таблицей,
+    // а вход, отображенный из одного из выходных файлов, не обрезается
+    deque<StagedFile> staged;
+    vector<ofstream> outputs;
+    outputs.reserve(keys.size());
+
+    // Заголовок и место под таблицу; таблица дописывается в конце, когда
+    // известны размеры сжатых фрагментов и контрольные суммы
+    for (size_t k = 0; k < keys.size(); ++k) {
+        staged.emplace_back(outputFiles[k]);
+        outputs.emplace_back(staged.back().path(), ios::binary | ios::trunc);
+        if (!outputs.back()) throw runtime_error("Не удалось создать файл: " + outputFiles[k]);
+        outputs.back() << headerBytes(keys[k].cipher, containerFlags(options), chunkSize, makeKeyCheck(keys[k]),
+                                      size, count);
+        outputs.back() << string(count * CHUNK_ENTRY_SIZE, '\0');
+    }
+    vector<vector<ContainerChunk>> tables(keys.size(), vector<ContainerChunk>(count));
+
+    // Фрагменты обрабатываются группами по числу потоков: фрагмент читается
+    // (и сжимается) один раз и, пока он в кэше, шифруется всеми ключами
+    unsigned threads = resolveThreads(options.threads, count);
+    for (size_t group = 0; group < count; group += threads) {
+        size_t groupSize = min<size_t>(threads, count - group);
+        vector<vector<string>> encrypted(groupSize, vector<string>(keys.size()));
+        forEachChunk(threads, groupSize, [&](size_t g) {
+            size_t i = group + g;
+            RGR_TRACE_SCOPE("read chunk", "fanout", bounds[i + 1] - bounds[i]);
+            bool shrunk;
+            string payload = chunkPayload(data + bounds[i], bounds[i + 1] - bounds[i], options.compressLevel, shrunk);
+            for (size_t k = 0; k < keys.size(); ++k) {
+                encrypted[g][k] = encryptPayload(libs, keys[k], payload, bounds[i]);
+                ContainerChunk& chunk = tables[k][i];
+                chunk.plainLength = bounds[i + 1] - bounds[i];
+                chunk.compressed = shrunk;
+                chunk.cipherLength = encrypted[g][k].size();
+                chunk.padding = static_cast<uint32_t>(encrypted[g][k].size() - payload.size()); //"X" Ришелье
+                if (options.checksums) chunk.checksum = crc32c(encrypted[g][k].data(), encrypted[g][k].size());
+            }
+        });
+        RGR_TRACE_SCOPE("write group", "fanout");
+        for (size_t g = 0; g < groupSize; ++g) {
+            for (size_t k = 0; k < keys.size(); ++k) outputs[k] << encrypted[g][k];
+        }
+    }
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+        string table;
+        for (const ContainerChunk& chunk : tables[k]) putChunkEntry(table, chunk);
+        outputs[k].seekp(HEADER_SIZE);
+        outputs[k] << table;
+        outputs[k].close();
+        if (outputs[k].fail()) throw runtime_error("Ошибка записи в файл: " + outputFiles[k]);
+    }
+    for (StagedFile& output : staged) output.commit();
+}
+
+string encryptPayload(const CipherLibs& libs, const ContainerKey& key, const string& payload, uint64_t offset) {
+    RGR_TRACE_SCOPE("encrypt chunk", containerCipherName(key.cipher), payload.size());
+    switch (key.cipher) {
+        case ContainerCipher::HILL: return libs.hillEncrypt(payload, key.matrix);
+        case ContainerCipher::HILL_GF: return libs.hillGfEncrypt(payload, key.matrix);
+        case ContainerCipher::RICHELIEU: return libs.richelieuEncrypt(payload, key.text);
+        case ContainerCipher::VIGENERE: {
+            string result(payload.size(), '\0');
+            libs.vigenereApply(payload.data(), payload.size(), key.bytes(), key.size(), offset, false, &result[0]);
+            return result;
+        }
+    }
+    return "";
+}
+
+string decryptPayload(const CipherLibs& libs, const ContainerKey& key, const char* data, size_t size, uint64_t offset) {
+    RGR_TRACE_SCOPE("decrypt chunk", containerCipherName(key.cipher), size);
+    switch (key.cipher) {
+        case ContainerCipher::HILL: return libs.hillDecrypt(string(data, size), key.matrix);
+        case ContainerCipher::HILL_GF: return libs.hillGfDecrypt(string(data, size), key.matrix);
+        case ContainerCipher::RICHELIEU: return libs.richelieuDecrypt(string(data, size), key.text);
+        case ContainerCipher::VIGENERE: {
+            string result(size, '\0');
+            libs.vigenereApply(data, size, key.bytes(), key.size(), offset, true, &result[0]);
+            return result;
+        }
+    }
+    return "";
+}
+
+vector<size_t> containerVerify(const ContainerHeader& header, const char* data, unsigned threads) {
+    if (!header.checksums) throw runtime_error("Контейнер создан без контрольных сумм");
+
+    size_t count = header.chunks.size();
+    vector<uint64_t> dataStart(count, header.dataOffset);
+    for (size_t i = 1; i < count; ++i) dataStart[i] = dataStart[i - 1] + header.chunks[i - 1].cipherLength;
+
+    vector<char> corrupted(count, 0);
+    forEachChunk(threads, count, [&](size_t i) {
+        const ContainerChunk& chunk = header.chunks[i];
+        RGR_TRACE_SCOPE("crc32c", "checksum", chunk.cipherLength);
+        corrupted[i] = crc32c(data + dataStart[i], chunk.cipherLength) != chunk.checksum;
+    });
+
+    vector<size_t> result;
+    for (size_t i = 0; i < count; ++i) {
+        if (corrupted[i]) result.push_back(i);
+    }
+    return result;
+}
+
+namespace {
+
+void checkContainerKey(const ContainerKey& key, const ContainerHeader& header) {
+    if (key.cipher != header.cipher) throw invalid_argument("Шифр ключа не совпадает с шифром контейнера");
+    if (!keyMatchesCheck(key, header.keyCheck)) throw invalid_argument("Ключ не подходит к контейнеру");
+}
+
+// Положение фрагментов в тексте и в файле (count + 1 границ)
+void chunkPositions(const ContainerHeader& header, vector<uint64_t>& plainStart, vector<uint64_t>& dataStart) {
+    size_t count = header.chunks.size();
+    plainStart.assign(count + 1, 0);
+    dataStart.assign(count + 1, header.dataOffset);
+    for (size_t i = 0; i < count; ++i) {
+        plainStart[i + 1] = plainStart[i] + header.chunks[i].plainLength;
+        dataStart[i + 1] = dataStart[i] + header.chunks[i].cipherLength;
+    }
+}
+
+// Открытый текст фрагментов [first, last) подряд
+string decryptChunks(const CipherLibs& libs, const ContainerKey& key, const ContainerHeader& header,
+                     const char* data, const vector<uint64_t>& plainStart, const vector<uint64_t>& dataStart,
+                     size_t first, size_t last, unsigned threads) {
+    // Распаковка идет в отдельном потоке вслед за дешифрованием
+    string result(plainStart[last] - plainStart[first], '\0');
+    vector<string> payload(header.compressed ? last - first : 0);
+    ChunkReadiness decrypted(payload.size());
+    exception_ptr decompressError;
+    thread decompressor;
+    if (header.compressed) {
+        decompressor = thread([&] {
+            RGR_TRACE_THREAD("decompress");
+            try {
+                for (size_t k = 0; k < payload.size(); ++k) {
+                    const ContainerChunk& entry = header.chunks[first + k];
+                    if (!entry.compressed) continue; //записан на место рабочим потоком
+                    {
+                        RGR_TRACE_SCOPE("wait decrypt", "pipeline");
+                        decrypted.waitFor(k);
+                    }
+                    RGR_TRACE_SCOPE("decompress", "zlib", entry.plainLength);
+                    string plain = decompressChunk(payload[k].data(), payload[k].size(), entry.plainLength);
+                    memcpy(&result[plainStart[first + k] - plainStart[first]], plain.data(), plain.size());
+                    string().swap(payload[k]);
+                }
+            } catch (...) {
+                decompressError = current_exception();
+            }
+        });
+    }
+
+    try {
+        forEachChunk(threads, last - first, [&](size_t k) {
+            size_t i = first + k;
+            const ContainerChunk& entry = header.chunks[i];
+            if (header.checksums) {
+                RGR_TRACE_SCOPE("crc32c", "checksum", entry.cipherLength);
+                if (crc32c(data + dataStart[i], entry.cipherLength) != entry.checksum) {
+                    throw runtime_error("Нарушена целостность фрагмента " + to_string(i) + " (CRC32C)");
+                }
+            }
+            string plain = decryptPayload(libs, key, data + dataStart[i], entry.cipherLength, plainStart[i]);
+            if (plain.size() != entry.cipherLength) throw runtime_error("Поврежден фрагмент " + to_string(i));
+            plain.resize(plain.size() - entry.padding);
+
+            if (entry.compressed) {
+                payload[k] = move(plain);
+                decrypted.markReady(k);
+            } else {
+                if (plain.size() != entry.plainLength) throw runtime_error("Поврежден фрагмент " + to_string(i));
+                memcpy(&result[plainStart[i] - plainStart[first]], plain.data(), plain.size());
+            }
+        });
+    } catch (...) {
+        decrypted.fail();
+        if (decompressor.joinable()) decompressor.join();
+        throw;
+    }
+    if (decompressor.joinable()) decompressor.join();
+    if (decompressError) rethrow_exception(decompressError);
+    return result;
+}
+
+} // namespace
+
+string containerDecrypt(const CipherLibs& libs, const ContainerKey& key, const ContainerHeader& header,
+                        const char* data, uint64_t offset, uint64_t length, unsigned threads) {
+    checkContainerKey(key, header);
+
+    uint64_t begin = min(offset, header.plainLength);
+    uint64_t end = length < header.plainLength - begin ? begin + length : header.plainLength;
+
+    // Фрагменты, пересекающие [begin, end)
+    size_t count = header.chunks.size();
+    vector<uint64_t> plainStart, dataStart;
+    chunkPositions(header, plainStart, dataStart);
+    size_t first = 0;
+    while (first < count && plainStart[first + 1] <= begin) ++first;
+    size_t last = first;
+    while (last < count && plainStart[last] < end) ++last;
+    if (begin == end) return "";
+
+    string result = decryptChunks(libs, key, header, data, plainStart, dataStart, first, last, threads);
+    if (begin == plainStart[first] && end == plainStart[last]) return result; //без лишней копии
+    return result.substr(begin - plainStart[first], end - begin);
+}
+
+uint64_t containerDecryptTo(const CipherLibs& libs, const ContainerKey& key, const ContainerHeader& header,
+                            const char* data, ostream& out, unsigned threads) {
+    checkContainerKey(key, header);
+    vector<uint64_t> plainStart, dataStart;
+    chunkPositions(header, plainStart, dataStart);
+
+    size_t count = header.chunks.size();
+    threads = resolveThreads(threads, count);
+    for (size_t first = 0; first < count; first += threads) {
+        size_t last = min(count, first + threads);
+        string window = decryptChunks(libs, key, header, data, plainStart, dataStart, first, last, threads);
+        RGR_TRACE_SCOPE("write window", "stream", window.size());
+        out.write(window.data(), static_cast<streamsize>(window.size()));
+        if (!out) throw runtime_error("Ошибка записи результата");
+    }
+    return header.plainLength;
+}
+
+RekeyTransform makeRekeyTransform(const CipherLibs& libs, const ContainerKey& oldKey, const ContainerKey& newKey) {
+    if (oldKey.cipher != newKey.cipher) throw invalid_argument("Шифры старого и нового ключей различаются");
+    RekeyTransform transform;
+    transform.oldKey = oldKey;
+    transform.newKey = newKey;
+    transform.composed.cipher = oldKey.cipher;
+    switch (oldKey.cipher) {
+        case ContainerCipher::HILL:
+            transform.composed.matrix = libs.hillComposeKeys(oldKey.matrix, newKey.matrix);
+            break;
+        case ContainerCipher::HILL_GF:
+            transform.composed.matrix = libs.hillGfComposeKeys(oldKey.matrix, newKey.matrix);
+            break;
+        case ContainerCipher::RICHELIEU:
+            transform.composed.text = libs.richelieuComposeKeys(oldKey.text, newKey.text);
+            break;
+        case ContainerCipher::VIGENERE:
+            break; //гамма разности строится по ходу из обоих ключей
+    }
+    return transform;
+}
+
+string rekeyPayload(const CipherLibs& libs, const RekeyTransform& transform, const char* data, size_t size,
+                    uint64_t offset) {
+    RGR_TRACE_SCOPE("rekey chunk", containerCipherName(transform.composed.cipher), size);
+    const ContainerKey& composed = transform.composed;
+    switch (composed.cipher) {
+        case ContainerCipher::HILL: return libs.hillEncrypt(string(data, size), composed.matrix);
+        case ContainerCipher::HILL_GF: return libs.hillGfEncrypt(string(data, size), composed.matrix);
+        case ContainerCipher::RICHELIEU: return libs.richelieuEncrypt(string(data, size), composed.text);
+        case ContainerCipher::VIGENERE: {
+            string result(size, '\0');
+            libs.vigenereRekeyApply(data, size, transform.oldKey.bytes(), transform.oldKey.size(),
+                                    transform.newKey.bytes(), transform.newKey.size(), offset, &result[0]);
+            return result;
+        }
+    }
+    return "";
+}
+
+string containerRekey(const CipherLibs& libs, const RekeyTransform& transform, const ContainerHeader& header,
+                      const char* data, unsigned threads) {
+    if (transform.oldKey.cipher != header.cipher) throw invalid_argument("Шифр ключа не совпадает с шифром контейнера");
+    if (!keyMatchesCheck(transform.oldKey, header.keyCheck)) {
+        throw invalid_argument("Старый ключ не подходит к контейнеру");
+    }
+
+    size_t count = header.chunks.size();
+    vector<uint64_t> plainStart(count + 1, 0), dataStart(count + 1, header.dataOffset);
+    for (size_t i = 0; i < count; ++i) {
+        plainStart[i + 1] = plainStart[i] + header.chunks[i].plainLength;
+        dataStart[i + 1] = dataStart[i] + header.chunks[i].cipherLength;
+    }
+
+    uint8_t flags = (header.checksums ? FLAG_CRC32C : 0) | (header.compressed ? FLAG_COMPRESSED : 0);
+    string out = headerBytes(header.cipher, flags, header.chunkSize, makeKeyCheck(transform.newKey),
+                             header.plainLength, count);
+    // Заголовок версии 1 короче: данные в результате сдвигаются на разницу
+    size_t tableOffset = out.size();
+    const size_t outputOffset = tableOffset + count * CHUNK_ENTRY_SIZE - header.dataOffset;
+    out.resize(dataStart[count] + outputOffset);
+
+    vector<ContainerChunk> chunks = header.chunks;
+    forEachChunk(threads, count, [&](size_t i) {
+        ContainerChunk& entry = chunks[i];
+        if (header.checksums && crc32c(data + dataStart[i], entry.cipherLength) != entry.checksum) {
+            throw runtime_error("Нарушена целостность фрагмента " + to_string(i) + " (CRC32C)");
+        }
+        // Виженер сдвигает и сжатые данные с позиции фрагмента в открытом тексте
+        string rekeyed = rekeyPayload(libs, transform, data + dataStart[i], entry.cipherLength, plainStart[i]);
+        if (rekeyed.size() != entry.cipherLength) throw runtime_error("Поврежден фрагмент " + to_string(i));
+        memcpy(&out[dataStart[i] + outputOffset], rekeyed.data(), rekeyed.size());
+        if (header.checksums) entry.checksum = crc32c(rekeyed.data(), rekeyed.size());
+    });
+
+    string table;
+    for (const ContainerChunk& entry : chunks) putChunkEntry(table, entry);
+    memcpy(&out[tableOffset], table.data(), table.size());
+    return out;
+}
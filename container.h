@@ -0,0 +1,191 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "cipher_libs.h"
+#include "mapped_file.h"
+#include "metrics.h"
+
+// Контейнер зашифрованного файла:
+//   заголовок (магия "RGRC", версия, шифр, размер фрагмента, соль и
+//   проверочное значение ключа, длина открытого текста, число фрагментов),
+//   таблица фрагментов, данные.
+// Фрагменты шифруются независимо, поэтому расшифровываются параллельно,
+// а обрезанный файл обнаруживается по заголовку до дешифрования.
+
+// Идентификатор шифра в заголовке
+enum class ContainerCipher : uint8_t {
+    HILL = 1,
+    RICHELIEU = 2,
+    VIGENERE = 3,
+    HILL_GF = 4  // Хилл над GF(2^8) с блоком 2..64 байта
+};
+
+// "hill", "richelieu", "vigenere", "hill-gf"
+ContainerCipher parseContainerCipher(const std::string& name);
+const char* containerCipherName(ContainerCipher cipher);
+
+// Шифр в метриках (оба варианта Хилла учитываются как hill)
+MetricCipher metricCipher(ContainerCipher cipher);
+
+// Ключ любого из шифров
+struct ContainerKey {
+    ContainerCipher cipher = ContainerCipher::VIGENERE;
+    std::string text;                     // Ришелье; Виженер, если ключ задан строкой
+    std::vector<std::vector<int>> matrix; // Хилл (2x2 или n x n над GF(2^8))
+    // Виженер из файла: ключ отображается в память, а не копируется, чтобы
+    // ключ длиной с данные не занимал памяти сверх страничного кэша
+    std::shared_ptr<const MappedFile> mapped;
+
+    const char* bytes() const { return mapped ? mapped->data() : text.data(); }
+    size_t size() const { return mapped ? mapped->size() : text.size(); }
+};
+
+ContainerKey loadContainerKey(const CipherLibs& libs, ContainerCipher cipher, const std::string& keyFile);
+
+// Проверочное значение ключа - по нему файл находит свой ключ: HMAC-SHA256
+// от ключа, растянутого PBKDF2 со случайной солью файла. По значению ключ
+// не подобрать иначе как полным перебором с ценой PBKDF2 на каждую попытку,
+// и одинаковые ключи у разных файлов не видны. Ключ Виженера длиннее 64 КиБ
+// входит первыми 64 КиБ и длиной. Файлы версии 1 хранят вместо него
+// 64-битный отпечаток FNV-1a (legacy) - они только читаются.
+const size_t KEY_SALT_SIZE = 16;
+const size_t KEY_CHECK_SIZE = 16;
+using KeySalt = std::array<uint8_t, KEY_SALT_SIZE>;
+
+struct KeyCheck {
+    KeySalt salt{};
+    std::array<uint8_t, KEY_CHECK_SIZE> value{};
+    bool legacy = false;
+    uint64_t fingerprint = 0; // отпечаток файлов версии 1
+};
+
+KeySalt randomKeySalt();
+
+// Проверочное значение с новой случайной солью
+KeyCheck makeKeyCheck(const ContainerKey& key);
+
+// Ключ подходит к проверочному значению (для legacy - к отпечатку, в том
+// числе по всему длинному ключу Виженера, как в самых старых файлах)
+bool keyMatchesCheck(const ContainerKey& key, const KeyCheck& check);
+
+// Секрет для назначения purpose, выведенный из ключа и соли: без ключа не
+// вычисляется и не совпадает с проверочным значением при той же соли
+// (хеши фрагментов хранилища, идентификатор ключа в манифесте)
+std::array<uint8_t, 16> keyDerivedSecret(const ContainerKey& key, const KeySalt& salt, const std::string& purpose);
+
+// Запись таблицы фрагментов
+struct ContainerChunk {
+    uint64_t plainLength = 0;
+    uint64_t cipherLength = 0;
+    uint32_t padding = 0;  // символов "X", добавленных Ришелье в конце фрагмента
+    uint32_t checksum = 0; // CRC32C шифртекста фрагмента (если checksums)
+    bool compressed = false; // сжат перед шифрованием (только если это его уменьшило)
+};
+
+struct ContainerHeader {
+    ContainerCipher cipher = ContainerCipher::VIGENERE;
+    uint32_t chunkSize = 0;
+    KeyCheck keyCheck;
+    uint64_t plainLength = 0;
+    bool checksums = false;  // в таблице есть CRC32C фрагментов
+    bool compressed = false; // включено сжатие (какие фрагменты сжаты - в таблице)
+    std::vector<ContainerChunk> chunks;
+    size_t dataOffset = 0; // начало данных первого фрагмента
+};
+
+// Размер фрагмента по умолчанию; при рассылке меньше, чтобы фрагмент
+// оставался в кэше, пока его шифруют все ключи
+const uint32_t CONTAINER_DEFAULT_CHUNK = 1 << 20;
+const uint32_t FANOUT_DEFAULT_CHUNK = 256 << 10;
+
+bool isContainer(const char* data, size_t size);
+
+// Разбор заголовка и таблицы; исключение, если файл обрезан или поврежден
+ContainerHeader parseContainerHeader(const char* data, size_t size);
+
+// Подбор ключа контейнера среди файлов (каталоги просматриваются без вложенных)
+ContainerKey selectContainerKey(const CipherLibs& libs, const ContainerHeader& header,
+                                const std::vector<std::string>& candidates);
+
+// Параметры шифрования в контейнер
+struct ContainerOptions {
+    uint32_t chunkSize = CONTAINER_DEFAULT_CHUNK;
+    bool checksums = false; // CRC32C фрагмента считается сразу после его шифрования, пока он в кэше
+    int compressLevel = 0;  // 1..9 - сжатие zlib перед шифрованием в отдельном потоке, 0 - без сжатия
+    unsigned threads = 0;   // 0 - по числу ядер
+    // Проверочное значение ключа, общее для многих файлов одного запуска:
+    // PBKDF2 считается один раз, а не на каждый файл (иначе - новая соль)
+    std::optional<KeyCheck> keyCheck;
+};
+
+std::string containerEncrypt(const CipherLibs& libs, const ContainerKey& key, const std::string& plaintext,
+                             const ContainerOptions& options);
+// То же для данных в памяти без копии (например, отображенного файла)
+std::string containerEncrypt(const CipherLibs& libs, const ContainerKey& key, const char* data, size_t size,
+                             const ContainerOptions& options);
+
+// Рассылка: один текст шифруется ключами keys[k] в файлы outputFiles[k]
+// (Хилл, Хилл GF(2^8) и Виженер) за одно чтение - каждый фрагмент шифруется всеми
+// ключами, пока он в кэше, и сжимается один раз на все ключи. Фрагменты
+// обрабатываются группами по числу потоков и сразу пишутся в файлы, поэтому
+// с одним ключом (любым, и Ришелье) это потоковое шифрование в файл с
+// памятью порядка 2 * threads * chunkSize.
+void containerEncryptFanOut(const CipherLibs& libs, const std::vector<ContainerKey>& keys, const char* data,
+                            size_t size, const std::vector<std::string>& outputFiles,
+                            const ContainerOptions& options);
+
+// Шифрование и дешифрование одного фрагмента (или другой независимо
+// шифруемой единицы) ключом key; offset - позиция фрагмента в потоке для
+// гаммы Виженера, остальные шифры ее не используют. Ришелье дополняет
+// последний блок символами "X", Хилл оставляет нечетный последний байт.
+std::string encryptPayload(const CipherLibs& libs, const ContainerKey& key, const std::string& payload,
+                           uint64_t offset);
+std::string decryptPayload(const CipherLibs& libs, const ContainerKey& key, const char* data, size_t size,
+                           uint64_t offset);
+
+// Параллельная проверка CRC32C всех фрагментов без ключа; номера поврежденных
+std::vector<size_t> containerVerify(const ContainerHeader& header, const char* data, unsigned threads);
+
+// Дешифрование байтов [offset, offset + length) открытого текста:
+// расшифровываются только фрагменты, пересекающие диапазон, и перед
+// дешифрованием проверяется их CRC32C
+std::string containerDecrypt(const CipherLibs& libs, const ContainerKey& key, const ContainerHeader& header,
+                             const char* data, uint64_t offset, uint64_t length, unsigned threads);
+
+// Дешифрование всего контейнера в out окнами по threads фрагментов: в
+// памяти только текущее окно (порядка 2 * threads * chunkSize). Возвращает
+// длину открытого текста.
+uint64_t containerDecryptTo(const CipherLibs& libs, const ContainerKey& key, const ContainerHeader& header,
+                            const char* data, std::ostream& out, unsigned threads);
+
+// Составное преобразование смены ключа oldKey -> newKey (шифр один и тот же):
+// шифртекст старого ключа переводится в шифртекст нового за один проход без
+// открытого текста. Хилл - одна матрица K_new * K_old^-1, Ришелье - композиция
+// перестановок (размеры блоков должны совпадать), Виженер - разность гамм.
+struct RekeyTransform {
+    ContainerKey oldKey;
+    ContainerKey newKey;
+    ContainerKey composed; // Хилл, Хилл GF(2^8), Ришелье: ключ, которым шифруется шифртекст
+};
+
+RekeyTransform makeRekeyTransform(const CipherLibs& libs, const ContainerKey& oldKey, const ContainerKey& newKey);
+
+// size байтов шифртекста, начинающегося со смещения offset потока (Виженер);
+// у Хилла неполный блок и у Ришелье дополнение сохраняются, длина не меняется
+std::string rekeyPayload(const CipherLibs& libs, const RekeyTransform& transform, const char* data, size_t size,
+                         uint64_t offset);
+
+// Смена ключа контейнера: данные фрагментов преобразуются параллельно,
+// таблица фрагментов остается прежней, CRC32C пересчитываются, в заголовок
+// записывается проверочное значение нового ключа. Сжатые фрагменты не распаковываются.
+std::string containerRekey(const CipherLibs& libs, const RekeyTransform& transform, const ContainerHeader& header,
+                           const char* data, unsigned threads);
+
+#endif
@@ -0,0 +1,73 @@
+#include "crc32c.h"
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef uint32_t (*Crc32cFunc)(const unsigned char*, size_t, uint32_t);
+
+// Таблицы для обработки по 8 байт (slicing-by-8), отраженный полином 0x82F63B78
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+    }
+};
+
+uint32_t crc32cTable(const unsigned char* p, size_t n, uint32_t crc) {
+    static const Crc32cTables tables;
+    const auto& t = tables.table;
+    while (n >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        word ^= crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^ t[5][(word >> 16) & 0xFF]
+            ^ t[4][(word >> 24) & 0xFF] ^ t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF]
+            ^ t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cSse42(const unsigned char* p, size_t n, uint32_t crc) {
+    uint64_t crc64 = crc;
+    while (n >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        n -= 8;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(crc64);
+    while (n--) crc32 = _mm_crc32_u8(crc32, *p++);
+    return crc32;
+}
+#endif
+
+Crc32cFunc selectCrc32c() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) return crc32cSse42;
+#endif
+    return crc32cTable;
+}
+
+} // namespace
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    static const Crc32cFunc func = selectCrc32c();
+    return ~func(static_cast<const unsigned char*>(data), size, ~crc);
+}
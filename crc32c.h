@@ -0,0 +1,12 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (полином Кастаньоли). Инструкция crc32 SSE4.2, если процессор ее
+// поддерживает, иначе табличный расчет. crc - значение для предыдущих данных
+// (0 для начала), так что расчет можно продолжать по частям.
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+#endif
@@ -0,0 +1,555 @@
+#include "dedup.h"
+#include "byte_order.h"
+#include "archive.h"
+#include "compression.h"
+#include "crc32c.h"
+#include "fast_hash.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[4] = {'R', 'G', 'R', 'D'};
+const uint16_t VERSION = 2;
+const size_t HEADER_SIZE = 40;           // магия, версия, шифр, флаги, соль и проверка ключа
+const uint16_t LEGACY_VERSION = 1;
+const size_t LEGACY_HEADER_SIZE = 16;    // вместо соли и проверки - 64-битный отпечаток ключа
+const size_t PARAMS_SIZE = 4 + 4 * 8;    // средний фрагмент, dataSize, streamSize, число фрагментов и файлов
+const size_t CHUNK_ENTRY_SIZE = 2 * 8 + 2 * 8 + 4 * 4 + 1;
+const uint8_t CHUNK_COMPRESSED = 1;
+const char* const CHUNKS_FILE = "chunks";
+const char* const CATALOG_FILE = "catalog";
+
+// Фрагменты файла хешируются и шифруются пачками: пачка ограничивает
+// память под шифртекст новых фрагментов
+const uint64_t BATCH_BYTES = 64 << 20;
+const size_t WRITE_BUFFER = 4 << 20;
+
+// Назначение секрета ключа для хешей фрагментов (см. keyDerivedSecret)
+const char HASH_PURPOSE[] = "dedup chunk";
+
+// Случайные 64-битные значения для каждого байта (splitmix64 с постоянной
+// затравкой: таблица одинакова во всех запусках, иначе границы бы не совпали)
+const array<uint64_t, 256>& gearTable() {
+    static const array<uint64_t, 256> table = [] {
+        array<uint64_t, 256> values{};
+        uint64_t state = 0;
+        for (uint64_t& value : values) {
+            state += 0x9E3779B97F4A7C15ull;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+// Граница после begin по скользящему хешу Gear: хеш сдвигается на бит на
+// байт, поэтому старшие биты зависят только от последних 64 байтов.
+// Нормализованное разбиение: до среднего размера граница ставится реже
+// (проверяется больше битов), после - чаще, и длины теснее к среднему.
+size_t findBoundary(const unsigned char* data, size_t begin, size_t size, size_t averageChunk, unsigned bits) {
+    const array<uint64_t, 256>& gear = gearTable();
+    const uint64_t hardMask = ~0ull << (64 - (bits + 1));
+    const uint64_t easyMask = ~0ull << (64 - (bits - 1));
+    const size_t minimum = averageChunk / 4;
+    if (size - begin <= minimum) return size;
+    const size_t limit = size - begin > averageChunk * 8 ? begin + averageChunk * 8 : size;
+    const size_t normal = min(limit, begin + averageChunk);
+
+    uint64_t hash = 0;
+    size_t i = begin + minimum;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & hardMask)) return i + 1;
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & easyMask)) return i + 1;
+    }
+    return limit;
+}
+
+struct HashKey {
+    uint64_t low;
+    uint64_t high;
+    bool operator==(const HashKey& other) const { return low == other.low && high == other.high; }
+};
+
+struct HashKeyHasher {
+    size_t operator()(const HashKey& key) const { return static_cast<size_t>(key.low); }
+};
+
+HashKey chunkHash(const char* data, size_t size, const array<uint8_t, 16>& secret) {
+    uint64_t hash[2];
+    keyedHash128(data, size, secret.data(), hash);
+    return {hash[0], hash[1]};
+}
+
+string headerBytes(ContainerCipher cipher, const KeyCheck& check) {
+    string out(MAGIC, sizeof(MAGIC));
+    putLE(out, VERSION, 2);
+    out += static_cast<char>(cipher);
+    out += '\0'; //флаги (зарезервировано)
+    out.append(reinterpret_cast<const char*>(check.salt.data()), check.salt.size());
+    out.append(reinterpret_cast<const char*>(check.value.data()), check.value.size());
+    return out;
+}
+
+string catalogBytes(const DedupCatalog& catalog) {
+    string out = headerBytes(catalog.cipher, catalog.keyCheck);
+    putLE(out, catalog.averageChunk, 4);
+    putLE(out, catalog.dataSize, 8);
+    putLE(out, catalog.streamSize, 8);
+    putLE(out, catalog.chunks.size(), 8);
+    putLE(out, catalog.files.size(), 8);
+    out.reserve(out.size() + catalog.chunks.size() * CHUNK_ENTRY_SIZE);
+    for (const DedupChunk& chunk : catalog.chunks) {
+        putLE(out, chunk.hash[0], 8);
+        putLE(out, chunk.hash[1], 8);
+        putLE(out, chunk.dataOffset, 8);
+        putLE(out, chunk.streamOffset, 8);
+        putLE(out, chunk.cipherLength, 4);
+        putLE(out, chunk.plainLength, 4);
+        putLE(out, chunk.padding, 4);
+        putLE(out, chunk.checksum, 4);
+        out += static_cast<char>(chunk.compressed ? CHUNK_COMPRESSED : 0);
+    }
+    for (const DedupFile& file : catalog.files) {
+        putLE(out, file.name.size(), 2);
+        out += file.name;
+        putLE(out, file.size, 8);
+        putLE(out, file.chunks.size(), 8);
+        for (uint32_t id : file.chunks) putLE(out, id, 4);
+    }
+    putLE(out, crc32c(out.data(), out.size()), 4);
+    return out;
+}
+
+// Запись через временный файл и переименование, как у манифеста
+void saveCatalog(const string& storeDir, const DedupCatalog& catalog) {
+    const string filename = (fs::path(storeDir) / CATALOG_FILE).string();
+    const string temporary = filename + ".tmp";
+    {
+        string bytes = catalogBytes(catalog);
+        ofstream file(temporary, ios::binary | ios::trunc);
+        if (!file) throw runtime_error("Не удалось записать каталог хранилища: " + temporary);
+        file.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        if (!file.flush()) throw runtime_error("Не удалось записать каталог хранилища: " + temporary);
+    }
+    if (rename(temporary.c_str(), filename.c_str()) != 0) {
+        throw runtime_error("Не удалось заменить каталог хранилища: " + filename);
+    }
+}
+
+void checkKey(const ContainerKey& key, const DedupCatalog& catalog) {
+    if (key.cipher != catalog.cipher) throw invalid_argument("Шифр ключа не совпадает с шифром хранилища");
+    if (!keyMatchesCheck(key, catalog.keyCheck)) throw invalid_argument("Ключ не подходит к хранилищу");
+}
+
+uint64_t cipherBlockSize(const ContainerKey& key) {
+    switch (key.cipher) {
+        case ContainerCipher::HILL: return 2;
+        case ContainerCipher::HILL_GF: return key.matrix.size();
+        default: return 1;
+    }
+}
+
+} // namespace
+
+bool isDedupStore(const string& storeDir) {
+    error_code ec;
+    return fs::is_regular_file(fs::path(storeDir) / CATALOG_FILE, ec);
+}
+
+string dedupChunksFile(const string& storeDir) {
+    return (fs::path(storeDir) / CHUNKS_FILE).string();
+}
+
+DedupCatalog loadDedupCatalog(const string& storeDir) {
+    const string filename = (fs::path(storeDir) / CATALOG_FILE).string();
+    MappedFile input(filename);
+    const char* data = input.data();
+    const size_t size = input.size();
+    if (size < LEGACY_HEADER_SIZE + PARAMS_SIZE + 4 || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        throw runtime_error("Не является каталогом хранилища: " + filename);
+    }
+    if (crc32c(data, size - 4) != getLE(data + size - 4, 4)) {
+        throw runtime_error("Нарушена целостность каталога хранилища (CRC32C)");
+    }
+    uint16_t version = static_cast<uint16_t>(getLE(data + 4, 2));
+    if (version != VERSION && version != LEGACY_VERSION) {
+        throw runtime_error("Неподдерживаемая версия хранилища: " + to_string(version));
+    }
+    const size_t headerSize = version == VERSION ? HEADER_SIZE : LEGACY_HEADER_SIZE;
+    if (size < headerSize + PARAMS_SIZE + 4) throw runtime_error("Поврежденный каталог хранилища");
+
+    DedupCatalog catalog;
+    uint8_t cipher = static_cast<uint8_t>(data[6]);
+    if (cipher < 1 || cipher > 4) throw runtime_error("Неизвестный шифр в хранилище: " + to_string(cipher));
+    catalog.cipher = static_cast<ContainerCipher>(cipher);
+    if (data[7] != 0) throw runtime_error("Неизвестные флаги хранилища");
+    if (version == VERSION) {
+        memcpy(catalog.keyCheck.salt.data(), data + 8, KEY_SALT_SIZE);
+        memcpy(catalog.keyCheck.value.data(), data + 8 + KEY_SALT_SIZE, KEY_CHECK_SIZE);
+    } else {
+        catalog.keyCheck.legacy = true;
+        catalog.keyCheck.fingerprint = getLE(data + 8, 8);
+    }
+    const char* cursor = data + headerSize;
+    const char* end = data + size - 4;
+    catalog.averageChunk = static_cast<uint32_t>(getLE(cursor, 4));
+    catalog.dataSize = getLE(cursor + 4, 8);
+    catalog.streamSize = getLE(cursor + 12, 8);
+    uint64_t chunkCount = getLE(cursor + 20, 8);
+    uint64_t fileCount = getLE(cursor + 28, 8);
+    cursor += PARAMS_SIZE;
+    if (catalog.averageChunk < DEDUP_MIN_AVERAGE || catalog.averageChunk > DEDUP_MAX_AVERAGE
+        || catalog.dataSize < headerSize || chunkCount > static_cast<uint64_t>(end - cursor) / CHUNK_ENTRY_SIZE) {
+        throw runtime_error("Поврежденный каталог хранилища");
+    }
+
+    catalog.chunks.resize(chunkCount);
+    for (DedupChunk& chunk : catalog.chunks) {
+        chunk.hash[0] = getLE(cursor, 8);
+        chunk.hash[1] = getLE(cursor + 8, 8);
+        chunk.dataOffset = getLE(cursor + 16, 8);
+        chunk.streamOffset = getLE(cursor + 24, 8);
+        chunk.cipherLength = static_cast<uint32_t>(getLE(cursor + 32, 4));
+        chunk.plainLength = static_cast<uint32_t>(getLE(cursor + 36, 4));
+        chunk.padding = static_cast<uint32_t>(getLE(cursor + 40, 4));
+        chunk.checksum = static_cast<uint32_t>(getLE(cursor + 44, 4));
+        uint8_t flags = static_cast<uint8_t>(cursor[48]);
+        if (flags & ~CHUNK_COMPRESSED) throw runtime_error("Неизвестные флаги фрагмента хранилища");
+        chunk.compressed = (flags & CHUNK_COMPRESSED) != 0;
+        cursor += CHUNK_ENTRY_SIZE;
+        if (chunk.dataOffset < headerSize || chunk.dataOffset > catalog.dataSize
+            || chunk.cipherLength > catalog.dataSize - chunk.dataOffset || chunk.padding > chunk.cipherLength) {
+            throw runtime_error("Поврежденный фрагмент в каталоге хранилища");
+        }
+    }
+
+    for (uint64_t f = 0; f < fileCount; ++f) {
+        DedupFile file;
+        if (end - cursor < 2) throw runtime_error("Поврежденный каталог хранилища");
+        size_t nameLength = getLE(cursor, 2);
+        if (static_cast<size_t>(end - cursor) < 2 + nameLength + 16) throw runtime_error("Поврежденный каталог хранилища");
+        file.name.assign(cursor + 2, nameLength);
+        cursor += 2 + nameLength;
+        file.size = getLE(cursor, 8);
+        uint64_t count = getLE(cursor + 8, 8);
+        cursor += 16;
+        if (count > static_cast<uint64_t>(end - cursor) / 4) throw runtime_error("Поврежденный каталог хранилища");
+        file.chunks.resize(count);
+        uint64_t total = 0;
+        for (uint32_t& id : file.chunks) {
+            id = static_cast<uint32_t>(getLE(cursor, 4));
+            cursor += 4;
+            if (id >= chunkCount) throw runtime_error("Поврежденный список фрагментов файла: " + file.name);
+            total += catalog.chunks[id].plainLength;
+        }
+        if (total != file.size) throw runtime_error("Поврежденный список фрагментов файла: " + file.name);
+        catalog.files.push_back(move(file));
+    }
+    if (cursor != end) throw runtime_error("Поврежденный каталог хранилища");
+    return catalog;
+}
+
+vector<uint64_t> contentDefinedBoundaries(const char* data, size_t size, uint32_t averageChunk, bool utf8) {
+    unsigned bits = 0;
+    while ((2ull << bits) <= averageChunk) ++bits; //log2 среднего размера
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+    vector<uint64_t> bounds{0};
+    size_t begin = 0;
+    while (begin < size) {
+        size_t end = findBoundary(bytes, begin, size, averageChunk, bits);
+        if (utf8) {
+            while (end < size && (bytes[end] & 0xC0) == 0x80) ++end;
+        }
+        bounds.push_back(end);
+        begin = end;
+    }
+    return bounds;
+}
+
+DedupStats dedupAdd(const CipherLibs& libs, const ContainerKey& key, const vector<string>& inputs,
+                    const string& storeDir, const ContainerOptions& options) {
+    if (options.compressLevel < 0 || options.compressLevel > 9) throw invalid_argument("Уровень сжатия: 1..9");
+    if (options.compressLevel > 0 && key.cipher == ContainerCipher::RICHELIEU) {
+        throw invalid_argument("Сжатие несовместимо с шифром Ришелье");
+    }
+    const string chunksFile = dedupChunksFile(storeDir);
+
+    // Новое хранилище - с параметрами разбиения из options; у существующего
+    // они прежние, иначе границы не совпали бы с уже сохраненными
+    DedupCatalog catalog;
+    if (isDedupStore(storeDir)) {
+        catalog = loadDedupCatalog(storeDir);
+        checkKey(key, catalog);
+        // Хеши фрагментов версии 1 - с затравкой из отпечатка, а не из
+        // секрета ключа: дописывать в такое хранилище значит продолжать их
+        if (catalog.keyCheck.legacy) {
+            throw runtime_error("Хранилище версии 1 доступно только для восстановления: создайте новое хранилище");
+        }
+        error_code ec;
+        uint64_t actual = fs::file_size(chunksFile, ec);
+        if (ec || actual < catalog.dataSize) throw runtime_error("Хранилище повреждено: файл фрагментов короче каталога");
+        if (actual > catalog.dataSize) fs::resize_file(chunksFile, catalog.dataSize); //хвост прерванного добавления
+    } else {
+        uint32_t average = options.chunkSize;
+        if (average < DEDUP_MIN_AVERAGE || average > DEDUP_MAX_AVERAGE || (average & (average - 1))) {
+            throw invalid_argument("Средний размер фрагмента - степень двойки от 1 КиБ до 1 МиБ");
+        }
+        fs::create_directories(storeDir);
+        catalog.cipher = key.cipher;
+        catalog.keyCheck = makeKeyCheck(key);
+        catalog.averageChunk = average;
+        catalog.dataSize = HEADER_SIZE;
+        ofstream header(chunksFile, ios::binary | ios::trunc);
+        header << headerBytes(catalog.cipher, catalog.keyCheck);
+        if (!header.flush()) throw runtime_error("Не удалось создать файл: " + chunksFile);
+    }
+
+    DedupStats stats;
+    vector<ArchiveSource> sources;
+    {
+        MetricsScope metrics(MetricCipher::NONE, MetricStage::READ);
+        scanArchiveInputs(inputs, sources, stats.errors);
+    }
+
+    const array<uint8_t, 16> hashSecret = keyDerivedSecret(key, catalog.keyCheck.salt, HASH_PURPOSE);
+    unordered_map<HashKey, uint32_t, HashKeyHasher> known;
+    known.reserve(catalog.chunks.size());
+    for (size_t i = 0; i < catalog.chunks.size(); ++i) {
+        known.emplace(HashKey{catalog.chunks[i].hash[0], catalog.chunks[i].hash[1]}, static_cast<uint32_t>(i));
+    }
+    unordered_map<string, size_t> fileIndex;
+    for (size_t i = 0; i < catalog.files.size(); ++i) fileIndex.emplace(catalog.files[i].name, i);
+
+    vector<char> buffer(WRITE_BUFFER);
+    ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), static_cast<streamsize>(buffer.size()));
+    out.open(chunksFile, ios::binary | ios::app);
+    if (!out) throw runtime_error("Не удалось открыть файл: " + chunksFile);
+
+    const uint64_t block = cipherBlockSize(key);
+    const bool utf8 = key.cipher == ContainerCipher::RICHELIEU;
+    set<string> names;
+    for (const ArchiveSource& source : sources) {
+        if (source.name.size() > UINT16_MAX) {
+            stats.errors.push_back(source.path + ": слишком длинное имя");
+            continue;
+        }
+        if (!names.insert(source.name).second) {
+            stats.errors.push_back(source.path + ": повторяющееся имя записи");
+            continue;
+        }
+        unique_ptr<MappedFile> input;
+        try {
+            input.reset(new MappedFile(source.path));
+        } catch (const exception& e) {
+            stats.errors.push_back(source.path + ": " + e.what());
+            continue;
+        }
+        const char* data = input->data();
+        vector<uint64_t> bounds;
+        {
+            RGR_TRACE_SCOPE("cdc", "dedup", input->size());
+            bounds = contentDefinedBoundaries(data, input->size(), catalog.averageChunk, utf8);
+        }
+
+        DedupFile file;
+        file.name = source.name;
+        file.size = input->size();
+        size_t count = bounds.size() - 1;
+        for (size_t first = 0; first < count;) {
+            size_t last = first;
+            while (last < count && (last == first || bounds[last] - bounds[first] < BATCH_BYTES)) ++last;
+
+            // Хеши пачки в потоках, затем поиск по порядку: повтор внутри
+            // пачки ссылается на первое вхождение
+            vector<HashKey> hashes(last - first);
+            forEachIndex(options.threads, last - first, [&](size_t k) {
+                RGR_TRACE_SCOPE("hash chunk", "dedup", bounds[first + k + 1] - bounds[first + k]);
+                hashes[k] = chunkHash(data + bounds[first + k], bounds[first + k + 1] - bounds[first + k], hashSecret);
+            });
+            vector<size_t> fresh; //номера фрагментов пачки, которых еще нет в хранилище
+            for (size_t k = 0; k < hashes.size(); ++k) {
+                if (catalog.chunks.size() >= UINT32_MAX) throw runtime_error("Слишком много фрагментов в хранилище");
+                auto inserted = known.emplace(hashes[k], static_cast<uint32_t>(catalog.chunks.size()));
+                if (inserted.second) {
+                    DedupChunk chunk;
+                    chunk.hash[0] = hashes[k].low;
+                    chunk.hash[1] = hashes[k].high;
+                    chunk.plainLength = static_cast<uint32_t>(bounds[first + k + 1] - bounds[first + k]);
+                    chunk.streamOffset = catalog.streamSize;
+                    catalog.streamSize += chunk.plainLength;
+                    catalog.chunks.push_back(chunk);
+                    fresh.push_back(k);
+                }
+                file.chunks.push_back(inserted.first->second);
+            }
+
+            // Сжатие (если оно уменьшает фрагмент) и шифрование новых фрагментов
+            vector<string> encrypted(fresh.size());
+            const size_t firstNew = catalog.chunks.size() - fresh.size();
+            forEachIndex(options.threads, fresh.size(), [&](size_t n) {
+                DedupChunk& chunk = catalog.chunks[firstNew + n];
+                const char* plain = data + bounds[first + fresh[n]];
+                string payload;
+                if (options.compressLevel > 0) {
+                    RGR_TRACE_SCOPE("compress", "zlib", chunk.plainLength);
+                    payload = compressChunk(plain, chunk.plainLength, options.compressLevel);
+                    chunk.compressed = payload.size() < chunk.plainLength;
+                }
+                if (!chunk.compressed) payload.assign(plain, chunk.plainLength);
+                // Хилл оставляет неполный последний блок открытым, поэтому
+                // фрагмент дополняется нулями до целого блока
+                size_t length = payload.size();
+                if (payload.size() % block) payload.append(block - payload.size() % block, '\0');
+                MetricsScope metrics(metricCipher(key.cipher), MetricStage::ENCRYPT, chunk.plainLength);
+                encrypted[n] = encryptPayload(libs, key, payload, chunk.streamOffset);
+                chunk.cipherLength = static_cast<uint32_t>(encrypted[n].size());
+                chunk.padding = static_cast<uint32_t>(encrypted[n].size() - length);
+                chunk.checksum = crc32c(encrypted[n].data(), encrypted[n].size());
+            });
+
+            {
+                MetricsScope metrics(MetricCipher::NONE, MetricStage::WRITE);
+                uint64_t written = 0;
+                for (size_t n = 0; n < fresh.size(); ++n) {
+                    catalog.chunks[firstNew + n].dataOffset = catalog.dataSize;
+                    out.write(encrypted[n].data(), static_cast<streamsize>(encrypted[n].size()));
+                    catalog.dataSize += encrypted[n].size();
+                    written += encrypted[n].size();
+                }
+                metrics.setBytes(written);
+                stats.storedBytes += written;
+            }
+            if (!out) throw runtime_error("Ошибка записи в файл: " + chunksFile);
+            stats.newChunks += fresh.size();
+            first = last;
+        }
+
+        stats.chunks += count;
+        stats.bytes += file.size;
+        ++stats.files;
+        auto it = fileIndex.find(file.name);
+        if (it != fileIndex.end()) {
+            catalog.files[it->second] = move(file);
+        } else {
+            fileIndex.emplace(file.name, catalog.files.size());
+            catalog.files.push_back(move(file));
+        }
+    }
+
+    // Каталог - только после того, как фрагменты записаны
+    out.close();
+    if (out.fail()) throw runtime_error("Ошибка записи в файл: " + chunksFile);
+    sort(catalog.files.begin(), catalog.files.end(),
+         [](const DedupFile& a, const DedupFile& b) { return a.name < b.name; });
+    saveCatalog(storeDir, catalog);
+    return stats;
+}
+
+void dedupWriteFile(const CipherLibs& libs, const ContainerKey& key, const DedupCatalog& catalog,
+                    const char* chunkData, const DedupFile& file, ostream& out) {
+    checkKey(key, catalog);
+    for (uint32_t id : file.chunks) {
+        const DedupChunk& chunk = catalog.chunks[id];
+        const char* payload = chunkData + chunk.dataOffset;
+        {
+            RGR_TRACE_SCOPE("crc32c", "checksum", chunk.cipherLength);
+            if (crc32c(payload, chunk.cipherLength) != chunk.checksum) {
+                throw runtime_error("Нарушена целостность фрагмента " + to_string(id) + " (CRC32C)");
+            }
+        }
+        string plain;
+        {
+            MetricsScope metrics(metricCipher(key.cipher), MetricStage::DECRYPT, chunk.cipherLength);
+            plain = decryptPayload(libs, key, payload, chunk.cipherLength, chunk.streamOffset);
+        }
+        if (plain.size() != chunk.cipherLength) throw runtime_error("Поврежден фрагмент " + to_string(id));
+        plain.resize(plain.size() - chunk.padding);
+        if (chunk.compressed) {
+            RGR_TRACE_SCOPE("decompress", "zlib", chunk.plainLength);
+            plain = decompressChunk(plain.data(), plain.size(), chunk.plainLength);
+        }
+        if (plain.size() != chunk.plainLength) throw runtime_error("Поврежден фрагмент " + to_string(id));
+        out.write(plain.data(), static_cast<streamsize>(plain.size()));
+    }
+}
+
+DedupStats dedupRestore(const CipherLibs& libs, const ContainerKey& key, const DedupCatalog& catalog,
+                        const string& storeDir, const string& outputDir, const vector<string>& names,
+                        unsigned threads) {
+    checkKey(key, catalog);
+    MappedFile chunks(dedupChunksFile(storeDir));
+    if (chunks.size() < catalog.dataSize) throw runtime_error("Хранилище повреждено: файл фрагментов короче каталога");
+
+    DedupStats stats;
+    vector<const DedupFile*> selected;
+    if (names.empty()) {
+        for (const DedupFile& file : catalog.files) selected.push_back(&file);
+    } else {
+        unordered_map<string, const DedupFile*> byName;
+        for (const DedupFile& file : catalog.files) byName[file.name] = &file;
+        for (const string& name : names) {
+            auto it = byName.find(name);
+            if (it == byName.end()) stats.errors.push_back(name + ": нет в хранилище");
+            else selected.push_back(it->second);
+        }
+    }
+
+    vector<const DedupFile*> valid;
+    set<fs::path> directories{fs::path(outputDir)};
+    for (const DedupFile* file : selected) {
+        if (!safeEntryName(file->name)) {
+            stats.errors.push_back(file->name + ": недопустимое имя записи");
+            continue;
+        }
+        valid.push_back(file);
+        directories.insert((fs::path(outputDir) / file->name).parent_path());
+    }
+    for (const fs::path& directory : directories) fs::create_directories(directory);
+
+    vector<string> errors(valid.size());
+    forEachIndex(threads, valid.size(), [&](size_t k) {
+        const DedupFile& file = *valid[k];
+        const string target = (fs::path(outputDir) / file.name).string();
+        try {
+            ofstream out(target, ios::binary | ios::trunc);
+            if (!out) throw runtime_error("не удалось создать файл " + target);
+            dedupWriteFile(libs, key, catalog, chunks.data(), file, out);
+            out.close();
+            if (out.fail()) throw runtime_error("ошибка записи в файл " + target);
+        } catch (const exception& e) {
+            errors[k] = e.what();
+        }
+    });
+    for (size_t k = 0; k < valid.size(); ++k) {
+        if (!errors[k].empty()) {
+            stats.errors.push_back(valid[k]->name + ": " + errors[k]);
+            continue;
+        }
+        ++stats.files;
+        stats.chunks += valid[k]->chunks.size();
+        stats.bytes += valid[k]->size;
+    }
+    return stats;
+}
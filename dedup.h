@@ -0,0 +1,108 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "container.h"
+
+// Хранилище с дедупликацией для резервных копий, где одни и те же блоки
+// повторяются в разных файлах и разных копиях. Файл режется на фрагменты по
+// содержимому (скользящий хеш Gear, как в FastCDC): граница зависит только от
+// нескольких десятков байтов перед ней, поэтому вставка в начало файла сдвигает
+// границы лишь рядом с местом вставки, а остальные фрагменты совпадают с уже
+// сохраненными. Каждый уникальный фрагмент шифруется и записывается один раз,
+// файл хранится как список номеров фрагментов.
+//
+// Каталог хранилища:
+//   chunks  - заголовок (магия "RGRD", версия, шифр, флаги, соль и
+//             проверочное значение ключа)
+//             и зашифрованные фрагменты подряд (только дописывается);
+//   catalog - заголовок, параметры разбиения, таблица фрагментов (хеш,
+//             смещение, длины, позиция гаммы, дополнение, CRC32C), список
+//             файлов и CRC32C всего каталога. Перезаписывается целиком через
+//             временный файл после записи фрагментов, поэтому прерванное
+//             добавление не портит хранилище: лишний хвост chunks отбрасывается
+//             при следующем добавлении.
+// Хеш фрагмента - 128-битный SipHash с секретом, выведенным из ключа и соли
+// хранилища: по каталогу без ключа нельзя проверить догадку о содержимом
+// фрагмента. В хранилище версии 1 (затравка из отпечатка ключа) файлы только
+// восстанавливаются.
+// Фрагменты, на которые больше не ссылается ни один файл, не удаляются.
+
+struct DedupChunk {
+    uint64_t hash[2] = {0, 0};  // хеш открытого текста с секретом ключа
+    uint64_t dataOffset = 0;    // от начала chunks
+    uint64_t streamOffset = 0;  // позиция фрагмента в потоке хранилища (гамма Виженера)
+    uint32_t cipherLength = 0;
+    uint32_t plainLength = 0;
+    uint32_t padding = 0;       // дополнение: символы "X" Ришелье или нули до целого блока Хилла
+    uint32_t checksum = 0;      // CRC32C шифртекста
+    bool compressed = false;    // сжат перед шифрованием (только если это его уменьшило)
+};
+
+struct DedupFile {
+    std::string name;            // как у записей архива (см. scanArchiveInputs)
+    uint64_t size = 0;
+    std::vector<uint32_t> chunks; // номера фрагментов по порядку
+};
+
+struct DedupCatalog {
+    ContainerCipher cipher = ContainerCipher::VIGENERE;
+    KeyCheck keyCheck;
+    uint32_t averageChunk = 0; // средний размер фрагмента разбиения
+    uint64_t dataSize = 0;     // длина chunks, покрытая каталогом
+    uint64_t streamSize = 0;   // сумма длин открытого текста фрагментов
+    std::vector<DedupChunk> chunks;
+    std::vector<DedupFile> files; // по имени
+};
+
+// Средний размер фрагмента по умолчанию и допустимые (степени двойки)
+const uint32_t DEDUP_DEFAULT_CHUNK = 8 << 10;
+const uint32_t DEDUP_MIN_AVERAGE = 1 << 10;
+const uint32_t DEDUP_MAX_AVERAGE = 1 << 20;
+
+bool isDedupStore(const std::string& storeDir);
+
+// Путь файла фрагментов хранилища
+std::string dedupChunksFile(const std::string& storeDir);
+
+// Разбор каталога хранилища; исключение, если он поврежден
+DedupCatalog loadDedupCatalog(const std::string& storeDir);
+
+// Границы фрагментов по содержимому (bounds[0] = 0, последняя - size):
+// от averageChunk / 4 до averageChunk * 8 байтов, при utf8 граница не
+// попадает внутрь символа. Длина не выравнивается по блоку шифра: иначе после
+// вставки нечетного числа байтов границы уже не совпали бы с прежними.
+std::vector<uint64_t> contentDefinedBoundaries(const char* data, size_t size, uint32_t averageChunk, bool utf8);
+
+struct DedupStats {
+    size_t files = 0;
+    uint64_t bytes = 0;       // открытого текста
+    size_t chunks = 0;        // фрагментов в файлах
+    size_t newChunks = 0;     // из них записано впервые
+    uint64_t storedBytes = 0; // шифртекста записано
+    std::vector<std::string> errors;
+};
+
+// Добавление файлов и каталогов inputs в хранилище storeDir (создается, если
+// его нет, со средним фрагментом options.chunkSize). Файл с тем же именем
+// заменяется. Хеширование, сжатие (options.compressLevel) и шифрование новых
+// фрагментов - в options.threads потоках. options.checksums не используется:
+// CRC32C фрагментов хранится всегда, поврежденный фрагмент портит все файлы
+// с ним. Непрочитанные файлы пропускаются и перечисляются в errors.
+DedupStats dedupAdd(const CipherLibs& libs, const ContainerKey& key, const std::vector<std::string>& inputs,
+                    const std::string& storeDir, const ContainerOptions& options);
+
+// Запись открытого текста файла в out (с проверкой CRC32C фрагментов);
+// chunkData - отображение chunks
+void dedupWriteFile(const CipherLibs& libs, const ContainerKey& key, const DedupCatalog& catalog,
+                    const char* chunkData, const DedupFile& file, std::ostream& out);
+
+// Восстановление файлов names (пусто - всех) в outputDir в threads потоках
+DedupStats dedupRestore(const CipherLibs& libs, const ContainerKey& key, const DedupCatalog& catalog,
+                        const std::string& storeDir, const std::string& outputDir,
+                        const std::vector<std::string>& names, unsigned threads);
+
+#endif
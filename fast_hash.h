@@ -0,0 +1,17 @@
+#ifndef FAST_HASH_H
+#define FAST_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-битный некриптографический хеш XXH64 для обнаружения изменений файлов:
+// четыре независимые полосы по 8 байтов на шаг загружают конвейер умножений
+// (в отличие от последовательной цепочки CRC), скорость - порядка памяти.
+uint64_t fastHash64(const void* data, size_t size, uint64_t seed = 0);
+
+// 128-битный SipHash-2-4 с секретным ключом key (16 байтов): в отличие от
+// XXH64 с затравкой, по известным тексту и хешу нельзя найти ключ или
+// проверить догадку о тексте без ключа. Медленнее fastHash64 в несколько раз.
+void keyedHash128(const void* data, size_t size, const uint8_t key[16], uint64_t out[2]);
+
+#endif
@@ -1,4 +1,6 @@
 #include "file.h"
+#include "metrics.h"
+#include "uring_io.h"
 #include <fstream>
 #include <stdexcept>
 #include <vector>
@@ -6,7 +8,34 @@
 #include <iostream>
 using namespace std;
 
+namespace {
+FileBackend fileBackend = FileBackend::STREAM;
+
+bool useUring() {
+    return fileBackend == FileBackend::URING && uringSupported();
+}
+
+// Создание каталогов для выходного файла
+void createParentDirectories(const std::string& filename) {
+    fs::path filepath(filename);
+    if (filepath.has_parent_path()) {
+        fs::create_directories(filepath.parent_path());
+    }
+}
+}
+
+void setFileBackend(FileBackend backend) {
+    fileBackend = backend;
+}
+
 std::string readFileAsBytes(const std::string& filename) {
+    MetricsScope metrics(MetricCipher::NONE, MetricStage::READ);
+    if (useUring()) {
+        string content = std::move(uringReadFiles({filename})[0]);
+        metrics.setBytes(content.size());
+        return content;
+    }
+
     ifstream file(filename, ios::binary | ios::ate);
     if (!file) {
         throw runtime_error("Ошибка: файл не существует или недоступен: " + filename);
@@ -20,14 +49,17 @@ std::string readFileAsBytes(const std::string& filename) {
     string content(size, '\0');
     file.seekg(0); //создание файла
     file.read(&content[0], size); //чтение файоа в буфер
+    metrics.setBytes(content.size());
     
     return content;
 }
 
 void writeFileAsBytes(const std::string& filename, const std::string& content) {
-    fs::path filepath(filename);
-    if (filepath.has_parent_path()) {
-        fs::create_directories(filepath.parent_path());
+    MetricsScope metrics(MetricCipher::NONE, MetricStage::WRITE, content.size());
+    createParentDirectories(filename);
+    if (useUring()) {
+        uringWriteFiles({filename}, {&content});
+        return;
     }
 
     ofstream file(filename, ios::binary);
@@ -42,6 +74,42 @@ void writeFileAsBytes(const std::string& filename, const std::string& content) {
     }
 }
 
+vector<string> readFilesAsBytes(const vector<string>& filenames) {
+    if (!useUring()) {
+        vector<string> contents;
+        for (const string& filename : filenames) contents.push_back(readFileAsBytes(filename));
+        return contents;
+    }
+    MetricsScope metrics(MetricCipher::NONE, MetricStage::READ);
+    vector<string> contents = uringReadFiles(filenames);
+    uint64_t bytes = 0;
+    for (const string& content : contents) bytes += content.size();
+    metrics.setBytes(bytes);
+    return contents;
+}
+
+void writeFilesAsBytes(const vector<string>& filenames, const vector<string>& contents) {
+    if (!useUring()) {
+        for (size_t i = 0; i < filenames.size(); ++i) writeFileAsBytes(filenames[i], contents[i]);
+        return;
+    }
+    MetricsScope metrics(MetricCipher::NONE, MetricStage::WRITE);
+    vector<const string*> pointers;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        createParentDirectories(filenames[i]);
+        pointers.push_back(&contents[i]);
+        bytes += contents[i].size();
+    }
+    uringWriteFiles(filenames, pointers);
+    metrics.setBytes(bytes);
+}
+
+bool sameFile(const string& first, const string& second) {
+    error_code error;
+    return fs::equivalent(first, second, error);
+}
+
 bool validateFilePath(const string& path, bool checkExists) { //проверка правильного пути
     if (path.empty()) {
         cerr << "Ошибка: Путь не может быть пустым" << endl;
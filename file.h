@@ -4,11 +4,26 @@
 #include <string>
 #include <stdexcept>
 #include <filesystem>
+#include <vector>
+#include "mapped_file.h"
 
 namespace fs = std::filesystem;
 
+// Способ чтения и записи файлов целиком
+enum class FileBackend {
+    STREAM, // ifstream/ofstream
+    URING   // io_uring; если ядро не поддерживает - STREAM
+};
+
+void setFileBackend(FileBackend backend);
+
 std::string readFileAsBytes(const std::string& filename);
 void writeFileAsBytes(const std::string& filename, const std::string& content);
+// Пакетные варианты: с io_uring запросы всех файлов идут одновременно
+std::vector<std::string> readFilesAsBytes(const std::vector<std::string>& filenames);
+void writeFilesAsBytes(const std::vector<std::string>& filenames, const std::vector<std::string>& contents);
+// Пути указывают на один и тот же файл (false, если какого-то нет)
+bool sameFile(const std::string& first, const std::string& second);
 bool validateFilePath(const std::string& path, bool checkExists = true);
 bool ensureFileExists(std::string& filePath);
 std::string readFromConsole();
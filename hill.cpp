@@ -1,4 +1,6 @@
 #include "hill.h"
+#include "mapped_file.h"
+#include "kernel_table.h"
 #include <vector>
 #include <stdexcept>
 #include <fstream>
@@ -7,6 +9,10 @@
 #include <numeric>
 #include <random>
 #include <climits>
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -84,27 +90,17 @@ vector<vector<int>> generateHillKey(size_t blockSize) {
     return key;
 }
 
-// Умножение матрицы на вектор
-vector<int> matrixMultiply(const vector<vector<int>>& matrix, const vector<int>& vec, int mod) {
-    vector<int> result(2);
-    for (int i = 0; i < 2; ++i) {
-        result[i] = (matrix[i][0] * vec[0] + matrix[i][1] * vec[1]) % mod;
-        if (result[i] < 0) result[i] += mod;
-    }
-    return result;
-}
-
-// Обработка бинарных данных
-string processBytes(const string& data, const vector<vector<int>>& key, bool decrypt) {
-    string result;
-    vector<vector<int>> useKey = key;
+// Коэффициенты матрицы шифрования (или обратной для дешифрования),
+// приведенные к 0..255: m[0] m[1] - первая строка, m[2] m[3] - вторая
+void hillKernelMatrix(const vector<vector<int>>& key, bool decrypt, uint16_t m[4]) {
     int mod = ALPHABET_SIZE;
-    
+    vector<vector<int>> useKey = key;
+
     //вычисление обратной матрицы для дешифрования
     if (decrypt) {
         int det = (key[0][0] * key[1][1] - key[0][1] * key[1][0]) % mod;
         if (det < 0) det += mod;
-        
+
         int detInv = -1;
         for (int i = 1; i < mod; ++i) {
             if ((det * i) % mod == 1) {
@@ -112,48 +108,154 @@ string processBytes(const string& data, const vector<vector<int>>& key, bool dec
                 break;
             }
         }
-        
+
         if (detInv == -1) {
             throw runtime_error("Key matrix is not invertible");
         }
         //обратная матрица
         useKey = {
-            {(key[1][1] * detInv) % mod, (-key[0][1] * detInv) % mod},
-            {(-key[1][0] * detInv) % mod, (key[0][0] * detInv) % mod}
+            {key[1][1] * detInv, -key[0][1] * detInv},
+            {-key[1][0] * detInv, key[0][0] * detInv}
         };
-        
-        //корректировка отрицательных значений (из отриацтельных в положительные
-        for (auto& row : useKey) {
-            for (auto& elem : row) {
-                if (elem < 0) elem += mod;
-            }
-        }
     }
-    
-    //обработка данных по два байта
-    for (size_t i = 0; i < data.size(); ) {
-        if (i + 1 < data.size()) {
-            //обрабатываем пару байтов
-            int idx1 = charToIndex(data[i]);
-            int idx2 = charToIndex(data[i + 1]);
-            
-            vector<int> vec = {idx1, idx2};
-            vector<int> res = matrixMultiply(useKey, vec, mod);
-            
-            result += indexToChar(res[0]);
-            result += indexToChar(res[1]);
-            
-            i += 2;
-        } else {
-            // Если остался один байт, добавляем как есть
-            result += data[i];
-            i += 1;
+
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            int elem = useKey[i][j] % mod;
+            m[i * 2 + j] = static_cast<uint16_t>(elem < 0 ? elem + mod : elem);
         }
     }
-    
+}
+
+typedef void (*HillPairsFunc)(const uint8_t*, size_t, const uint16_t*, uint8_t*);
+
+// Пары байтов (x0, x1) -> (m0*x0 + m1*x1, m2*x0 + m3*x1) mod 256
+void hillPairsScalar(const uint8_t* in, size_t pairs, const uint16_t* m, uint8_t* out) {
+    for (size_t i = 0; i < pairs; ++i) {
+        unsigned x0 = in[2 * i], x1 = in[2 * i + 1];
+        out[2 * i] = static_cast<uint8_t>(m[0] * x0 + m[1] * x1);
+        out[2 * i + 1] = static_cast<uint8_t>(m[2] * x0 + m[3] * x1);
+    }
+}
+
+#if defined(__x86_64__)
+// 16 пар за итерацию: пара - 16-битная ячейка (младший байт - x0), умножение
+// по модулю 2^16 сохраняет младший байт
+__attribute__((target("avx2")))
+void hillPairsAvx2(const uint8_t* in, size_t pairs, const uint16_t* m, uint8_t* out) {
+    const __m256i low = _mm256_set1_epi16(0xFF);
+    const __m256i m0 = _mm256_set1_epi16(static_cast<short>(m[0]));
+    const __m256i m1 = _mm256_set1_epi16(static_cast<short>(m[1]));
+    const __m256i m2 = _mm256_set1_epi16(static_cast<short>(m[2]));
+    const __m256i m3 = _mm256_set1_epi16(static_cast<short>(m[3]));
+    size_t i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+        __m256i x0 = _mm256_and_si256(w, low);
+        __m256i x1 = _mm256_srli_epi16(w, 8);
+        __m256i y0 = _mm256_add_epi16(_mm256_mullo_epi16(x0, m0), _mm256_mullo_epi16(x1, m1));
+        __m256i y1 = _mm256_add_epi16(_mm256_mullo_epi16(x0, m2), _mm256_mullo_epi16(x1, m3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i),
+                            _mm256_or_si256(_mm256_and_si256(y0, low), _mm256_slli_epi16(y1, 8)));
+    }
+    hillPairsScalar(in + 2 * i, pairs - i, m, out + 2 * i);
+}
+
+// 32 пары за итерацию: пара - 16-битная ячейка (младший байт - x0), умножение
+// по модулю 2^16 сохраняет младший байт. Хвост - та же итерация под маской,
+// поэтому короткое сообщение обрабатывается одной командой без скалярного цикла.
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i hillPairsStep(__m512i w, __m512i m0, __m512i m1, __m512i m2, __m512i m3) {
+    const __m512i low = _mm512_set1_epi16(0xFF);
+    __m512i x0 = _mm512_and_si512(w, low);
+    __m512i x1 = _mm512_srli_epi16(w, 8);
+    __m512i y0 = _mm512_add_epi16(_mm512_mullo_epi16(x0, m0), _mm512_mullo_epi16(x1, m1));
+    __m512i y1 = _mm512_add_epi16(_mm512_mullo_epi16(x0, m2), _mm512_mullo_epi16(x1, m3));
+    return _mm512_or_si512(_mm512_and_si512(y0, low), _mm512_slli_epi16(y1, 8));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void hillPairsAvx512(const uint8_t* in, size_t pairs, const uint16_t* m, uint8_t* out) {
+    const __m512i m0 = _mm512_set1_epi16(static_cast<short>(m[0]));
+    const __m512i m1 = _mm512_set1_epi16(static_cast<short>(m[1]));
+    const __m512i m2 = _mm512_set1_epi16(static_cast<short>(m[2]));
+    const __m512i m3 = _mm512_set1_epi16(static_cast<short>(m[3]));
+    size_t i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m512i w = _mm512_loadu_si512(in + 2 * i);
+        _mm512_storeu_si512(out + 2 * i, hillPairsStep(w, m0, m1, m2, m3));
+    }
+    if (i < pairs) {
+        __mmask32 mask = static_cast<__mmask32>((1ULL << (pairs - i)) - 1);
+        __m512i w = _mm512_maskz_loadu_epi16(mask, in + 2 * i);
+        _mm512_mask_storeu_epi16(out + 2 * i, mask, hillPairsStep(w, m0, m1, m2, m3));
+    }
+}
+#endif
+
+KernelTable<HillPairsFunc>& hillPairsKernels() {
+    static KernelTable<HillPairsFunc> table({
+        {"scalar", hillPairsScalar, true},
+#if defined(__x86_64__)
+        {"avx2", hillPairsAvx2, __builtin_cpu_supports("avx2") != 0},
+        {"avx512", hillPairsAvx512, __builtin_cpu_supports("avx512bw") != 0},
+#endif
+    });
+    return table;
+}
+
+// Шифрование size байтов in в out; последний нечетный байт копируется как есть
+void hillApply(const char* in, size_t size, const uint16_t m[4], char* out) {
+    const HillPairsFunc pairs = hillPairsKernels().get(size);
+    pairs(reinterpret_cast<const uint8_t*>(in), size / 2, m, reinterpret_cast<uint8_t*>(out));
+    if (size % 2) out[size - 1] = in[size - 1];
+}
+
+// Обработка бинарных данных
+string processBytes(const string& data, const vector<vector<int>>& key, bool decrypt) {
+    uint16_t m[4];
+    hillKernelMatrix(key, decrypt, m);
+    string result(data.size(), '\0');
+    if (!data.empty()) hillApply(data.data(), data.size(), m, &result[0]);
     return result;
 }
 
+CipherBatch hillProcessBatch(const CipherMessage* messages, size_t count,
+                             const vector<vector<int>>* keys, size_t keyCount, bool decrypt) {
+    CipherBatch batch;
+    batch.offsets.assign(count + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        if (messages[i].key >= keyCount) throw out_of_range("Сообщение пакета ссылается на несуществующий ключ");
+        batch.offsets[i + 1] = batch.offsets[i] + messages[i].size;
+    }
+    batch.arena.resize(batch.offsets[count]);
+
+    // Матрица (и обратная при дешифровании) вычисляется один раз на ключ
+    vector<uint16_t> matrices(keyCount * 4);
+    vector<bool> used(keyCount, false);
+    for (size_t i = 0; i < count; ++i) used[messages[i].key] = true;
+    for (size_t k = 0; k < keyCount; ++k) {
+        if (used[k]) hillKernelMatrix(keys[k], decrypt, &matrices[k * 4]);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (messages[i].size == 0) continue;
+        hillApply(messages[i].data, messages[i].size, &matrices[messages[i].key * 4],
+                  &batch.arena[batch.offsets[i]]);
+    }
+    return batch;
+}
+
+CipherBatch hillEncryptBatch(const CipherMessage* messages, size_t count,
+                             const vector<vector<int>>* keys, size_t keyCount) {
+    return hillProcessBatch(messages, count, keys, keyCount, false);
+}
+
+CipherBatch hillDecryptBatch(const CipherMessage* messages, size_t count,
+                             const vector<vector<int>>* keys, size_t keyCount) {
+    return hillProcessBatch(messages, count, keys, keyCount, true);
+}
+
 //шифрование бинарных данных
 string hillEncrypt(const string& data, const vector<vector<int>>& key) {
     return processBytes(data, key, false);
@@ -209,6 +311,25 @@ void hillDecryptFile(const std::string& inputFile, const std::string& outputFile
     out.write(decrypted.data(), decrypted.size());
 }
 
+// Дешифрование диапазона файла. Пары байтов выровнены по началу файла,
+// поэтому диапазон расширяется до границ пар, а лишнее отрезается.
+string hillDecryptFileRange(const std::string& inputFile, uint64_t offset, uint64_t length,
+                            const std::vector<std::vector<int>>& key) {
+    MappedFile range(inputFile, offset, length);
+    uint64_t end = offset + range.size();
+    if (range.size() == 0) return "";
+
+    uint64_t alignedStart = offset & ~uint64_t(1);
+    uint64_t alignedEnd = end;
+    if (alignedEnd % 2 == 1 && alignedEnd < range.fileSize()) {
+        alignedEnd += 1; // последний нечетный байт файла не шифруется - его не дополняем
+    }
+
+    MappedFile in(inputFile, alignedStart, alignedEnd - alignedStart);
+    string decrypted = hillDecrypt(string(in.data(), in.size()), key);
+    return decrypted.substr(offset - alignedStart, end - offset);
+}
+
 // сохранение ключа в бинарный файл
 void saveHillKey(const vector<vector<int>>& key, const string& filename) {
     ofstream file(filename, ios::binary);
@@ -240,3 +361,438 @@ vector<vector<int>> loadHillKey(const string& filename) {
     
     return key;
 }
+
+// ---- Хилл над GF(2^8) ----
+
+const char GF_KEY_MAGIC[4] = {'H', 'L', 'G', 'F'};
+const size_t GF_MAX_BLOCK = 64;
+
+// Таблицы степеней и логарифмов по образующей 3; степени продублированы,
+// чтобы сумма логарифмов не приводилась по модулю 255
+struct GfTables {
+    uint8_t exp[512];
+    int log[256];
+
+    GfTables() {
+        uint8_t x = 1;
+        for (int i = 0; i < 255; ++i) {
+            exp[i] = exp[i + 255] = x;
+            log[x] = i;
+            x ^= static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1B : 0)); //x * 3
+        }
+        exp[510] = exp[511] = exp[0];
+        log[0] = -1;
+    }
+};
+
+const GfTables& gfTables() {
+    static const GfTables tables;
+    return tables;
+}
+
+uint8_t gfMul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) return 0;
+    const GfTables& t = gfTables();
+    return t.exp[t.log[a] + t.log[b]];
+}
+
+uint8_t gfInverse(uint8_t a) {
+    const GfTables& t = gfTables();
+    return t.exp[255 - t.log[a]];
+}
+
+bool isGfBlockSize(size_t n) {
+    return n >= 2 && n <= GF_MAX_BLOCK && (n & (n - 1)) == 0;
+}
+
+// Матрица ключа в байтах по строкам (с проверкой формы)
+vector<uint8_t> gfMatrixBytes(const vector<vector<int>>& key) {
+    size_t n = key.size();
+    if (!isGfBlockSize(n)) throw invalid_argument("Размер блока Хилла GF(2^8) - степень двойки от 2 до 64");
+    vector<uint8_t> bytes(n * n);
+    for (size_t i = 0; i < n; ++i) {
+        if (key[i].size() != n) throw invalid_argument("Матрица ключа Хилла должна быть квадратной");
+        for (size_t j = 0; j < n; ++j) {
+            if (key[i][j] < 0 || key[i][j] > 255) throw invalid_argument("Элементы ключа GF(2^8) - байты 0..255");
+            bytes[i * n + j] = static_cast<uint8_t>(key[i][j]);
+        }
+    }
+    return bytes;
+}
+
+// Обращение методом Гаусса-Жордана; false, если матрица вырождена
+bool gfInvertMatrix(vector<uint8_t> a, size_t n, vector<uint8_t>& inverse) {
+    inverse.assign(n * n, 0);
+    for (size_t i = 0; i < n; ++i) inverse[i * n + i] = 1;
+
+    for (size_t col = 0; col < n; ++col) {
+        size_t pivot = col;
+        while (pivot < n && a[pivot * n + col] == 0) ++pivot;
+        if (pivot == n) return false;
+        if (pivot != col) {
+            for (size_t j = 0; j < n; ++j) {
+                swap(a[pivot * n + j], a[col * n + j]);
+                swap(inverse[pivot * n + j], inverse[col * n + j]);
+            }
+        }
+        uint8_t scale = gfInverse(a[col * n + col]);
+        for (size_t j = 0; j < n; ++j) {
+            a[col * n + j] = gfMul(a[col * n + j], scale);
+            inverse[col * n + j] = gfMul(inverse[col * n + j], scale);
+        }
+        for (size_t row = 0; row < n; ++row) {
+            uint8_t factor = a[row * n + col];
+            if (row == col || factor == 0) continue;
+            for (size_t j = 0; j < n; ++j) { //вычитание в поле - XOR
+                a[row * n + j] ^= gfMul(factor, a[col * n + j]);
+                inverse[row * n + j] ^= gfMul(factor, inverse[col * n + j]);
+            }
+        }
+    }
+    return true;
+}
+
+typedef void (*GfMultiplyFunc)(const uint8_t*, size_t, size_t, const uint8_t*, uint8_t*);
+
+// y = M * x для blocks блоков по n байтов через таблицы логарифмов
+void gfMultiplyScalar(const uint8_t* in, size_t blocks, size_t n, const uint8_t* matrix, uint8_t* out) {
+    const GfTables& t = gfTables();
+    vector<int> logMatrix(n * n);
+    for (size_t k = 0; k < n * n; ++k) logMatrix[k] = t.log[matrix[k]];
+
+    int logX[GF_MAX_BLOCK];
+    for (size_t b = 0; b < blocks; ++b) {
+        const uint8_t* x = in + b * n;
+        for (size_t j = 0; j < n; ++j) logX[j] = t.log[x[j]];
+        for (size_t i = 0; i < n; ++i) {
+            const int* row = &logMatrix[i * n];
+            uint8_t acc = 0;
+            for (size_t j = 0; j < n; ++j) {
+                if (logX[j] >= 0 && row[j] >= 0) acc ^= t.exp[logX[j] + row[j]];
+            }
+            out[b * n + i] = acc;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+// Вариант для процессоров с GFNI без AVX-512 (VEX-кодировка, 32 байта).
+// Блоки до 16 байтов не пересекают 128-битную половину регистра, поэтому
+// байт j размножается по блоку внутриполовинной VPSHUFB; блок в 32 и 64
+// байта занимает целые регистры, и байт j просто размножается на регистр.
+// 32 байта блоков не длиннее 16 байтов
+__attribute__((target("avx2,gfni")))
+inline __m256i gfMultiplyLanes(__m256i x, size_t n, const __m256i* columns, const __m256i* spread) {
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t j = 0; j < n; ++j) {
+        acc = _mm256_xor_si256(acc, _mm256_gf2p8mul_epi8(columns[j], _mm256_shuffle_epi8(x, spread[j])));
+    }
+    return acc;
+}
+
+__attribute__((target("avx2,gfni")))
+void gfMultiplyGfniAvx2(const uint8_t* in, size_t blocks, size_t n, const uint8_t* matrix, uint8_t* out) {
+    alignas(32) uint8_t column[32];
+    if (n >= 32) {
+        const size_t parts = n / 32;
+        __m256i columns[GF_MAX_BLOCK][GF_MAX_BLOCK / 32];
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t p = 0; p < parts; ++p) {
+                for (size_t k = 0; k < 32; ++k) column[k] = matrix[(p * 32 + k) * n + j];
+                columns[j][p] = _mm256_load_si256(reinterpret_cast<const __m256i*>(column));
+            }
+        }
+        for (size_t b = 0; b < blocks; ++b) {
+            const uint8_t* x = in + b * n;
+            __m256i acc[GF_MAX_BLOCK / 32] = {};
+            for (size_t j = 0; j < n; ++j) {
+                __m256i spread = _mm256_set1_epi8(static_cast<char>(x[j]));
+                for (size_t p = 0; p < parts; ++p) {
+                    acc[p] = _mm256_xor_si256(acc[p], _mm256_gf2p8mul_epi8(columns[j][p], spread));
+                }
+            }
+            for (size_t p = 0; p < parts; ++p) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + b * n + p * 32), acc[p]);
+            }
+        }
+        return;
+    }
+
+    __m256i columns[16], spread[16];
+    alignas(32) uint8_t index[32];
+    for (size_t j = 0; j < n; ++j) {
+        for (size_t k = 0; k < 32; ++k) {
+            column[k] = matrix[(k % n) * n + j];
+            index[k] = static_cast<uint8_t>(k % 16 / n * n + j);
+        }
+        columns[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(column));
+        spread[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(index));
+    }
+    size_t size = blocks * n, i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), gfMultiplyLanes(x, n, columns, spread));
+    }
+    if (i < size) { //остаток - целые блоки, меньше 32 байтов
+        alignas(32) uint8_t tail[32] = {};
+        memcpy(tail, in + i, size - i);
+        __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(tail));
+        __m256i y = gfMultiplyLanes(x, n, columns, spread);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(tail), y);
+        memcpy(out + i, tail, size - i);
+    }
+}
+
+// 64 байта (64 / n блоков) за итерацию: для столбца j байт j каждого блока
+// размножается по блоку (VPERMB), умножается на столбец матрицы,
+// повторенный для каждого блока (GF2P8MULB), и прибавляется XOR
+__attribute__((target("avx512f,avx512bw,avx512vbmi,gfni")))
+void gfMultiplyGfni(const uint8_t* in, size_t blocks, size_t n, const uint8_t* matrix, uint8_t* out) {
+    __m512i columns[GF_MAX_BLOCK], spread[GF_MAX_BLOCK];
+    alignas(64) uint8_t column[64], index[64];
+    for (size_t j = 0; j < n; ++j) {
+        for (size_t k = 0; k < 64; ++k) {
+            column[k] = matrix[(k % n) * n + j];
+            index[k] = static_cast<uint8_t>(k / n * n + j);
+        }
+        columns[j] = _mm512_load_si512(column);
+        spread[j] = _mm512_load_si512(index);
+    }
+
+    size_t size = blocks * n, i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m512i x = _mm512_loadu_si512(in + i);
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t j = 0; j < n; ++j) {
+            acc = _mm512_xor_si512(acc, _mm512_gf2p8mul_epi8(columns[j], _mm512_permutexvar_epi8(spread[j], x)));
+        }
+        _mm512_storeu_si512(out + i, acc);
+    }
+    if (i < size) { //остаток - целые блоки, меньше 64 байтов
+        __mmask64 mask = (1ULL << (size - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(mask, in + i);
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t j = 0; j < n; ++j) {
+            acc = _mm512_xor_si512(acc, _mm512_gf2p8mul_epi8(columns[j], _mm512_permutexvar_epi8(spread[j], x)));
+        }
+        _mm512_mask_storeu_epi8(out + i, mask, acc);
+    }
+}
+#endif
+
+KernelTable<GfMultiplyFunc>& gfMultiplyKernels() {
+    static KernelTable<GfMultiplyFunc> table({
+        {"scalar", gfMultiplyScalar, true},
+#if defined(__x86_64__)
+        {"gfni-avx2", gfMultiplyGfniAvx2, __builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2")},
+        {"gfni", gfMultiplyGfni, __builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx512vbmi")
+                                     && __builtin_cpu_supports("avx512bw")},
+#endif
+    });
+    return table;
+}
+
+string gfProcess(const string& data, const vector<uint8_t>& matrix, size_t n) {
+    const GfMultiplyFunc multiply = gfMultiplyKernels().get(data.size());
+    string result = data; //неполный последний блок остается как есть
+    size_t blocks = data.size() / n;
+    if (blocks > 0) {
+        multiply(reinterpret_cast<const uint8_t*>(data.data()), blocks, n, matrix.data(),
+                 reinterpret_cast<uint8_t*>(&result[0]));
+    }
+    return result;
+}
+
+vector<vector<int>> generateHillGfKey(size_t blockSize) {
+    if (!isGfBlockSize(blockSize)) throw invalid_argument("Размер блока Хилла GF(2^8) - степень двойки от 2 до 64");
+    random_device rd;
+    mt19937 gen(rd());
+    uniform_int_distribution<> dist(0, 255);
+
+    vector<vector<int>> key(blockSize, vector<int>(blockSize));
+    vector<uint8_t> inverse;
+    do { //случайная матрица над GF(2^8) почти всегда обратима
+        for (auto& row : key) {
+            for (int& value : row) value = dist(gen);
+        }
+    } while (!gfInvertMatrix(gfMatrixBytes(key), blockSize, inverse));
+    return key;
+}
+
+string hillGfEncrypt(const string& text, const vector<vector<int>>& key) {
+    return gfProcess(text, gfMatrixBytes(key), key.size());
+}
+
+string hillGfDecrypt(const string& ciphertext, const vector<vector<int>>& key) {
+    vector<uint8_t> inverse;
+    if (!gfInvertMatrix(gfMatrixBytes(key), key.size(), inverse)) {
+        throw runtime_error("Матрица ключа Хилла GF(2^8) необратима");
+    }
+    return gfProcess(ciphertext, inverse, key.size());
+}
+
+void saveHillGfKey(const vector<vector<int>>& key, const string& filename) {
+    vector<uint8_t> bytes = gfMatrixBytes(key);
+    ofstream file(filename, ios::binary);
+    if (!file) throw runtime_error("Cannot open key file");
+
+    uint32_t blockSize = static_cast<uint32_t>(key.size());
+    uint8_t size[4] = {static_cast<uint8_t>(blockSize), static_cast<uint8_t>(blockSize >> 8),
+                       static_cast<uint8_t>(blockSize >> 16), static_cast<uint8_t>(blockSize >> 24)};
+    file.write(GF_KEY_MAGIC, sizeof(GF_KEY_MAGIC));
+    file.write(reinterpret_cast<const char*>(size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+vector<vector<int>> loadHillGfKey(const string& filename) {
+    ifstream file(filename, ios::binary);
+    if (!file) throw runtime_error("Cannot open key file");
+
+    char magic[4];
+    uint8_t size[4];
+    if (!file.read(magic, 4) || memcmp(magic, GF_KEY_MAGIC, 4) != 0 || !file.read(reinterpret_cast<char*>(size), 4)) {
+        throw runtime_error("Файл не является ключом Хилла GF(2^8)");
+    }
+    size_t n = size[0] | (size[1] << 8) | (size[2] << 16) | (static_cast<uint32_t>(size[3]) << 24);
+    if (!isGfBlockSize(n)) throw runtime_error("Недопустимый размер блока в ключе Хилла GF(2^8)");
+
+    vector<char> bytes(n * n);
+    if (!file.read(bytes.data(), bytes.size())) throw runtime_error("Ключ Хилла GF(2^8) обрезан");
+    vector<vector<int>> key(n, vector<int>(n));
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) key[i][j] = static_cast<unsigned char>(bytes[i * n + j]);
+    }
+
+    vector<uint8_t> inverse;
+    if (!gfInvertMatrix(gfMatrixBytes(key), n, inverse)) {
+        throw runtime_error("Loaded key matrix is not invertible");
+    }
+    return key;
+}
+
+// ---- Смена ключа ----
+
+// K_new * K_old^-1: шифртекст старого ключа переводится в шифртекст нового
+// одним умножением, без открытого текста
+vector<vector<int>> hillComposeKeys(const vector<vector<int>>& oldKey, const vector<vector<int>>& newKey) {
+    uint16_t inverse[4];
+    hillKernelMatrix(oldKey, true, inverse);
+    uint16_t target[4];
+    hillKernelMatrix(newKey, false, target);
+    vector<vector<int>> result(2, vector<int>(2));
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            result[i][j] = (target[i * 2] * inverse[j] + target[i * 2 + 1] * inverse[2 + j]) % ALPHABET_SIZE;
+        }
+    }
+    return result;
+}
+
+vector<vector<int>> hillGfComposeKeys(const vector<vector<int>>& oldKey, const vector<vector<int>>& newKey) {
+    size_t n = oldKey.size();
+    if (newKey.size() != n) throw invalid_argument("Размеры блоков старого и нового ключей Хилла GF(2^8) различаются");
+    vector<uint8_t> inverse;
+    if (!gfInvertMatrix(gfMatrixBytes(oldKey), n, inverse)) {
+        throw runtime_error("Матрица ключа Хилла GF(2^8) необратима");
+    }
+    vector<uint8_t> target = gfMatrixBytes(newKey);
+    vector<vector<int>> result(n, vector<int>(n));
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            uint8_t sum = 0;
+            for (size_t k = 0; k < n; ++k) sum ^= gfMul(target[i * n + k], inverse[k * n + j]);
+            result[i][j] = sum;
+        }
+    }
+    return result;
+}
+
+// ---- Потоковая обработка ----
+
+// Контекст накапливает неполный блок между вызовами update; полные блоки
+// обрабатываются сразу, поэтому память ограничена размером порции
+struct HillContext {
+    bool gf = false;
+    size_t block = 2;            // байтов в блоке
+    uint16_t matrix[4] = {};     // Хилл по модулю 256
+    vector<uint8_t> gfMatrix;    // Хилл над GF(2^8)
+    string pending;              // начало неполного блока (< block байтов)
+};
+
+// size - целое число блоков
+void contextApply(const HillContext& context, const char* in, size_t size, char* out) {
+    if (size == 0) return;
+    if (context.gf) {
+        gfMultiplyKernels().get(size)(reinterpret_cast<const uint8_t*>(in), size / context.block, context.block,
+                                      context.gfMatrix.data(), reinterpret_cast<uint8_t*>(out));
+    } else {
+        hillApply(in, size, context.matrix, out);
+    }
+}
+
+HillContext* hillInit(const vector<vector<int>>& key, bool decrypt) {
+    HillContext* context = new HillContext();
+    try {
+        hillKernelMatrix(key, decrypt, context->matrix);
+    } catch (...) {
+        delete context;
+        throw;
+    }
+    return context;
+}
+
+HillContext* hillGfInit(const vector<vector<int>>& key, bool decrypt) {
+    vector<uint8_t> matrix = gfMatrixBytes(key);
+    if (decrypt) {
+        vector<uint8_t> inverse;
+        if (!gfInvertMatrix(matrix, key.size(), inverse)) {
+            throw runtime_error("Матрица ключа Хилла GF(2^8) необратима");
+        }
+        matrix = inverse;
+    }
+    HillContext* context = new HillContext();
+    context->gf = true;
+    context->block = key.size();
+    context->gfMatrix = move(matrix);
+    return context;
+}
+
+void hillUpdate(HillContext* context, const char* data, size_t size, string& out) {
+    if (!context->pending.empty()) {
+        size_t take = min(context->block - context->pending.size(), size);
+        context->pending.append(data, take);
+        data += take;
+        size -= take;
+        if (context->pending.size() < context->block) return;
+        size_t at = out.size();
+        out.resize(at + context->block);
+        contextApply(*context, context->pending.data(), context->block, &out[at]);
+        context->pending.clear();
+    }
+    size_t whole = size / context->block * context->block;
+    size_t at = out.size();
+    out.resize(at + whole);
+    contextApply(*context, data, whole, &out[at]);
+    context->pending.assign(data + whole, size - whole);
+}
+
+void hillFinal(HillContext* context, string& out) {
+    out += context->pending; //неполный последний блок не шифруется
+    context->pending.clear();
+}
+
+void hillFree(HillContext* context) {
+    delete context;
+}
+
+vector<string> hillKernelNames(const string& family) {
+    if (family == "hill") return hillPairsKernels().names();
+    if (family == "hill-gf") return gfMultiplyKernels().names();
+    return {};
+}
+
+bool hillSelectKernel(const string& family, size_t bucket, const string& name) {
+    if (family == "hill") return hillPairsKernels().select(bucket, name);
+    if (family == "hill-gf") return gfMultiplyKernels().select(bucket, name);
+    return false;
+}
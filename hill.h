@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include "cipher_batch.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,6 +22,16 @@ std::string hillEncrypt(const std::string& text, const std::vector<std::vector<i
 __attribute__((visibility("default")))
 std::string hillDecrypt(const std::string& ciphertext, const std::vector<std::vector<int>>& key);
 
+// Пакетное шифрование/дешифрование: сообщение i обрабатывается ключом
+// keys[messages[i].key], результаты - подряд в одном буфере (см. cipher_batch.h)
+__attribute__((visibility("default")))
+CipherBatch hillEncryptBatch(const CipherMessage* messages, size_t count,
+                             const std::vector<std::vector<int>>* keys, size_t keyCount);
+
+__attribute__((visibility("default")))
+CipherBatch hillDecryptBatch(const CipherMessage* messages, size_t count,
+                             const std::vector<std::vector<int>>* keys, size_t keyCount);
+
 // Сохранение ключа в файл
 __attribute__((visibility("default")))
 void saveHillKey(const std::vector<std::vector<int>>& key, const std::string& filename);
@@ -32,10 +44,78 @@ __attribute__((visibility("default")))
 void hillDecryptFile(const std::string& inputFile, const std::string& outputFile,
                     const std::vector<std::vector<int>>& key);
 
+// Дешифрование байтов [offset, offset + length) файла без чтения всего файла
+__attribute__((visibility("default")))
+std::string hillDecryptFileRange(const std::string& inputFile, uint64_t offset, uint64_t length,
+                                 const std::vector<std::vector<int>>& key);
+
 // Загрузка ключа из файла
 __attribute__((visibility("default")))
 std::vector<std::vector<int>> loadHillKey(const std::string& filename);
 
+// Хилл над полем GF(2^8) (многочлен x^8 + x^4 + x^3 + x + 1): ключ - матрица
+// blockSize x blockSize из байтов 0..255, блок открытого текста - столбец из
+// blockSize байтов. В поле обратима любая матрица с ненулевым определителем,
+// а умножение отображается на GF2P8MULB (без GFNI - таблицы логарифмов).
+// Размер блока - степень двойки от 2 до 64; неполный последний блок не шифруется.
+__attribute__((visibility("default")))
+std::vector<std::vector<int>> generateHillGfKey(size_t blockSize);
+
+__attribute__((visibility("default")))
+std::string hillGfEncrypt(const std::string& text, const std::vector<std::vector<int>>& key);
+
+__attribute__((visibility("default")))
+std::string hillGfDecrypt(const std::string& ciphertext, const std::vector<std::vector<int>>& key);
+
+// Формат ключа GF(2^8): "HLGF", размер блока (uint32 LE), матрица по строкам (байты)
+__attribute__((visibility("default")))
+void saveHillGfKey(const std::vector<std::vector<int>>& key, const std::string& filename);
+
+__attribute__((visibility("default")))
+std::vector<std::vector<int>> loadHillGfKey(const std::string& filename);
+
+// Ключ смены ключа K_new * K_old^-1: шифрование шифртекста старого ключа
+// этой матрицей дает шифртекст нового ключа (неполный блок не меняется)
+__attribute__((visibility("default")))
+std::vector<std::vector<int>> hillComposeKeys(const std::vector<std::vector<int>>& oldKey,
+                                              const std::vector<std::vector<int>>& newKey);
+
+// То же над GF(2^8); размеры блоков ключей должны совпадать
+__attribute__((visibility("default")))
+std::vector<std::vector<int>> hillGfComposeKeys(const std::vector<std::vector<int>>& oldKey,
+                                                const std::vector<std::vector<int>>& newKey);
+
+// Потоковое шифрование/дешифрование: update принимает порции любого размера
+// и дописывает в out все, что уже определено; final дописывает остаток
+// (неполный последний блок - как есть, как и при обработке целиком) и
+// возвращает контекст в начальное состояние для следующего сообщения.
+// Результат совпадает с hillEncrypt/hillGfEncrypt от всего сообщения.
+struct HillContext;
+
+__attribute__((visibility("default")))
+HillContext* hillInit(const std::vector<std::vector<int>>& key, bool decrypt);
+
+__attribute__((visibility("default")))
+HillContext* hillGfInit(const std::vector<std::vector<int>>& key, bool decrypt);
+
+__attribute__((visibility("default")))
+void hillUpdate(HillContext* context, const char* data, size_t size, std::string& out);
+
+__attribute__((visibility("default")))
+void hillFinal(HillContext* context, std::string& out);
+
+__attribute__((visibility("default")))
+void hillFree(HillContext* context);
+
+// Варианты ядер семейства ("hill" - матрица 2x2, "hill-gf" - умножение над
+// GF(2^8)), доступные на этом процессоре, и выбор варианта для корзины
+// размеров (см. kernel_table.h)
+__attribute__((visibility("default")))
+std::vector<std::string> hillKernelNames(const std::string& family);
+
+__attribute__((visibility("default")))
+bool hillSelectKernel(const std::string& family, size_t bucket, const std::string& name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,322 @@
+#include "hill_analysis.h"
+#include "text_model.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+using namespace std;
+
+// Из hill.cpp
+bool isMatrixInvertible(const vector<vector<int>>& matrix, int mod);
+string processBytes(const string& data, const vector<vector<int>>& key, bool decrypt);
+
+namespace {
+
+const int MOD = 256;
+// Пар шифртекста, по которым оцениваются кандидаты
+const size_t SAMPLE_PAIRS = 4096;
+// Через сколько пар проверяется, может ли кандидат еще попасть в лучшие
+const size_t SCORE_BLOCK = 64;
+// Лучших кандидатов каждой строки для сборки матрицы
+const size_t KEEP = 16;
+
+// Известный байт открытого текста: a*x0 + b*x1 = y (mod 256)
+struct Constraint {
+    uint8_t x0, x1, y;
+};
+
+struct RowCandidate {
+    uint8_t a, b;
+    float score;
+};
+
+struct RowSearch {
+    vector<RowCandidate> best;      // по убыванию оценки
+    uint64_t parityCounts[4] = {};  // согласованных строк по четности (a&1, b&1)
+};
+
+int mod256(int value) {
+    value %= MOD;
+    return value < 0 ? value + MOD : value;
+}
+
+// Обратная матрица 2x2 по модулю 256
+vector<vector<int>> invertMatrix(const vector<vector<int>>& m) {
+    int det = mod256(m[0][0] * m[1][1] - m[0][1] * m[1][0]);
+    int detInv = -1;
+    for (int i = 1; i < MOD; i += 2) {
+        if ((det * i) % MOD == 1) {
+            detInv = i;
+            break;
+        }
+    }
+    if (detInv == -1) throw runtime_error("Key matrix is not invertible");
+
+    return {
+        {mod256(m[1][1] * detInv), mod256(-m[0][1] * detInv)},
+        {mod256(-m[1][0] * detInv), mod256(m[0][0] * detInv)}
+    };
+}
+
+vector<vector<int>> multiplyMatrix(const vector<vector<int>>& x, const vector<vector<int>>& y) {
+    vector<vector<int>> result(2, vector<int>(2));
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            result[i][j] = mod256(x[i][0] * y[0][j] + x[i][1] * y[1][j]);
+        }
+    }
+    return result;
+}
+
+void keepBest(vector<RowCandidate>& best, const RowCandidate& candidate) {
+    if (best.size() >= KEEP && candidate.score <= best.back().score) return;
+    auto pos = upper_bound(best.begin(), best.end(), candidate,
+                           [](const RowCandidate& x, const RowCandidate& y) { return x.score > y.score; });
+    best.insert(pos, candidate);
+    if (best.size() > KEEP) best.pop_back();
+}
+
+// Перебор одной строки (a, b) матрицы расшифрования: байт открытого текста
+// равен a*c0 + b*c1. Строки независимы, поэтому вместо 2^32 матриц
+// перебираются 2 * 2^16 строк.
+RowSearch searchRow(const vector<Constraint>& constraints, const vector<uint8_t>& s0,
+                    const vector<uint8_t>& s1, const array<float, 256>& logReference, unsigned threads) {
+    threads = resolveThreads(threads, MOD);
+    vector<RowSearch> partial(threads);
+    const float maxLog = *max_element(logReference.begin(), logReference.end());
+    const size_t samples = s0.size();
+
+    parallelRanges(threads, MOD, [&](unsigned t, size_t aBegin, size_t aEnd) {
+        RowSearch& local = partial[t];
+        vector<uint8_t> active;
+        vector<float> scores;
+        active.reserve(MOD);
+        scores.reserve(MOD);
+
+        for (size_t a = aBegin; a < aEnd; ++a) {
+            // Отбрасывание по известным байтам (до первого несовпадения)
+            active.clear();
+            for (int b = 0; b < MOD; ++b) {
+                bool consistent = true;
+                for (const Constraint& c : constraints) {
+                    if (static_cast<uint8_t>(a * c.x0 + b * c.x1) != c.y) {
+                        consistent = false;
+                        break;
+                    }
+                }
+                if (consistent) {
+                    active.push_back(static_cast<uint8_t>(b));
+                    local.parityCounts[((a & 1) << 1) | (b & 1)]++;
+                }
+            }
+
+            // Оценка всех оставшихся b сразу, блоками пар шифртекста
+            scores.assign(active.size(), 0.0f);
+            for (size_t start = 0; start < samples && !active.empty(); start += SCORE_BLOCK) {
+                size_t end = min(samples, start + SCORE_BLOCK);
+                for (size_t q = start; q < end; ++q) {
+                    uint8_t base = static_cast<uint8_t>(a * s0[q]);
+                    uint8_t factor = s1[q];
+                    for (size_t k = 0; k < active.size(); ++k) {
+                        scores[k] += logReference[static_cast<uint8_t>(base + active[k] * factor)];
+                    }
+                }
+
+                // Ранний отказ: даже при лучших оставшихся байтах не догнать худшего из лучших
+                if (local.best.size() >= KEEP) {
+                    float threshold = local.best.back().score - (samples - end) * maxLog;
+                    size_t kept = 0;
+                    for (size_t k = 0; k < active.size(); ++k) {
+                        if (scores[k] > threshold) {
+                            active[kept] = active[k];
+                            scores[kept] = scores[k];
+                            ++kept;
+                        }
+                    }
+                    active.resize(kept);
+                    scores.resize(kept);
+                }
+            }
+
+            for (size_t k = 0; k < active.size(); ++k) {
+                keepBest(local.best, {static_cast<uint8_t>(a), active[k], scores[k]});
+            }
+        }
+    });
+
+    RowSearch merged;
+    for (const RowSearch& local : partial) {
+        for (const RowCandidate& candidate : local.best) keepBest(merged.best, candidate);
+        for (int p = 0; p < 4; ++p) merged.parityCounts[p] += local.parityCounts[p];
+    }
+    return merged;
+}
+
+bool satisfies(const RowCandidate& row, const vector<Constraint>& constraints) {
+    for (const Constraint& c : constraints) {
+        if (static_cast<uint8_t>(row.a * c.x0 + row.b * c.x1) != c.y) return false;
+    }
+    return true;
+}
+
+// Расшифровка пар строками first (первый байт) и second (второй)
+string decryptRows(const string& ciphertext, const RowCandidate& first, const RowCandidate& second) {
+    string plain(ciphertext.size() & ~static_cast<size_t>(1), '\0');
+    for (size_t i = 0; i < plain.size(); i += 2) {
+        uint8_t c0 = static_cast<uint8_t>(ciphertext[i]), c1 = static_cast<uint8_t>(ciphertext[i + 1]);
+        plain[i] = static_cast<char>(first.a * c0 + first.b * c1);
+        plain[i + 1] = static_cast<char>(second.a * c0 + second.b * c1);
+    }
+    return plain;
+}
+
+// Оценка расшифровки квадграммами: по эталону, если он задан, иначе лучшая
+// из встроенных моделей английского и русского
+double quadgramScore(const string& plaintext, const string& referenceSample) {
+    if (!referenceSample.empty()) {
+        try {
+            textmodel::QuadgramModel model(textmodel::detectLanguage(referenceSample), referenceSample);
+            return model.averageScore(plaintext);
+        } catch (const invalid_argument&) {
+            //эталон короче четырех символов - встроенные модели
+        }
+    }
+    static const textmodel::QuadgramModel english(textmodel::Language::ENGLISH, "");
+    static const textmodel::QuadgramModel russian(textmodel::Language::RUSSIAN, "");
+    return max(english.averageScore(plaintext), russian.averageScore(plaintext));
+}
+
+} // namespace
+
+HillRecovery hillSearchKey(const string& ciphertext, const string& crib, size_t cribOffset,
+                           const string& referenceSample, unsigned threads) {
+    const size_t pairs = ciphertext.size() / 2;
+    if (pairs == 0) throw invalid_argument("Недостаточно данных для анализа");
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(ciphertext.data());
+
+    // Известные байты открытого текста дают ограничения на строку своей четности
+    vector<Constraint> constraints[2];
+    for (size_t i = 0; i < crib.size(); ++i) {
+        size_t position = cribOffset + i;
+        size_t pair = position / 2;
+        if (pair >= pairs) break; //последний нечетный байт не шифруется
+        constraints[position % 2].push_back({c[2 * pair], c[2 * pair + 1], static_cast<uint8_t>(crib[i])});
+    }
+
+    size_t samples = min(pairs, SAMPLE_PAIRS);
+    vector<uint8_t> s0(samples), s1(samples);
+    for (size_t q = 0; q < samples; ++q) {
+        s0[q] = c[2 * q];
+        s1[q] = c[2 * q + 1];
+    }
+
+    array<double, 256> logs = textmodel::byteLogProbabilities(referenceSample);
+    array<float, 256> logReference;
+    for (int b = 0; b < 256; ++b) logReference[b] = static_cast<float>(logs[b]);
+
+    RowSearch rows[2] = {
+        searchRow(constraints[0], s0, s1, logReference, threads),
+        searchRow(constraints[1], s0, s1, logReference, threads)
+    };
+
+    HillRecovery result;
+    // Матрица обратима, когда определитель нечетный - считаем по классам четности строк
+    for (int p0 = 0; p0 < 4; ++p0) {
+        for (int p1 = 0; p1 < 4; ++p1) {
+            int det = ((p0 >> 1) & (p1 & 1)) ^ ((p0 & 1) & (p1 >> 1));
+            if (det) result.consistentKeys += rows[0].parityCounts[p0] * rows[1].parityCounts[p1];
+        }
+    }
+
+    // Лучшая обратимая комбинация строк
+    const RowCandidate* best0 = nullptr;
+    const RowCandidate* best1 = nullptr;
+    for (const RowCandidate& r0 : rows[0].best) {
+        for (const RowCandidate& r1 : rows[1].best) {
+            if (((r0.a * r1.b - r0.b * r1.a) & 1) == 0) continue;
+            if (!best0 || r0.score + r1.score > best0->score + best1->score) {
+                best0 = &r0;
+                best1 = &r1;
+            }
+        }
+    }
+    if (!best0) return result;
+
+    // Оценка по байтам не зависит от порядка строк: перестановка строк лишь
+    // меняет местами байты каждой пары. Если известные байты не закрепляют
+    // порядок (нет ограничений на строку одной из четностей), он выбирается
+    // по квадграммам расшифровки; неразличимые порядки - ключ не найден.
+    bool ambiguous = false;
+    if (satisfies(*best1, constraints[0]) && satisfies(*best0, constraints[1])) {
+        string sample = ciphertext.substr(0, 2 * samples);
+        double direct = quadgramScore(decryptRows(sample, *best0, *best1), referenceSample);
+        double swapped = quadgramScore(decryptRows(sample, *best1, *best0), referenceSample);
+        if (swapped > direct) swap(best0, best1);
+        ambiguous = swapped == direct;
+    }
+
+    vector<vector<int>> decryptMatrix = {{best0->a, best0->b}, {best1->a, best1->b}};
+    result.key = invertMatrix(decryptMatrix);
+    result.score = (best0->score + best1->score) / (2.0 * samples);
+
+    // Проверка известного фрагмента обычным дешифрованием (до целой пары:
+    // нечетный последний байт не расшифровывается)
+    size_t checkEnd = min(ciphertext.size(), cribOffset + crib.size());
+    string decrypted = cribOffset < checkEnd ? processBytes(ciphertext.substr(0, (checkEnd + 1) & ~static_cast<size_t>(1)),
+                                                            result.key, true)
+                                             : "";
+    result.found = !ambiguous && isMatrixInvertible(result.key, MOD)
+        && (decrypted.empty() || decrypted.compare(cribOffset, checkEnd - cribOffset, crib, 0, checkEnd - cribOffset) == 0);
+    return result;
+}
+
+HillRecovery hillRecoverKnownPlaintext(const string& plaintext, const string& ciphertext, unsigned threads) {
+    const size_t pairs = min(plaintext.size(), ciphertext.size()) / 2;
+    if (pairs == 0) throw invalid_argument("Недостаточно данных для анализа");
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(plaintext.data());
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(ciphertext.data());
+
+    // Две пары открытого текста образуют обратимую матрицу, если их векторы
+    // лежат в разных ненулевых классах четности
+    long representative[4] = {-1, -1, -1, -1};
+    long first = -1, second = -1;
+    for (size_t q = 0; q < pairs && second < 0; ++q) {
+        int parity = ((p[2 * q] & 1) << 1) | (p[2 * q + 1] & 1);
+        if (parity == 0 || representative[parity] >= 0) continue;
+        representative[parity] = static_cast<long>(q);
+        for (int other = 1; other < 4; ++other) {
+            if (other != parity && representative[other] >= 0) {
+                first = representative[other];
+                second = static_cast<long>(q);
+                break;
+            }
+        }
+    }
+
+    if (second < 0) {
+        // Система вырождена по модулю 2 - ключ определяется неоднозначно,
+        // перебор по всем известным байтам с оценкой остальных
+        return hillSearchKey(ciphertext, plaintext.substr(0, 2 * pairs), 0, "", threads);
+    }
+
+    // K * P = C  =>  K = C * P^-1
+    vector<vector<int>> plainMatrix = {{p[2 * first], p[2 * second]}, {p[2 * first + 1], p[2 * second + 1]}};
+    vector<vector<int>> cipherMatrix = {{c[2 * first], c[2 * second]}, {c[2 * first + 1], c[2 * second + 1]}};
+
+    HillRecovery result;
+    result.key = multiplyMatrix(cipherMatrix, invertMatrix(plainMatrix));
+    result.solvedDirectly = true;
+    if (!isMatrixInvertible(result.key, MOD)) return result;
+
+    // Ключ должен переводить все известные пары
+    for (size_t q = 0; q < pairs; ++q) {
+        for (int row = 0; row < 2; ++row) {
+            int value = mod256(result.key[row][0] * p[2 * q] + result.key[row][1] * p[2 * q + 1]);
+            if (value != c[2 * q + row]) return result;
+        }
+    }
+    result.found = true;
+    result.consistentKeys = 1;
+    return result;
+}
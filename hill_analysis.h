@@ -0,0 +1,40 @@
+#ifndef HILL_ANALYSIS_H
+#define HILL_ANALYSIS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Результат восстановления ключа Хилла
+struct HillRecovery {
+    bool found = false;
+    std::vector<std::vector<int>> key;  // ключ шифрования (формат saveHillKey)
+    uint64_t consistentKeys = 0;        // обратимых ключей, согласных с известным текстом
+    bool solvedDirectly = false;        // ключ найден решением системы, без перебора
+    double score = 0;                   // средний логарифм правдоподобия байта расшифровки
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Восстановление ключа по известному открытому тексту (начало файла).
+// Если пары байтов не дают обратимой матрицы, выполняется перебор
+// строк ключа с проверкой по всем известным парам.
+__attribute__((visibility("default")))
+HillRecovery hillRecoverKnownPlaintext(const std::string& plaintext, const std::string& ciphertext,
+                                       unsigned threads);
+
+// Перебор ключа, когда известна только часть открытого текста (crib со
+// смещением cribOffset) или не известно ничего. Кандидаты отбрасываются
+// по известным байтам, остальные оцениваются сходством расшифровки с
+// эталонным текстом (referenceSample, пустой - встроенный эталон).
+__attribute__((visibility("default")))
+HillRecovery hillSearchKey(const std::string& ciphertext, const std::string& crib, size_t cribOffset,
+                           const std::string& referenceSample, unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HILL_ANALYSIS_H
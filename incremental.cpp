@@ -0,0 +1,279 @@
+#include "incremental.h"
+#include "fast_hash.h"
+#include "file.h"
+#include "metrics.h"
+#include "parallel.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+const char MANIFEST_HEADER[] = "# rgr-manifest 2"; //затем соль
+const char LEGACY_MANIFEST_HEADER[] = "# rgr-manifest 1";
+const char KEY_ID_PURPOSE[] = "manifest key id";
+const char OUTPUT_SUFFIX[] = ".rgr";
+
+// Табуляция и перевод строки разделяют поля, поэтому в путях они кодируются
+string escapePath(const string& path) {
+    string result;
+    for (char c : path) {
+        if (c == '%') result += "%25";
+        else if (c == '\t') result += "%09";
+        else if (c == '\n') result += "%0A";
+        else result += c;
+    }
+    return result;
+}
+
+string unescapePath(const string& text) {
+    string result;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size()) {
+            result += static_cast<char>(stoi(text.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+// Состояние файла на этом запуске
+enum class FileState {
+    UNCHANGED,
+    TOUCHED,
+    CHANGED,
+    FAILED
+};
+
+struct ScannedFile {
+    ManifestEntry entry;
+    FileState state = FileState::CHANGED;
+    bool hashed = false;
+    string error;
+};
+
+bool statFile(const string& path, uint64_t& size, int64_t& mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+uint64_t hashFile(const string& path) {
+    MappedFile file(path);
+    return fastHash64(file.data(), file.size());
+}
+
+} // namespace
+
+Manifest loadManifest(const string& filename) {
+    Manifest manifest;
+    vector<ManifestEntry>& entries = manifest.entries;
+    ifstream file(filename);
+    if (!file) { //первый запуск
+        manifest.keySalt = randomKeySalt();
+        return manifest;
+    }
+
+    string line;
+    const size_t headerLength = sizeof(MANIFEST_HEADER) - 1;
+    if (!getline(file, line)) throw runtime_error("Файл не является манифестом: " + filename);
+    if (line == LEGACY_MANIFEST_HEADER) {
+        manifest.keySalt = randomKeySalt(); //идентификаторы ключа не совпадут с прежними отпечатками
+    } else if (line.size() == headerLength + 1 + 2 * KEY_SALT_SIZE && line.compare(0, headerLength, MANIFEST_HEADER) == 0
+               && line[headerLength] == ' ') {
+        try {
+            for (size_t i = 0; i < KEY_SALT_SIZE; ++i) {
+                manifest.keySalt[i] = static_cast<uint8_t>(stoi(line.substr(headerLength + 1 + 2 * i, 2), nullptr, 16));
+            }
+        } catch (const exception&) {
+            throw runtime_error("Поврежденный заголовок манифеста: " + filename);
+        }
+    } else {
+        throw runtime_error("Файл не является манифестом: " + filename);
+    }
+    size_t lineNumber = 1;
+    while (getline(file, line)) {
+        ++lineNumber;
+        if (line.empty()) continue;
+        // хеш, ключ, размер, время, путь, результат
+        vector<string> fields;
+        stringstream stream(line);
+        string field;
+        while (getline(stream, field, '\t')) fields.push_back(field);
+        if (fields.size() != 6) {
+            throw runtime_error("Поврежденный манифест " + filename + ", строка " + to_string(lineNumber));
+        }
+        ManifestEntry entry;
+        try {
+            entry.hash = stoull(fields[0], nullptr, 16);
+            entry.keyId = stoull(fields[1], nullptr, 16);
+            entry.size = stoull(fields[2]);
+            entry.mtime = stoll(fields[3]);
+        } catch (const exception&) {
+            throw runtime_error("Поврежденный манифест " + filename + ", строка " + to_string(lineNumber));
+        }
+        entry.path = unescapePath(fields[4]);
+        entry.output = unescapePath(fields[5]);
+        entries.push_back(move(entry));
+    }
+    return manifest;
+}
+
+void saveManifest(const string& filename, const Manifest& manifest) {
+    string temporary = filename + ".tmp";
+    {
+        ofstream file(temporary, ios::trunc);
+        if (!file) throw runtime_error("Не удалось записать манифест: " + temporary);
+        file << MANIFEST_HEADER << " " << hex << setfill('0');
+        for (uint8_t byte : manifest.keySalt) file << setw(2) << static_cast<unsigned>(byte);
+        file << setfill(' ') << "\n";
+        for (const ManifestEntry& entry : manifest.entries) {
+            file << entry.hash << "\t" << entry.keyId << "\t" << dec << entry.size << "\t" << entry.mtime << "\t"
+                 << hex << escapePath(entry.path) << "\t" << escapePath(entry.output) << "\n";
+        }
+        if (!file.flush()) throw runtime_error("Не удалось записать манифест: " + temporary);
+    }
+    if (rename(temporary.c_str(), filename.c_str()) != 0) {
+        throw runtime_error("Не удалось заменить манифест: " + filename);
+    }
+}
+
+IncrementalStats encryptTreeIncremental(const CipherLibs& libs, const ContainerKey& key, const string& inputDir,
+                                        const string& outputDir, const string& manifestPath,
+                                        const ContainerOptions& options) {
+    if (!fs::is_directory(inputDir)) throw runtime_error("Входной каталог не найден: " + inputDir);
+    const string manifestFile = manifestPath.empty() ? (fs::path(outputDir) / ".rgr-manifest").string() : manifestPath;
+    Manifest manifest = loadManifest(manifestFile);
+    unordered_map<string, ManifestEntry> previous;
+    for (ManifestEntry& entry : manifest.entries) previous.emplace(entry.path, move(entry));
+    uint64_t keyId;
+    {
+        array<uint8_t, 16> secret = keyDerivedSecret(key, manifest.keySalt, KEY_ID_PURPOSE);
+        memcpy(&keyId, secret.data(), sizeof(keyId));
+    }
+
+    // Обход дерева; выходной каталог внутри входного пропускается
+    vector<ScannedFile> files;
+    {
+        MetricsScope metrics(MetricCipher::NONE, MetricStage::READ);
+        error_code ec;
+        fs::path outputCanonical = fs::weakly_canonical(outputDir, ec);
+        for (auto it = fs::recursive_directory_iterator(inputDir, fs::directory_options::skip_permission_denied);
+             it != fs::recursive_directory_iterator(); ++it) {
+            if (it->is_directory() && fs::weakly_canonical(it->path(), ec) == outputCanonical) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            if (!it->is_regular_file()) continue;
+            ScannedFile file;
+            file.entry.path = fs::relative(it->path(), inputDir).string();
+            files.push_back(move(file));
+        }
+    }
+
+    // Параллельная сверка с манифестом: stat для всех, хеш - только
+    // для файлов с изменившимися метаданными
+    forEachIndex(options.threads, files.size(), [&](size_t i) {
+        ScannedFile& file = files[i];
+        ManifestEntry& entry = file.entry;
+        const string source = (fs::path(inputDir) / entry.path).string();
+        entry.output = entry.path + OUTPUT_SUFFIX;
+        entry.keyId = keyId;
+        try {
+            if (!statFile(source, entry.size, entry.mtime)) throw runtime_error("Не удалось прочитать " + source);
+            auto old = previous.find(entry.path);
+            if (old == previous.end() || old->second.keyId != keyId || old->second.output != entry.output
+                || !fs::exists(fs::path(outputDir) / entry.output)) {
+                file.state = FileState::CHANGED;
+                return;
+            }
+            if (old->second.size == entry.size && old->second.mtime == entry.mtime) {
+                entry.hash = old->second.hash;
+                file.state = FileState::UNCHANGED;
+                return;
+            }
+            entry.hash = hashFile(source);
+            file.hashed = true;
+            file.state = old->second.size == entry.size && old->second.hash == entry.hash ? FileState::TOUCHED
+                                                                                           : FileState::CHANGED;
+        } catch (const exception& e) {
+            file.state = FileState::FAILED;
+            file.error = e.what();
+        }
+    });
+
+    // Шифрование изменившихся файлов: файлы раздаются потокам по одному,
+    // внутри файла - один поток
+    vector<size_t> changed;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (files[i].state == FileState::CHANGED) changed.push_back(i);
+    }
+    ContainerOptions fileOptions = options;
+    fileOptions.threads = 1;
+    if (!changed.empty()) fileOptions.keyCheck = makeKeyCheck(key); //одна соль на запуск, а не PBKDF2 на файл
+    forEachIndex(options.threads, changed.size(), [&](size_t k) {
+        ScannedFile& file = files[changed[k]];
+        ManifestEntry& entry = file.entry;
+        try {
+            string plaintext = readFileAsBytes((fs::path(inputDir) / entry.path).string());
+            if (!file.hashed) entry.hash = fastHash64(plaintext.data(), plaintext.size());
+            entry.size = plaintext.size(); //манифест описывает зашифрованное содержимое
+            string container;
+            {
+                MetricsScope metrics(metricCipher(key.cipher), MetricStage::ENCRYPT, plaintext.size());
+                container = containerEncrypt(libs, key, plaintext, fileOptions);
+            }
+            writeFileAsBytes((fs::path(outputDir) / entry.output).string(), container);
+        } catch (const exception& e) {
+            file.state = FileState::FAILED;
+            file.error = e.what();
+        }
+    });
+
+    IncrementalStats stats;
+    stats.scanned = files.size();
+    vector<ManifestEntry>& entries = manifest.entries;
+    entries.clear();
+    entries.reserve(files.size());
+    for (ScannedFile& file : files) {
+        switch (file.state) {
+            case FileState::UNCHANGED: ++stats.unchanged; break;
+            case FileState::TOUCHED: ++stats.touched; break;
+            case FileState::CHANGED: ++stats.encrypted; break;
+            case FileState::FAILED:
+                stats.errors.push_back(file.entry.path + ": " + file.error);
+                continue; //не попадает в манифест - повторится при следующем запуске
+        }
+        previous.erase(file.entry.path);
+        entries.push_back(move(file.entry));
+    }
+
+    // Оставшиеся записи - удаленные исходные файлы
+    for (const auto& [path, entry] : previous) {
+        if (fs::exists(fs::path(inputDir) / path)) continue; //файл есть, но не прочитан
+        error_code ec;
+        fs::remove(fs::path(outputDir) / entry.output, ec);
+        ++stats.removed;
+    }
+
+    sort(entries.begin(), entries.end(),
+         [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+    fs::create_directories(fs::path(manifestFile).parent_path().empty() ? fs::path(".")
+                                                                          : fs::path(manifestFile).parent_path());
+    saveManifest(manifestFile, manifest);
+    return stats;
+}
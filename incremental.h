@@ -0,0 +1,53 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "container.h"
+
+// Инкрементальное шифрование дерева каталогов в контейнеры. Манифест хранит
+// для каждого файла размер, время изменения, хеш содержимого, идентификатор
+// ключа и путь результата; перешифровываются только новые и измененные файлы.
+// Файл с прежними размером и временем изменения не читается вовсе, при
+// изменившихся метаданных сначала сравнивается хеш содержимого.
+
+struct ManifestEntry {
+    std::string path;   // относительно входного каталога
+    uint64_t size = 0;
+    int64_t mtime = 0;  // наносекунды
+    uint64_t hash = 0;  // fastHash64 содержимого
+    uint64_t keyId = 0; // секрет ключа с солью манифеста (keyDerivedSecret)
+    std::string output; // относительно выходного каталога
+};
+
+struct Manifest {
+    KeySalt keySalt{}; // соль идентификаторов ключа, постоянная для манифеста
+    std::vector<ManifestEntry> entries;
+};
+
+// Без файла - пустой манифест с новой солью. В манифесте версии 1 ключ
+// записан отпечатком, который больше не считается: все файлы шифруются заново.
+Manifest loadManifest(const std::string& filename);
+
+// Запись через временный файл и переименование: прерванный запуск
+// не оставляет поврежденного манифеста
+void saveManifest(const std::string& filename, const Manifest& manifest);
+
+struct IncrementalStats {
+    size_t scanned = 0;
+    size_t encrypted = 0;
+    size_t unchanged = 0;
+    size_t touched = 0; // изменились только метаданные, содержимое то же
+    size_t removed = 0; // исходный файл удален - удален и результат
+    std::vector<std::string> errors;
+};
+
+// Шифрование inputDir в outputDir (файл -> файл.rgr). Манифест по
+// умолчанию - outputDir/.rgr-manifest. options.threads - потоки обхода и
+// шифрования (файлы обрабатываются параллельно, каждый в одном потоке).
+IncrementalStats encryptTreeIncremental(const CipherLibs& libs, const ContainerKey& key, const std::string& inputDir,
+                                        const std::string& outputDir, const std::string& manifestPath,
+                                        const ContainerOptions& options);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef KERNEL_TABLE_H
+#define KERNEL_TABLE_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Выбор реализации ядра шифра по размеру входа. Библиотека регистрирует
+// доступные на этом процессоре варианты; по умолчанию для всех размеров
+// берется последний (самый широкий набор команд), программа может заменить
+// выбор для отдельной корзины размеров (автоподбор, --kernels).
+// Заголовочный, чтобы им пользовались и программа, и библиотеки шифров.
+
+// Корзины размера входа: до 256 байтов, до 16 КиБ, до 1 МиБ, больше
+const size_t KERNEL_BUCKETS = 4;
+
+inline size_t kernelBucket(size_t size) {
+    if (size <= 256) return 0;
+    if (size <= (16 << 10)) return 1;
+    if (size <= (1 << 20)) return 2;
+    return 3;
+}
+
+// Характерный размер корзины, на котором автоподбор сравнивает варианты
+inline size_t kernelBucketSample(size_t bucket) {
+    static const size_t samples[KERNEL_BUCKETS] = {128, 8 << 10, 256 << 10, 4 << 20};
+    return samples[bucket];
+}
+
+template <typename Func>
+class KernelTable {
+public:
+    struct Variant {
+        const char* name;
+        Func func;
+        bool available;
+    };
+
+    explicit KernelTable(std::initializer_list<Variant> variants) {
+        for (const Variant& variant : variants) {
+            if (variant.available) variants_.push_back(variant);
+        }
+        for (size_t b = 0; b < KERNEL_BUCKETS; ++b) chosen_[b] = variants_.back().func;
+    }
+
+    // Выбор меняется только при запуске, до начала обработки
+    Func get(size_t size) const { return chosen_[kernelBucket(size)]; }
+
+    std::vector<std::string> names() const {
+        std::vector<std::string> result;
+        for (const Variant& variant : variants_) result.push_back(variant.name);
+        return result;
+    }
+
+    // false - варианта нет на этом процессоре или корзина вне диапазона
+    bool select(size_t bucket, const std::string& name) {
+        if (bucket >= KERNEL_BUCKETS) return false;
+        for (const Variant& variant : variants_) {
+            if (name == variant.name) {
+                chosen_[bucket] = variant.func;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<Variant> variants_; //первый вариант (скалярный) доступен всегда
+    Func chosen_[KERNEL_BUCKETS];
+};
+
+#endif // KERNEL_TABLE_H
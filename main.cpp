@@ -3,13 +3,19 @@
 #include <limits>
 #include <string>
 #include <cstdlib>
-#include <dlfcn.h>
+#include <cstring>
 #include <filesystem>
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
 #include <cctype>
 #include "file.h"
+#include "metrics.h"
+#include "cipher_libs.h"
+#include "commands.h"
+#include "autotune.h"
+#include "trace.h"
+#include "planner.h"
 #include <fstream>
 #include <locale.h>
 #include <vector>
@@ -19,25 +25,6 @@
 using namespace std;
 namespace fs = std::filesystem;
 
-// Создание безопасных указателей на функции из динамических библиотек
-typedef string (*hillEncryptFunc)(const string&, const vector<vector<int>>&);
-typedef string (*hillDecryptFunc)(const string&, const vector<vector<int>>&);
-typedef vector<vector<int>> (*generateHillKeyFunc)(size_t);
-typedef void (*saveHillKeyFunc)(const vector<vector<int>>&, const string&);
-typedef vector<vector<int>> (*loadHillKeyFunc)(const string&);
-
-typedef string (*richelieuEncryptFunc)(const string&, const string&);
-typedef string (*richelieuDecryptFunc)(const string&, const string&);
-typedef string (*generateRichelieuKeyFunc)(int);
-typedef void (*saveRichelieuKeyFunc)(const string&, const string&);
-typedef string (*loadRichelieuKeyFunc)(const string&);
-
-typedef string (*vigenereEncryptFunc)(const string&, const string&);
-typedef string (*vigenereDecryptFunc)(const string&, const string&);
-typedef string (*generateVigenereKeyFunc)(int);
-typedef void (*saveVigenereKeyFunc)(const string&, const string&);
-typedef string (*loadVigenereKeyFunc)(const string&);
-
 enum class Cipher {
     HILL,
     RICHELIEU,
@@ -76,84 +63,137 @@ optional<DataSource> selectDataSource() { //интерфейс выбора ис
     }
 }
 
-int main() {
-    setlocale(LC_ALL, "ru_RU.UTF-8");
+// Вызов функции шифра с учетом в метриках
+template <typename Func>
+auto measured(MetricCipher cipher, MetricStage stage, uint64_t bytes, Func&& func) {
+    MetricsScope metrics(cipher, stage, bytes);
+    return func();
+}
+
+// Параметры командной строки
+struct Options {
+    optional<MetricsFormat> metricsFormat;
+    string metricsOut;
+    FileBackend fileBackend = FileBackend::STREAM;
+    bool profile = false;   // счетчики производительности в метриках и bench
+    string kernels = "auto"; // выбор ядер шифров (см. autotune.h)
+    string traceOut;        // временная шкала этапов (только в сборке с RGR_TRACE)
+    string memoryBudget = "auto"; // бюджет памяти планировщика (см. planner.h)
+    bool plan = false;      // печать выбранного плана выполнения
+    vector<string> command; // команда пакетного режима и ее параметры
+};
+
+void printUsage(const char* program) {
+    cerr << "Использование: " << program
+         << " [--metrics=json|prometheus] [--metrics-out=ФАЙЛ] [--io=stream|uring] [--profile]"
+         << " [--kernels=auto|retune|cpu|СЕМЕЙСТВО=ВАРИАНТ,...] [--trace=ФАЙЛ]"
+         << " [--memory-budget=auto|РАЗМЕР[K|M|G]|N%] [--plan] [команда параметры...]" << endl;
+    cerr << "Без команды запускается интерактивное меню." << endl;
+    printCommandsUsage(cerr);
+}
 
-    // Загрузка библиотек
-    void* hillLib = dlopen("./libhill.so", RTLD_LAZY);
-    void* richelieuLib = dlopen("./librichelieu.so", RTLD_LAZY);
-    void* vigenereLib = dlopen("./libvigenere.so", RTLD_LAZY);
-
-    // Инициализация указателей на функции
-    hillEncryptFunc hillEncrypt = nullptr;
-    hillDecryptFunc hillDecrypt = nullptr;
-    generateHillKeyFunc generateHillKey = nullptr;
-    saveHillKeyFunc saveHillKey = nullptr;
-    loadHillKeyFunc loadHillKey = nullptr;
-
-    richelieuEncryptFunc richelieuEncrypt = nullptr;
-    richelieuDecryptFunc richelieuDecrypt = nullptr;
-    generateRichelieuKeyFunc generateRichelieuKey = nullptr;
-    saveRichelieuKeyFunc saveRichelieuKey = nullptr;
-    loadRichelieuKeyFunc loadRichelieuKey = nullptr;
-
-    vigenereEncryptFunc vigenereEncrypt = nullptr;
-    vigenereDecryptFunc vigenereDecrypt = nullptr;
-    generateVigenereKeyFunc generateVigenereKey = nullptr;
-    saveVigenereKeyFunc saveVigenereKey = nullptr;
-    loadVigenereKeyFunc loadVigenereKey = nullptr;
-
-    // Загрузка функций Hill
-    if (hillLib) { //далее получение указателя на функцию по имени
-        hillEncrypt = (hillEncryptFunc)dlsym(hillLib, "hillEncrypt");
-        hillDecrypt = (hillDecryptFunc)dlsym(hillLib, "hillDecrypt");
-        generateHillKey = (generateHillKeyFunc)dlsym(hillLib, "generateHillKey");
-        saveHillKey = (saveHillKeyFunc)dlsym(hillLib, "saveHillKey");
-        loadHillKey = (loadHillKeyFunc)dlsym(hillLib, "loadHillKey");
-
-        if (!hillEncrypt || !hillDecrypt || !generateHillKey || !saveHillKey || !loadHillKey) {
-            cerr << "Ошибка: При загрузке функций Hill: " << dlerror() << endl;
-            dlclose(hillLib); //выгрузка библиотеки
-            hillLib = nullptr; //библиотека недоступна 
+// Разбор общих параметров (до имени команды)
+bool parseOptions(int argc, char* argv[], Options& options) {
+    int i = 1;
+    for (; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) break; //начало команды
+        if (arg == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else if (arg == "--metrics=json") {
+            options.metricsFormat = MetricsFormat::JSON;
+        } else if (arg == "--metrics=prometheus") {
+            options.metricsFormat = MetricsFormat::PROMETHEUS;
+        } else if (arg.rfind("--metrics-out=", 0) == 0) {
+            options.metricsOut = arg.substr(strlen("--metrics-out="));
+        } else if (arg == "--io=stream") {
+            options.fileBackend = FileBackend::STREAM;
+        } else if (arg == "--io=uring") {
+            options.fileBackend = FileBackend::URING;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg.rfind("--kernels=", 0) == 0) {
+            options.kernels = arg.substr(strlen("--kernels="));
+        } else if (arg.rfind("--trace=", 0) == 0) {
+            options.traceOut = arg.substr(strlen("--trace="));
+        } else if (arg.rfind("--memory-budget=", 0) == 0) {
+            options.memoryBudget = arg.substr(strlen("--memory-budget="));
+        } else if (arg == "--plan") {
+            options.plan = true;
+        } else {
+            cerr << "Ошибка: неизвестный параметр: " << arg << endl;
+            printUsage(argv[0]);
+            return false;
         }
     }
+    options.command.assign(argv + i, argv + argc);
 
-    // Загрузка функций Richelieu
-    if (richelieuLib) {
-        richelieuEncrypt = (richelieuEncryptFunc)dlsym(richelieuLib, "richelieuEncrypt");
-        richelieuDecrypt = (richelieuDecryptFunc)dlsym(richelieuLib, "richelieuDecrypt");
-        generateRichelieuKey = (generateRichelieuKeyFunc)dlsym(richelieuLib, "generateRichelieuKey");
-        saveRichelieuKey = (saveRichelieuKeyFunc)dlsym(richelieuLib, "saveRichelieuKey");
-        loadRichelieuKey = (loadRichelieuKeyFunc)dlsym(richelieuLib, "loadRichelieuKey");
-
-        if (!richelieuEncrypt || !richelieuDecrypt || !generateRichelieuKey || !saveRichelieuKey || !loadRichelieuKey) {
-            cerr << "Ошибка: При загрузке функций Richelieu: " << dlerror() << endl;
-            dlclose(richelieuLib);
-            richelieuLib = nullptr;
-        }
+    if (!options.metricsFormat && !options.metricsOut.empty()) {
+        cerr << "Ошибка: --metrics-out требует --metrics" << endl;
+        return false;
+    }
+#ifndef RGR_TRACE
+    if (!options.traceOut.empty()) {
+        cerr << "Ошибка: программа собрана без трассировки (пересоберите: make clean && make TRACE=1)" << endl;
+        return false;
     }
+#endif
+    return true;
+}
 
-    // Загрузка функций Vigenere
-    if (vigenereLib) {
-        vigenereEncrypt = (vigenereEncryptFunc)dlsym(vigenereLib, "vigenereEncrypt");
-        vigenereDecrypt = (vigenereDecryptFunc)dlsym(vigenereLib, "vigenereDecrypt");
-        generateVigenereKey = (generateVigenereKeyFunc)dlsym(vigenereLib, "generateVigenereKey");
-        saveVigenereKey = (saveVigenereKeyFunc)dlsym(vigenereLib, "saveVigenereKey");
-        loadVigenereKey = (loadVigenereKeyFunc)dlsym(vigenereLib, "loadVigenereKey");
-
-        if (!vigenereEncrypt || !vigenereDecrypt || !generateVigenereKey || !saveVigenereKey || !loadVigenereKey) {
-            cerr << "Ошибка: При загрузке функций Vigenere: " << dlerror() << endl;
-            dlclose(vigenereLib);
-            vigenereLib = nullptr;
+int main(int argc, char* argv[]) {
+    setlocale(LC_ALL, "ru_RU.UTF-8");
+
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 1;
+    // Счетчики открываются до создания потоков, чтобы потоки их унаследовали
+    if (options.profile) {
+        string reason;
+        if (!perfEnable(reason)) {
+            cerr << "Предупреждение: счетчики производительности недоступны (" << reason
+                 << "), профиль содержит только время" << endl;
+        } else if (!reason.empty()) {
+            cerr << "Предупреждение: часть счетчиков недоступна (" << reason << ")" << endl;
         }
     }
+    if (options.metricsFormat) {
+        metricsEnable(*options.metricsFormat, options.metricsOut);
+    }
+#ifdef RGR_TRACE
+    if (!options.traceOut.empty()) traceEnable(options.traceOut);
+#endif
+    setFileBackend(options.fileBackend);
+    try {
+        setMemoryBudget(options.memoryBudget);
+    } catch (const invalid_argument& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        return 1;
+    }
+    setPlanReport(options.plan);
+
+    CipherLibs libs = loadCipherLibs();
+    try {
+        setupKernels(libs, options.kernels);
+    } catch (const invalid_argument& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        unloadCipherLibs(libs);
+        return 1;
+    }
+
+    // Пакетный режим: выполнение команды без меню
+    if (!options.command.empty()) {
+        int code = runCommand(options.command, libs);
+        unloadCipherLibs(libs);
+        return code;
+    }
 
     while (true) {
         try {
             cout << "\n==МЕНЮ ШИФРОВАНИЯ/ДЕШИФРОВАНИЯ==\n";
-            cout << "1. Шифр Хилла" << (hillLib ? "" : " (недоступно)") << "\n";
-            cout << "2. Шифр Ришелье" << (richelieuLib ? "" : " (недоступно)") << "\n";
-            cout << "3. Шифр Виженера" << (vigenereLib ? "" : " (недоступно)") << "\n";
+            cout << "1. Шифр Хилла" << (libs.hillLib ? "" : " (недоступно)") << "\n";
+            cout << "2. Шифр Ришелье" << (libs.richelieuLib ? "" : " (недоступно)") << "\n";
+            cout << "3. Шифр Виженера" << (libs.vigenereLib ? "" : " (недоступно)") << "\n";
             cout << "4. Выход\n";
             cout << "Выберите алгоритм (либо выход): ";
 
@@ -180,12 +220,13 @@ int main() {
                 cout << "Ошибка: Неизвестный алгоритм. Попробуйте снова.\n";
                 continue;
             }
+            prepareKernels(libs);
 
             while (true) {
                 try {
                     switch (cipherChoice) {
                         case Cipher::HILL: {
-                            if (!hillLib) {
+                            if (!libs.hillLib) {
                                 cout << "Ошибка: Библиотека Hill не загружена!\n";
                                 break;
                             }
@@ -235,8 +276,9 @@ int main() {
                                         }
 
                                         try {
-                                            vector<vector<int>> key = generateHillKey(2);
-                                            saveHillKey(key, keyFile);
+                                            MetricsScope metrics(MetricCipher::HILL, MetricStage::KEY_GENERATE);
+                                            vector<vector<int>> key = libs.generateHillKey(2);
+                                            libs.saveHillKey(key, keyFile);
                                             cout << "Ключ сгенерирован и сохранен в " << keyFile << endl;
                                         } catch (const exception& e) {
                                             cerr << "Ошибка: " << e.what() << endl;
@@ -304,12 +346,16 @@ int main() {
                                     try {
                                         string result;
                                         if (isEncrypt) {
-                                            vector<vector<int>> key = loadHillKey(keyFile);
-                                            result = hillEncrypt(content, key);
+                                            vector<vector<int>> key = measured(MetricCipher::HILL, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadHillKey(keyFile); });
+                                            result = measured(MetricCipher::HILL, MetricStage::ENCRYPT, content.size(),
+                                                [&] { return libs.hillEncrypt(content, key); });
                                             cout << "Данные зашифрованы. Размер: " << result.size() << " байт\n";
                                         } else {
-                                            vector<vector<int>> key = loadHillKey(keyFile);
-                                            result = hillDecrypt(content, key);
+                                            vector<vector<int>> key = measured(MetricCipher::HILL, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadHillKey(keyFile); });
+                                            result = measured(MetricCipher::HILL, MetricStage::DECRYPT, content.size(),
+                                                [&] { return libs.hillDecrypt(content, key); });
                                             cout << "Данные расшифрованы. Размер: " << result.size() << " байт\n";
                                         }
                                         writeFileAsBytes(outputFile, result);
@@ -326,7 +372,7 @@ int main() {
                             break;
                         }
                         case Cipher::RICHELIEU: {
-                            if (!richelieuLib) {
+                            if (!libs.richelieuLib) {
                                 cout << "Ошибка: Библиотека Richelieu не загружена!\n";
                                 break;
                             }
@@ -393,8 +439,9 @@ int main() {
                                         }
 
                                         try {
-                                            string key = generateRichelieuKey(blockSize);
-                                            saveRichelieuKey(key, keyFile);
+                                            MetricsScope metrics(MetricCipher::RICHELIEU, MetricStage::KEY_GENERATE);
+                                            string key = libs.generateRichelieuKey(blockSize);
+                                            libs.saveRichelieuKey(key, keyFile);
                                             cout << "Ключ сгенерирован и сохранен в " << keyFile << endl;
                                         } catch (const exception& e) {
                                             cerr << "Ошибка: " << e.what() << endl;
@@ -420,11 +467,13 @@ int main() {
                                     auto source = selectDataSource();
                                     if (!source) continue;
 
+                                    // Файл не читается в память: он проходится порциями, символ и
+                                    // блок на границе порции переносятся в следующую
                                     string content;
+                                    string inputFile;
                                     if (*source == DataSource::CONSOLE) {
                                         content = readFromConsole();
                                     } else {
-                                        string inputFile;
                                         bool inputFileValid = false;
                                         while (!inputFileValid) {
                                             cout << "Введите путь к входному файлу: ";
@@ -437,7 +486,6 @@ int main() {
                                             
                                             inputFileValid = true;
                                         }
-                                        content = readFileAsBytes(inputFile);
                                     }
 
                                     string outputFile;
@@ -460,14 +508,34 @@ int main() {
                                     }
 
                                     try {
+                                        if (!inputFile.empty()) {
+                                            string key = measured(MetricCipher::RICHELIEU, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadRichelieuKey(keyFile); });
+                                            {
+                                                MetricsScope metrics(MetricCipher::RICHELIEU,
+                                                                     isEncrypt ? MetricStage::ENCRYPT : MetricStage::DECRYPT,
+                                                                     fs::file_size(inputFile));
+                                                if (isEncrypt) libs.richelieuEncryptFile(inputFile, outputFile, key);
+                                                else libs.richelieuDecryptFile(inputFile, outputFile, key);
+                                            }
+                                            cout << (isEncrypt ? "Данные зашифрованы" : "Данные расшифрованы")
+                                                 << ". Размер: " << fs::file_size(outputFile) << " байт\n";
+                                            cout << "Результат сохранен в " << outputFile << endl;
+                                            continue;
+                                        }
+
                                         string result;
                                         if (isEncrypt) {
-                                            string key = loadRichelieuKey(keyFile);
-                                            result = richelieuEncrypt(content, key);
+                                            string key = measured(MetricCipher::RICHELIEU, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadRichelieuKey(keyFile); });
+                                            result = measured(MetricCipher::RICHELIEU, MetricStage::ENCRYPT, content.size(),
+                                                [&] { return libs.richelieuEncrypt(content, key); });
                                             cout << "Данные зашифрованы. Размер: " << result.size() << " байт\n";
                                         } else {
-                                            string key = loadRichelieuKey(keyFile);
-                                            result = richelieuDecrypt(content, key);
+                                            string key = measured(MetricCipher::RICHELIEU, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadRichelieuKey(keyFile); });
+                                            result = measured(MetricCipher::RICHELIEU, MetricStage::DECRYPT, content.size(),
+                                                [&] { return libs.richelieuDecrypt(content, key); });
                                             cout << "Данные расшифрованы. Размер: " << result.size() << " байт\n";
                                         }
                                         writeFileAsBytes(outputFile, result);
@@ -484,7 +552,7 @@ int main() {
                             break;
                         }
                         case Cipher::VIGENERE: {
-                            if (!vigenereLib) {
+                            if (!libs.vigenereLib) {
                                 cout << "Ошибка: Библиотека Vigenere не загружена!\n";
                                 break;
                             }
@@ -517,7 +585,7 @@ int main() {
                                         // Шифрование - генерируем ключ
                                         int length;
                                         while (true) {
-                                            cout << "Введите длину ключа: ";
+                                            cout << "Введите длину ключа (0 - ключ-зерно для гаммы): ";
                                             if (!(cin >> length)) {
                                                 cin.clear();
                                                 cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -525,8 +593,8 @@ int main() {
                                                 continue;
                                             }
                                             cin.ignore();
-                                            if (length <= 0) {
-                                                cout << "Ошибка: Длина ключа должна быть положительной\n";
+                                            if (length < 0) {
+                                                cout << "Ошибка: Длина ключа не может быть отрицательной\n";
                                                 continue;
                                             }
                                             break;
@@ -551,8 +619,10 @@ int main() {
                                         }
 
                                         try {
-                                            string key = generateVigenereKey(length);
-                                            saveVigenereKey(key, keyFile);
+                                            MetricsScope metrics(MetricCipher::VIGENERE, MetricStage::KEY_GENERATE);
+                                            string key = length > 0 ? libs.generateVigenereKey(length)
+                                                                    : libs.generateVigenereSeedKey();
+                                            libs.saveVigenereKey(key, keyFile);
                                             cout << "Ключ сгенерирован и сохранен в " << keyFile << endl;
                                         } catch (const exception& e) {
                                             cerr << "Ошибка: " << e.what() << endl;
@@ -578,11 +648,12 @@ int main() {
                                     auto source = selectDataSource();
                                     if (!source) continue;
 
+                                    // Файл не читается в память: данные и ключ проходятся потоком
                                     string content;
+                                    string inputFile;
                                     if (*source == DataSource::CONSOLE) {
                                         content = readFromConsole();
                                     } else {
-                                        string inputFile;
                                         bool inputFileValid = false;
                                         while (!inputFileValid) {
                                             cout << "Введите путь к входному файлу: ";
@@ -595,7 +666,6 @@ int main() {
                                             
                                             inputFileValid = true;
                                         }
-                                        content = readFileAsBytes(inputFile);
                                     }
 
                                     string outputFile;
@@ -618,14 +688,30 @@ int main() {
                                     }
 
                                     try {
+                                        if (!inputFile.empty()) {
+                                            uint64_t size = fs::file_size(inputFile);
+                                            MetricsScope metrics(MetricCipher::VIGENERE,
+                                                                 isEncrypt ? MetricStage::ENCRYPT : MetricStage::DECRYPT, size);
+                                            if (isEncrypt) libs.vigenereEncryptFileKeyFile(inputFile, outputFile, keyFile);
+                                            else libs.vigenereDecryptFileKeyFile(inputFile, outputFile, keyFile);
+                                            cout << (isEncrypt ? "Данные зашифрованы" : "Данные расшифрованы")
+                                                 << ". Размер: " << size << " байт\n";
+                                            cout << "Результат сохранен в " << outputFile << endl;
+                                            continue;
+                                        }
+
                                         string result;
                                         if (isEncrypt) {
-                                            string key = loadVigenereKey(keyFile);
-                                            result = vigenereEncrypt(content, key);
+                                            string key = measured(MetricCipher::VIGENERE, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadVigenereKey(keyFile); });
+                                            result = measured(MetricCipher::VIGENERE, MetricStage::ENCRYPT, content.size(),
+                                                [&] { return libs.vigenereEncrypt(content, key); });
                                             cout << "Данные зашифрованы. Размер: " << result.size() << " байт\n";
                                         } else {
-                                            string key = loadVigenereKey(keyFile);
-                                            result = vigenereDecrypt(content, key);
+                                            string key = measured(MetricCipher::VIGENERE, MetricStage::KEY_LOAD, 0,
+                                                [&] { return libs.loadVigenereKey(keyFile); });
+                                            result = measured(MetricCipher::VIGENERE, MetricStage::DECRYPT, content.size(),
+                                                [&] { return libs.vigenereDecrypt(content, key); });
                                             cout << "Данные расшифрованы. Размер: " << result.size() << " байт\n";
                                         }
                                         writeFileAsBytes(outputFile, result);
@@ -658,9 +744,7 @@ int main() {
         }
     }
 
-    if (hillLib) dlclose(hillLib);
-    if (richelieuLib) dlclose(richelieuLib);
-    if (vigenereLib) dlclose(vigenereLib);
+    unloadCipherLibs(libs);
 
     return 0;
 }
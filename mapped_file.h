@@ -0,0 +1,97 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Отображение файла (или его части) в память только для чтения.
+// Заголовочный, чтобы им пользовались и программа, и библиотеки шифров.
+class MappedFile {
+public:
+    // Весь файл
+    explicit MappedFile(const std::string& filename) {
+        map(filename, 0, UINT64_MAX);
+    }
+
+    // Только страницы, покрывающие [offset, offset + length) (обрезается по концу файла)
+    MappedFile(const std::string& filename, uint64_t offset, uint64_t length) {
+        map(filename, offset, length);
+    }
+
+    ~MappedFile() {
+        if (mapping_) munmap(mapping_, mappingSize_);
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    uint64_t fileSize() const { return fileSize_; }
+
+    // Освобождение страниц, покрывающих [offset, offset + length) от data():
+    // уже пройденные при потоковой обработке данные не занимают память
+    // (отображение только для чтения, при повторном обращении страница
+    // снова читается из кэша)
+    void release(size_t offset, size_t length) const {
+        if (!mapping_ || offset >= size_) return;
+        uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t begin = reinterpret_cast<uintptr_t>(data_ + offset);
+        uintptr_t end = reinterpret_cast<uintptr_t>(data_ + std::min(size_, offset + length));
+        begin = begin / page * page;
+        if (end != reinterpret_cast<uintptr_t>(data_ + size_)) end = end / page * page; //конец файла - до конца страницы
+        else end = (end + page - 1) / page * page;
+        if (begin < end) madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    void map(const std::string& filename, uint64_t offset, uint64_t length) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Ошибка: файл не существует или недоступен: " + filename);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Ошибка: не удалось получить размер файла: " + filename);
+        }
+        fileSize_ = static_cast<uint64_t>(st.st_size);
+
+        uint64_t begin = offset < fileSize_ ? offset : fileSize_;
+        uint64_t end = length < fileSize_ - begin ? begin + length : fileSize_;
+        size_ = static_cast<size_t>(end - begin);
+        if (size_ == 0) { //пустой диапазон не отображается
+            close(fd);
+            return;
+        }
+
+        // Смещение отображения должно быть кратно размеру страницы
+        uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        uint64_t pageStart = begin / page * page;
+        mappingSize_ = static_cast<size_t>(end - pageStart);
+        void* mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(pageStart));
+        close(fd); //отображение остается действительным после закрытия
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Ошибка: не удалось отобразить файл в память: " + filename);
+        }
+        madvise(mapping, mappingSize_, MADV_SEQUENTIAL);
+        mapping_ = mapping;
+        data_ = static_cast<const char*>(mapping) + (begin - pageStart);
+    }
+
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    uint64_t fileSize_ = 0;
+};
+
+#endif // MAPPED_FILE_H
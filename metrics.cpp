@@ -0,0 +1,329 @@
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <csignal>
+#include <pthread.h>
+
+using namespace std;
+
+namespace {
+
+const size_t CIPHERS = static_cast<size_t>(MetricCipher::COUNT);
+const size_t STAGES = static_cast<size_t>(MetricStage::COUNT);
+// Корзина b хранит длительности из [2^(b-1), 2^b) наносекунд
+const size_t BUCKETS = 40;
+
+const char* CIPHER_NAMES[CIPHERS] = {"none", "hill", "richelieu", "vigenere"};
+const char* STAGE_NAMES[STAGES] = {"read", "write", "key_generate", "key_load", "encrypt", "decrypt"};
+
+struct Snapshot {
+    uint64_t ops[CIPHERS][STAGES] = {};
+    uint64_t bytes[CIPHERS][STAGES] = {};
+    uint64_t nanos[CIPHERS][STAGES] = {};
+    uint64_t histogram[CIPHERS][STAGES][BUCKETS] = {};
+    uint64_t counters[CIPHERS][STAGES][PERF_EVENTS] = {};
+};
+
+// Счетчики одного потока. Пишет только владелец, читают все при сводке.
+struct ThreadMetrics {
+    atomic<uint64_t> ops[CIPHERS][STAGES];
+    atomic<uint64_t> bytes[CIPHERS][STAGES];
+    atomic<uint64_t> nanos[CIPHERS][STAGES];
+    atomic<uint64_t> histogram[CIPHERS][STAGES][BUCKETS];
+    atomic<uint64_t> counters[CIPHERS][STAGES][PERF_EVENTS];
+};
+
+// Блоки работающих потоков и сумма счетчиков завершившихся: при выходе из
+// потока его блок прибавляется к g_retired и освобождается, поэтому память
+// не растет с числом созданных за время работы потоков
+mutex g_threadsMutex;
+vector<ThreadMetrics*> g_live;
+Snapshot g_retired;
+
+atomic<bool> g_enabled{false};
+MetricsFormat g_format = MetricsFormat::JSON;
+string g_outputPath;
+
+// Выгрузки по SIGUSR1 и при выходе идут из разных потоков; после выгрузки
+// при выходе поток сигнала больше ничего не пишет (g_outputPath и потоки
+// вывода уже могут быть разрушены)
+mutex g_dumpMutex;
+bool g_exited = false;
+
+void addTo(Snapshot& s, const ThreadMetrics& m) {
+    for (size_t c = 0; c < CIPHERS; ++c) {
+        for (size_t st = 0; st < STAGES; ++st) {
+            s.ops[c][st] += m.ops[c][st].load(memory_order_relaxed);
+            s.bytes[c][st] += m.bytes[c][st].load(memory_order_relaxed);
+            s.nanos[c][st] += m.nanos[c][st].load(memory_order_relaxed);
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                s.histogram[c][st][b] += m.histogram[c][st][b].load(memory_order_relaxed);
+            }
+            for (size_t e = 0; e < PERF_EVENTS; ++e) {
+                s.counters[c][st][e] += m.counters[c][st][e].load(memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// Владелец блока потока: регистрирует блок при первом замере и сливает его
+// в g_retired при завершении потока (для главного - при выходе, до выгрузки
+// из atexit)
+struct LocalMetrics {
+    ThreadMetrics* block = nullptr;
+
+    ~LocalMetrics() {
+        if (!block) return;
+        lock_guard<mutex> lock(g_threadsMutex);
+        addTo(g_retired, *block);
+        g_live.erase(find(g_live.begin(), g_live.end(), block));
+        delete block;
+    }
+};
+
+ThreadMetrics& localMetrics() {
+    thread_local LocalMetrics local;
+    if (!local.block) {
+        unique_ptr<ThreadMetrics> block(new ThreadMetrics()); //нулевая инициализация
+        lock_guard<mutex> lock(g_threadsMutex);
+        g_live.push_back(block.get());
+        local.block = block.release();
+    }
+    return *local.block;
+}
+
+// Прибавление без атомарного RMW: у счетчика единственный писатель
+inline void bump(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+size_t bucketFor(uint64_t nanos) {
+    size_t bucket = nanos == 0 ? 0 : 64 - __builtin_clzll(nanos);
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+// Слияние счетчиков всех потоков
+Snapshot collect() {
+    lock_guard<mutex> lock(g_threadsMutex);
+    Snapshot s = g_retired;
+    for (ThreadMetrics* m : g_live) addTo(s, *m);
+    return s;
+}
+
+// Счетчики производительности операции и производные величины: IPC и
+// промахи на байт (только для доступных событий)
+void countersToJson(ostream& out, const uint64_t* counters, uint64_t bytes) {
+    out << ",\"counters\":{";
+    bool first = true;
+    for (size_t e = 0; e < PERF_EVENTS; ++e) {
+        PerfEvent event = static_cast<PerfEvent>(e);
+        if (!perfAvailable(event)) continue;
+        if (!first) out << ",";
+        first = false;
+        out << "\"" << perfEventName(event) << "\":" << counters[e];
+    }
+    auto value = [&](PerfEvent event) { return static_cast<double>(counters[static_cast<size_t>(event)]); };
+    if (perfAvailable(PerfEvent::CYCLES) && perfAvailable(PerfEvent::INSTRUCTIONS) && value(PerfEvent::CYCLES) > 0) {
+        out << ",\"ipc\":" << value(PerfEvent::INSTRUCTIONS) / value(PerfEvent::CYCLES);
+    }
+    if (bytes > 0) {
+        if (perfAvailable(PerfEvent::CACHE_MISSES)) {
+            out << ",\"cache_misses_per_byte\":" << value(PerfEvent::CACHE_MISSES) / bytes;
+        }
+        if (perfAvailable(PerfEvent::BRANCH_MISSES)) {
+            out << ",\"branch_misses_per_byte\":" << value(PerfEvent::BRANCH_MISSES) / bytes;
+        }
+    }
+    out << "}";
+}
+
+// Верхняя граница корзины в секундах
+double bucketBound(size_t bucket) {
+    return static_cast<double>(1ULL << bucket) / 1e9;
+}
+
+void dumpLocked() {
+    string text = g_format == MetricsFormat::JSON ? metricsToJson() : metricsToPrometheus();
+    if (g_outputPath.empty()) {
+        cerr << text << flush;
+        return;
+    }
+    ofstream file(g_outputPath, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << "Ошибка: не удалось записать метрики в " << g_outputPath << endl;
+        return;
+    }
+    file << text;
+}
+
+void dumpAtExit() {
+    lock_guard<mutex> lock(g_dumpMutex);
+    dumpLocked();
+    g_exited = true;
+}
+
+// Отдельный поток ждет SIGUSR1 синхронно, поэтому выгрузка
+// выполняется вне обработчика сигнала
+void signalLoop(sigset_t set) {
+    while (true) {
+        int sig = 0;
+        if (sigwait(&set, &sig) == 0 && sig == SIGUSR1) {
+            metricsDump();
+        }
+    }
+}
+
+} // namespace
+
+void metricsRecord(MetricCipher cipher, MetricStage stage, uint64_t bytes, uint64_t nanos,
+                   const PerfCounts* counters) {
+    size_t c = static_cast<size_t>(cipher);
+    size_t st = static_cast<size_t>(stage);
+    if (c >= CIPHERS || st >= STAGES) return;
+
+    ThreadMetrics& m = localMetrics();
+    bump(m.ops[c][st], 1);
+    bump(m.bytes[c][st], bytes);
+    bump(m.nanos[c][st], nanos);
+    bump(m.histogram[c][st][bucketFor(nanos)], 1);
+    if (counters) {
+        for (size_t e = 0; e < PERF_EVENTS; ++e) bump(m.counters[c][st][e], counters->values[e]);
+    }
+}
+
+const char* metricCipherName(MetricCipher cipher) {
+    size_t c = static_cast<size_t>(cipher);
+    return c < CIPHERS ? CIPHER_NAMES[c] : "unknown";
+}
+
+const char* metricStageName(MetricStage stage) {
+    size_t st = static_cast<size_t>(stage);
+    return st < STAGES ? STAGE_NAMES[st] : "unknown";
+}
+
+string metricsToJson() {
+    Snapshot s = collect();
+    ostringstream out;
+    out << "{\"metrics\":[";
+    bool first = true;
+    for (size_t c = 0; c < CIPHERS; ++c) {
+        for (size_t st = 0; st < STAGES; ++st) {
+            if (s.ops[c][st] == 0) continue;
+            if (!first) out << ",";
+            first = false;
+            out << "{\"cipher\":\"" << CIPHER_NAMES[c] << "\",\"stage\":\"" << STAGE_NAMES[st]
+                << "\",\"operations\":" << s.ops[c][st]
+                << ",\"bytes\":" << s.bytes[c][st]
+                << ",\"seconds\":" << setprecision(9) << s.nanos[c][st] / 1e9;
+            if (perfEnabled()) countersToJson(out, s.counters[c][st], s.bytes[c][st]);
+            out << ",\"histogram\":[";
+            bool firstBucket = true;
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                if (s.histogram[c][st][b] == 0) continue;
+                if (!firstBucket) out << ",";
+                firstBucket = false;
+                out << "{\"le_seconds\":" << bucketBound(b)
+                    << ",\"count\":" << s.histogram[c][st][b] << "}";
+            }
+            out << "]}";
+        }
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+string metricsToPrometheus() {
+    Snapshot s = collect();
+    ostringstream out;
+    out << setprecision(9);
+
+    out << "# HELP rgr_operations_total Number of operations per cipher and stage.\n";
+    out << "# TYPE rgr_operations_total counter\n";
+    for (size_t c = 0; c < CIPHERS; ++c) {
+        for (size_t st = 0; st < STAGES; ++st) {
+            if (s.ops[c][st] == 0) continue;
+            out << "rgr_operations_total{cipher=\"" << CIPHER_NAMES[c] << "\",stage=\""
+                << STAGE_NAMES[st] << "\"} " << s.ops[c][st] << "\n";
+        }
+    }
+
+    out << "# HELP rgr_bytes_total Bytes processed per cipher and stage.\n";
+    out << "# TYPE rgr_bytes_total counter\n";
+    for (size_t c = 0; c < CIPHERS; ++c) {
+        for (size_t st = 0; st < STAGES; ++st) {
+            if (s.ops[c][st] == 0) continue;
+            out << "rgr_bytes_total{cipher=\"" << CIPHER_NAMES[c] << "\",stage=\""
+                << STAGE_NAMES[st] << "\"} " << s.bytes[c][st] << "\n";
+        }
+    }
+
+    if (perfEnabled()) {
+        out << "# HELP rgr_perf_events_total Hardware and software performance counters per cipher and stage.\n";
+        out << "# TYPE rgr_perf_events_total counter\n";
+        for (size_t c = 0; c < CIPHERS; ++c) {
+            for (size_t st = 0; st < STAGES; ++st) {
+                if (s.ops[c][st] == 0) continue;
+                for (size_t e = 0; e < PERF_EVENTS; ++e) {
+                    if (!perfAvailable(static_cast<PerfEvent>(e))) continue;
+                    out << "rgr_perf_events_total{cipher=\"" << CIPHER_NAMES[c] << "\",stage=\"" << STAGE_NAMES[st]
+                        << "\",event=\"" << perfEventName(static_cast<PerfEvent>(e)) << "\"} "
+                        << s.counters[c][st][e] << "\n";
+                }
+            }
+        }
+    }
+
+    out << "# HELP rgr_stage_duration_seconds Latency of a single operation.\n";
+    out << "# TYPE rgr_stage_duration_seconds histogram\n";
+    for (size_t c = 0; c < CIPHERS; ++c) {
+        for (size_t st = 0; st < STAGES; ++st) {
+            if (s.ops[c][st] == 0) continue;
+            string labels = string("cipher=\"") + CIPHER_NAMES[c] + "\",stage=\"" + STAGE_NAMES[st] + "\"";
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                cumulative += s.histogram[c][st][b];
+                out << "rgr_stage_duration_seconds_bucket{" << labels << ",le=\""
+                    << bucketBound(b) << "\"} " << cumulative << "\n";
+            }
+            out << "rgr_stage_duration_seconds_bucket{" << labels << ",le=\"+Inf\"} "
+                << s.ops[c][st] << "\n";
+            out << "rgr_stage_duration_seconds_sum{" << labels << "} " << s.nanos[c][st] / 1e9 << "\n";
+            out << "rgr_stage_duration_seconds_count{" << labels << "} " << s.ops[c][st] << "\n";
+        }
+    }
+    return out.str();
+}
+
+void metricsDump() {
+    lock_guard<mutex> lock(g_dumpMutex);
+    if (!g_exited) dumpLocked();
+}
+
+bool metricsEnabled() {
+    return g_enabled.load(memory_order_relaxed);
+}
+
+void metricsEnable(MetricsFormat format, const string& outputPath) {
+    g_format = format;
+    g_outputPath = outputPath;
+
+    // Блокируем SIGUSR1 до создания потоков - маску унаследуют все потоки,
+    // и сигнал будет доставлен только через sigwait
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    thread(signalLoop, set).detach();
+
+    atexit(dumpAtExit);
+    g_enabled.store(true, memory_order_release);
+}
@@ -0,0 +1,104 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include "perf_counters.h"
+#include "trace.h"
+
+// Шифр, к которому относится замер (NONE - файловый ввод/вывод)
+enum class MetricCipher {
+    NONE,
+    HILL,
+    RICHELIEU,
+    VIGENERE,
+    COUNT
+};
+
+// Этап обработки
+enum class MetricStage {
+    READ,
+    WRITE,
+    KEY_GENERATE,
+    KEY_LOAD,
+    ENCRYPT,
+    DECRYPT,
+    COUNT
+};
+
+enum class MetricsFormat {
+    JSON,
+    PROMETHEUS
+};
+
+// Учет одной операции (счетчики потока, без блокировок); counters - прирост
+// счетчиков производительности за операцию, если профилирование включено
+void metricsRecord(MetricCipher cipher, MetricStage stage, uint64_t bytes, uint64_t nanos,
+                   const PerfCounts* counters = nullptr);
+
+// Включение выгрузки метрик при выходе и по сигналу SIGUSR1
+// (пустой путь - вывод в stderr). Вызывать до создания других потоков.
+void metricsEnable(MetricsFormat format, const std::string& outputPath);
+
+// Включен ли сбор метрик (--metrics); без него замеры не выполняются
+bool metricsEnabled();
+
+// Имена шифра и этапа в метриках и трассировке
+const char* metricCipherName(MetricCipher cipher);
+const char* metricStageName(MetricStage stage);
+
+// Сводка по всем потокам
+std::string metricsToJson();
+std::string metricsToPrometheus();
+
+// Выгрузка в выбранном формате (выгрузки из разных потоков не пересекаются)
+void metricsDump();
+
+// Замер длительности операции на время жизни объекта. Если ни метрики, ни
+// трассировка не включены, замер ничего не делает (часы не читаются).
+class MetricsScope {
+public:
+    MetricsScope(MetricCipher cipher, MetricStage stage, uint64_t bytes = 0)
+        : cipher_(cipher), stage_(stage), bytes_(bytes), metrics_(metricsEnabled()) {
+#ifdef RGR_TRACE
+        trace_ = traceEnabled();
+#endif
+        if (!metrics_ && !trace_) return;
+        start_ = std::chrono::steady_clock::now();
+        if (metrics_ && perfEnabled()) perfStart_ = perfRead();
+    }
+
+    ~MetricsScope() {
+        if (!metrics_ && !trace_) return;
+        auto end = std::chrono::steady_clock::now();
+#ifdef RGR_TRACE
+        if (trace_) traceRecord(metricStageName(stage_), metricCipherName(cipher_), start_, end, bytes_);
+#endif
+        if (!metrics_) return;
+        auto elapsed = end - start_;
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (perfEnabled()) {
+            PerfCounts counters = perfRead() - perfStart_;
+            metricsRecord(cipher_, stage_, bytes_, nanos, &counters);
+        } else {
+            metricsRecord(cipher_, stage_, bytes_, nanos);
+        }
+    }
+
+    void setBytes(uint64_t bytes) { bytes_ = bytes; }
+
+    MetricsScope(const MetricsScope&) = delete;
+    MetricsScope& operator=(const MetricsScope&) = delete;
+
+private:
+    MetricCipher cipher_;
+    MetricStage stage_;
+    uint64_t bytes_;
+    bool metrics_;
+    bool trace_ = false;
+    std::chrono::steady_clock::time_point start_;
+    PerfCounts perfStart_;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Число потоков для work независимых частей работы (threads = 0 - по числу ядер)
+inline unsigned resolveThreads(unsigned threads, size_t work) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, work)));
+}
+
+// Запуск func(index, begin, end) на равных частях диапазона [0, total)
+template <typename Func>
+void parallelRanges(unsigned threads, size_t total, Func func) {
+    if (threads <= 1) {
+        func(0u, size_t(0), total);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t part = (total + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; ++t) {
+        size_t begin = std::min(total, t * part);
+        size_t end = std::min(total, begin + part);
+        workers.emplace_back(func, t, begin, end);
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+// Вызов func(i) для i из [0, count) в threads потоках (0 - по числу ядер).
+// Индексы раздаются по одному по порядку: части разной длины распределяются
+// равномерно, а стадия конвейера в отдельном потоке (сжатие, распаковка)
+// идет вслед за рабочими. Исключение из func останавливает раздачу и после
+// завершения всех потоков передается вызывающему. onStart() вызывается в
+// начале каждого рабочего потока, если их больше одного (имя потока в
+// трассировке).
+template <typename Func, typename Start>
+void forEachIndex(unsigned threads, size_t count, Func func, Start onStart) {
+    threads = resolveThreads(threads, count);
+    std::vector<std::exception_ptr> errors(threads);
+    std::atomic<size_t> next(0);
+    parallelRanges(threads, threads, [&](unsigned t, size_t, size_t) {
+        if (threads > 1) onStart();
+        try {
+            for (size_t i = next++; i < count; i = next++) func(i);
+        } catch (...) {
+            errors[t] = std::current_exception();
+            next = count; //остальные потоки заканчивают работу
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+template <typename Func>
+void forEachIndex(unsigned threads, size_t count, Func func) {
+    forEachIndex(threads, count, func, [] {});
+}
+
+#endif
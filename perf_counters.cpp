@@ -0,0 +1,145 @@
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+struct EventInfo {
+    uint32_t type;
+    uint64_t config;
+    const char* name;
+};
+
+const EventInfo EVENTS[PERF_EVENTS] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task_clock_ns"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page_faults"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses"},
+};
+
+// Открытая группа событий: дескрипторы по порядку открытия (первый -
+// лидер) и позиции событий в групповом чтении
+struct Group {
+    int leader = -1;
+    int slot[PERF_EVENTS]; // -1 - событие недоступно
+    int fds[PERF_EVENTS];
+    size_t opened = 0;
+};
+
+// Группа потока, вызвавшего perfEnable: с наследованием, поэтому после
+// завершения рабочих потоков в ее показания входят и они
+Group g_process;
+thread_local bool t_processThread = false;
+
+int openEvent(const EventInfo& info, int groupFd, bool inherit) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = info.type;
+    attr.config = info.config;
+    attr.exclude_kernel = 1; //доступно без привилегий при paranoid = 2
+    attr.exclude_hv = 1;
+    attr.inherit = inherit ? 1 : 0;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+// Открытие группы для текущего потока; причины отказа событий - в reason
+Group openGroup(bool inherit, string* reason) {
+    Group group;
+    for (size_t i = 0; i < PERF_EVENTS; ++i) {
+        group.slot[i] = -1;
+        // Первое открывшееся событие становится лидером группы
+        int fd = openEvent(EVENTS[i], group.leader, inherit);
+        if (fd < 0) {
+            if (reason) {
+                if (!reason->empty()) *reason += ", ";
+                *reason += string(EVENTS[i].name) + ": " + strerror(errno);
+            }
+            continue;
+        }
+        if (group.leader < 0) group.leader = fd;
+        group.slot[i] = static_cast<int>(group.opened);
+        group.fds[group.opened++] = fd;
+    }
+    return group;
+}
+
+PerfCounts readGroup(const Group& group) {
+    PerfCounts counts;
+    if (group.leader < 0) return counts;
+
+    // nr, time_enabled, time_running, значения по порядку открытия
+    uint64_t buffer[3 + PERF_EVENTS];
+    ssize_t size = read(group.leader, buffer, sizeof(buffer));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buffer[0] != group.opened) return counts;
+
+    // Если событий больше, чем регистров, ядро считает их по очереди
+    double scale = buffer[2] > 0 ? static_cast<double>(buffer[1]) / buffer[2] : 1.0;
+    for (size_t i = 0; i < PERF_EVENTS; ++i) {
+        if (group.slot[i] >= 0) counts.values[i] = static_cast<uint64_t>(buffer[3 + group.slot[i]] * scale);
+    }
+    return counts;
+}
+
+// Группа другого потока: открывается при первом чтении в этом потоке, без
+// наследования (счет только этого потока), закрывается при его завершении
+struct ThreadGroup {
+    Group group;
+    bool opened = false;
+
+    ~ThreadGroup() {
+        for (size_t i = 0; i < group.opened; ++i) close(group.fds[i]);
+    }
+};
+
+Group& threadGroup() {
+    thread_local ThreadGroup local;
+    if (!local.opened) {
+        local.opened = true;
+        local.group = openGroup(false, nullptr);
+    }
+    return local.group;
+}
+
+} // namespace
+
+PerfCounts operator-(const PerfCounts& end, const PerfCounts& start) {
+    PerfCounts delta;
+    for (size_t i = 0; i < PERF_EVENTS; ++i) {
+        delta.values[i] = end.values[i] >= start.values[i] ? end.values[i] - start.values[i] : 0;
+    }
+    return delta;
+}
+
+bool perfEnable(string& reason) {
+    if (g_process.leader >= 0) return true;
+    reason.clear();
+    g_process = openGroup(true, &reason);
+    t_processThread = g_process.leader >= 0;
+    return g_process.leader >= 0;
+}
+
+bool perfEnabled() {
+    return g_process.leader >= 0;
+}
+
+bool perfAvailable(PerfEvent event) {
+    return g_process.leader >= 0 && g_process.slot[static_cast<size_t>(event)] >= 0;
+}
+
+const char* perfEventName(PerfEvent event) {
+    return EVENTS[static_cast<size_t>(event)].name;
+}
+
+PerfCounts perfRead() {
+    if (g_process.leader < 0) return PerfCounts();
+    return readGroup(t_processThread ? g_process : threadGroup());
+}
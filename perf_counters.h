@@ -0,0 +1,50 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Счетчики производительности процесса (perf_event_open, только
+// пользовательский режим - работает при perf_event_paranoid <= 2).
+// Группа открывается в главном потоке до создания других потоков с
+// наследованием, поэтому в показания главного потока входят и завершившиеся
+// рабочие потоки. Другие потоки при первом чтении открывают свою группу без
+// наследования и читают только собственные счетчики.
+// Аппаратные события в виртуальной машине часто недоступны - тогда
+// остаются программные (процессорное время, страничные ошибки).
+
+enum class PerfEvent {
+    TASK_CLOCK,    // процессорное время, нс
+    PAGE_FAULTS,
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    COUNT
+};
+
+const size_t PERF_EVENTS = static_cast<size_t>(PerfEvent::COUNT);
+
+struct PerfCounts {
+    uint64_t values[PERF_EVENTS] = {};
+
+    uint64_t operator[](PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+};
+
+PerfCounts operator-(const PerfCounts& end, const PerfCounts& start);
+
+// Открытие счетчиков; false, если не открылось ни одно событие (причина -
+// в reason). Недоступные отдельные события перечисляются в reason при true.
+bool perfEnable(std::string& reason);
+
+bool perfEnabled();
+bool perfAvailable(PerfEvent event);
+const char* perfEventName(PerfEvent event);
+
+// Текущие показания группы вызывающего потока (с поправкой на
+// мультиплексирование); нули, если выключено. Разность имеет смысл только
+// для двух чтений в одном потоке.
+PerfCounts perfRead();
+
+#endif
@@ -0,0 +1,193 @@
+#include "planner.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+uint64_t g_budget = 0; // 0 - еще не определен ("auto" при первом обращении)
+bool g_report = false;
+
+// Число из файла cgroup; false, если файла нет или лимит не задан ("max")
+bool readCgroupValue(const string& path, uint64_t& value) {
+    ifstream in(path);
+    string text;
+    if (!(in >> text) || text == "max") return false;
+    try {
+        value = stoull(text);
+    } catch (const exception&) {
+        return false;
+    }
+    return true;
+}
+
+// Каталог cgroup v2 процесса ("0::/путь" в /proc/self/cgroup)
+string cgroupDirectory() {
+    ifstream in("/proc/self/cgroup");
+    string line;
+    while (getline(in, line)) {
+        if (line.rfind("0::", 0) == 0) return "/sys/fs/cgroup" + line.substr(3);
+    }
+    return "/sys/fs/cgroup";
+}
+
+string formatBytes(uint64_t bytes) {
+    static const char* const units[] = {"Б", "КиБ", "МиБ", "ГиБ", "ТиБ"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024;
+        ++unit;
+    }
+    ostringstream out;
+    out.setf(ios::fixed);
+    out.precision(unit == 0 ? 0 : 1);
+    out << value << " " << units[unit];
+    return out.str();
+}
+
+uint64_t scaled(uint64_t size, double factor) {
+    return static_cast<uint64_t>(static_cast<double>(size) * factor);
+}
+
+} // namespace
+
+uint64_t availableMemory() {
+    uint64_t available = 0;
+    ifstream meminfo("/proc/meminfo");
+    string name;
+    uint64_t value;
+    string unit;
+    while (meminfo >> name >> value >> unit) {
+        if (name == "MemAvailable:") {
+            available = value * 1024;
+            break;
+        }
+    }
+    if (available == 0) { //старое ядро или не Linux
+        available = static_cast<uint64_t>(sysconf(_SC_AVPHYS_PAGES)) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    // В контейнере лимит cgroup обычно меньше свободной памяти машины
+    string cgroup = cgroupDirectory();
+    uint64_t limit = 0, current = 0;
+    if (readCgroupValue(cgroup + "/memory.max", limit)) {
+        readCgroupValue(cgroup + "/memory.current", current);
+        available = min(available, limit > current ? limit - current : 0);
+    }
+    return available;
+}
+
+void setMemoryBudget(const string& spec) {
+    if (spec == "auto") {
+        g_budget = max<uint64_t>(availableMemory() / 2, PLAN_MIN_CHUNK);
+        return;
+    }
+    size_t pos = 0;
+    unsigned long long number = 0;
+    try {
+        number = stoull(spec, &pos);
+    } catch (const exception&) {
+        pos = 0;
+    }
+    if (spec.empty() || pos == 0 || spec[0] == '-') {
+        throw invalid_argument("Недопустимый бюджет памяти: " + spec);
+    }
+    string suffix = spec.substr(pos);
+    uint64_t budget = 0;
+    if (suffix == "%") {
+        if (number == 0 || number > 100) throw invalid_argument("Доля памяти в бюджете: 1..100%");
+        budget = availableMemory() / 100 * number;
+    } else {
+        uint64_t multiplier = 1;
+        if (suffix.size() == 1) {
+            switch (toupper(static_cast<unsigned char>(suffix[0]))) {
+                case 'K': multiplier = 1ull << 10; break;
+                case 'M': multiplier = 1ull << 20; break;
+                case 'G': multiplier = 1ull << 30; break;
+                default: throw invalid_argument("Недопустимый суффикс бюджета памяти (K, M, G или %): " + spec);
+            }
+        } else if (!suffix.empty()) {
+            throw invalid_argument("Недопустимый суффикс бюджета памяти (K, M, G или %): " + spec);
+        }
+        if (number > UINT64_MAX / multiplier) throw invalid_argument("Слишком большой бюджет памяти: " + spec);
+        budget = number * multiplier;
+    }
+    if (budget == 0) throw invalid_argument("Бюджет памяти должен быть положительным");
+    g_budget = budget;
+}
+
+uint64_t memoryBudget() {
+    if (g_budget == 0) setMemoryBudget("auto");
+    return g_budget;
+}
+
+void setPlanReport(bool enabled) {
+    g_report = enabled;
+}
+
+ExecutionPlan planExecution(const PlanJob& job) {
+    ExecutionPlan plan;
+    plan.budget = memoryBudget();
+    plan.chunkSize = job.chunkSize;
+    uint64_t chunks = job.chunkSize ? (job.inputSize + job.chunkSize - 1) / job.chunkSize : 1;
+    plan.threads = resolveThreads(job.threads, static_cast<size_t>(max<uint64_t>(1, chunks)));
+
+    uint64_t inMemoryPeak = scaled(job.inputSize, job.inMemoryFactor);
+    uint64_t mappedPeak = scaled(job.inputSize, job.mappedFactor);
+    if (job.inputSize <= PLAN_SMALL_INPUT && inMemoryPeak <= plan.budget) {
+        plan.strategy = PlanStrategy::IN_MEMORY;
+        plan.estimatedPeak = inMemoryPeak;
+    } else if (mappedPeak <= plan.budget || !job.streamable) {
+        plan.strategy = PlanStrategy::MAPPED;
+        plan.estimatedPeak = mappedPeak;
+        plan.overBudget = mappedPeak > plan.budget;
+    } else {
+        // Сначала меньше потоков (фрагмент остается крупным и запись - редкой),
+        // затем меньше фрагмент
+        plan.strategy = PlanStrategy::STREAMING;
+        auto peak = [&] { return scaled(plan.chunkSize * plan.threads, job.streamFactor); };
+        while (peak() > plan.budget && plan.threads > 1) --plan.threads;
+        while (peak() > plan.budget && job.chunkAdjustable && plan.chunkSize > PLAN_MIN_CHUNK) {
+            plan.chunkSize = max(PLAN_MIN_CHUNK, plan.chunkSize / 2);
+        }
+        plan.estimatedPeak = peak();
+        plan.overBudget = plan.estimatedPeak > plan.budget;
+    }
+
+    if (g_report) cerr << describePlan(job, plan) << endl;
+    if (plan.overBudget) {
+        cerr << "Предупреждение: " << job.name << " требует около " << formatBytes(plan.estimatedPeak)
+             << " при бюджете памяти " << formatBytes(plan.budget) << endl;
+    }
+    return plan;
+}
+
+const char* planStrategyName(PlanStrategy strategy) {
+    switch (strategy) {
+        case PlanStrategy::IN_MEMORY: return "in-memory";
+        case PlanStrategy::MAPPED: return "mapped";
+        case PlanStrategy::STREAMING: return "streaming";
+    }
+    return "?";
+}
+
+string describePlan(const PlanJob& job, const ExecutionPlan& plan) {
+    ostringstream out;
+    out << "План: " << job.name << ", вход " << formatBytes(job.inputSize) << ", способ "
+        << planStrategyName(plan.strategy);
+    if (plan.strategy == PlanStrategy::STREAMING) {
+        out << ", фрагмент " << formatBytes(plan.chunkSize);
+    }
+    out << ", потоков " << plan.threads << ", пик ~" << formatBytes(plan.estimatedPeak) << " из бюджета "
+        << formatBytes(plan.budget);
+    if (plan.overBudget) out << " (превышен)";
+    return out.str();
+}
@@ -0,0 +1,73 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <cstdint>
+#include <string>
+
+// Выбор способа выполнения задания по бюджету памяти. Целиком в памяти
+// быстрее всего для небольших входов, но пик памяти кратен размеру входа;
+// отображение файла экономит копию входа; потоковая обработка фрагментами
+// держит в памяти только фрагменты, которые обрабатываются сейчас, и
+// подходит для входов любого размера, но платит за запись по частям.
+// Планировщик берет самый быстрый способ, пик которого укладывается в
+// бюджет, а для потокового уменьшает число потоков и размер фрагмента.
+
+enum class PlanStrategy {
+    IN_MEMORY, // вход читается в память целиком
+    MAPPED,    // вход отображается, результат собирается в памяти
+    STREAMING  // фрагменты обрабатываются группами и сразу пишутся
+};
+
+// Описание задания: размер входа, запрошенные параметры и оценка пика
+// памяти каждого способа (множитель к размеру входа или к фрагменту)
+struct PlanJob {
+    const char* name = "";
+    uint64_t inputSize = 0;
+    uint64_t chunkSize = 0;      // запрошенный размер фрагмента
+    unsigned threads = 0;        // запрошенное число потоков (0 - по числу ядер)
+    bool chunkAdjustable = true; // размер фрагмента не задан явно и его можно уменьшить
+    bool streamable = false;     // потоковый способ доступен (например, есть файл результата)
+    double inMemoryFactor = 4;   // пик / inputSize при чтении входа целиком
+    double mappedFactor = 3;     // пик / inputSize при отображении входа
+    double streamFactor = 3;     // пик / (threads * chunkSize) при потоковой обработке
+};
+
+struct ExecutionPlan {
+    PlanStrategy strategy = PlanStrategy::IN_MEMORY;
+    uint64_t chunkSize = 0;
+    unsigned threads = 1;
+    uint64_t estimatedPeak = 0;
+    uint64_t budget = 0;
+    bool overBudget = false; // ни один способ не укладывается в бюджет
+};
+
+// Входы до этого размера читаются целиком (если укладываются в бюджет):
+// отображение и потоковая обработка не окупаются
+const uint64_t PLAN_SMALL_INPUT = 4 << 20;
+// Наименьший фрагмент, до которого планировщик уменьшает размер фрагмента
+const uint64_t PLAN_MIN_CHUNK = 64 << 10;
+
+// Бюджет (--memory-budget=...): "auto" - половина доступной памяти, число
+// байт с необязательным суффиксом K, M, G (степени 1024) или доля доступной
+// памяти в процентах ("25%"). Ошибка в описании - исключение invalid_argument.
+void setMemoryBudget(const std::string& spec);
+
+// Бюджет в байтах (по умолчанию - как "auto")
+uint64_t memoryBudget();
+
+// Доступная память: MemAvailable из /proc/meminfo, ограниченная остатком
+// лимита cgroup (memory.max - memory.current), если он задан
+uint64_t availableMemory();
+
+// Печать выбранного плана в stderr (--plan)
+void setPlanReport(bool enabled);
+
+// План задания под текущий бюджет; печатается, если включен отчет
+ExecutionPlan planExecution(const PlanJob& job);
+
+const char* planStrategyName(PlanStrategy strategy);
+
+// Одна строка: задание, способ, фрагмент, потоки, оценка пика и бюджет
+std::string describePlan(const PlanJob& job, const ExecutionPlan& plan);
+
+#endif
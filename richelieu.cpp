@@ -1,4 +1,7 @@
 #include "richelieu.h"
+#include "kernel_table.h"
+#include "mapped_file.h"
+#include "staged_file.h"
 #include <algorithm>
 #include <random>
 #include <fstream>
@@ -8,8 +11,14 @@
 #include <vector>
 #include <codecvt>
 #include <locale>
+#include <cstring>
+#include <filesystem>
 
 using namespace std;
+namespace fs = std::filesystem;
+
+// Порция потоковой обработки файла
+const size_t STREAM_CHUNK = 4 << 20;
 
 // функция для корректного разделения UTF-8 строки на символы
 vector<string> utf8_split(const string& str) {
@@ -80,8 +89,7 @@ void padBlock(vector<string>& block, size_t blockSize) {
 }
 
 // Шифрование с полной поддержкой UTF-8 и дополнением блока
-string richelieuEncrypt(const string& text, const string& keyStr) {
-    vector<int> key = parseKey(keyStr);
+string encryptGeneric(const string& text, const vector<int>& key) {
     vector<string> characters = utf8_split(text);
     string result;
     result.reserve(text.size() + key.size()); //Резервируем память с запасом
@@ -116,8 +124,7 @@ string richelieuEncrypt(const string& text, const string& keyStr) {
 }
 
 
-string richelieuDecrypt(const string& ciphertext, const string& keyStr) {
-    vector<int> key = parseKey(keyStr);
+string decryptGeneric(const string& ciphertext, const vector<int>& key) {
     vector<string> characters = utf8_split(ciphertext);
     string result;
     result.reserve(ciphertext.size());
@@ -152,6 +159,205 @@ string richelieuDecrypt(const string& ciphertext, const string& keyStr) {
     return result;
 }
 
+typedef string (*RichelieuFunc)(const string&, const vector<int>&, bool);
+
+// Вариант "generic": каждый символ - отдельная строка
+string richelieuGeneric(const string& data, const vector<int>& key, bool decrypt) {
+    return decrypt ? decryptGeneric(data, key) : encryptGeneric(data, key);
+}
+
+// Начала символов UTF-8 (по тем же правилам, что utf8_split) и конец текста
+vector<size_t> utf8_starts(const string& str) {
+    vector<size_t> starts;
+    starts.reserve(str.size() + 1);
+    for (size_t i = 0; i < str.size();) {
+        unsigned char c = str[i];
+        size_t char_len = 1;
+        if ((c & 0xE0) == 0xC0) char_len = 2;
+        else if ((c & 0xF0) == 0xE0) char_len = 3;
+        else if ((c & 0xF8) == 0xF0) char_len = 4;
+        if (i + char_len > str.size()) char_len = 1;
+        starts.push_back(i);
+        i += char_len;
+    }
+    starts.push_back(str.size());
+    return starts;
+}
+
+// Вариант "offsets": символы - смещения в исходной строке, результат пишется
+// в заранее выделенный буфер. Блок из однобайтовых символов переставляется
+// побайтно. Вывод совпадает с "generic", включая дополнение X.
+string richelieuOffsets(const string& data, const vector<int>& key, bool decrypt) {
+    vector<size_t> starts = utf8_starts(data);
+    size_t count = starts.size() - 1, k = key.size();
+
+    // Перестановка позиций блока: при шифровании j-й символ результата - символ
+    // key[j] - 1 блока, при дешифровании - символ обратной перестановки
+    vector<size_t> order(k);
+    for (size_t j = 0; j < k; ++j) {
+        if (decrypt) order[key[j] - 1] = j;
+        else order[j] = key[j] - 1;
+    }
+
+    size_t padding = (!decrypt && count % k) ? k - count % k : 0;
+    string result(data.size() + padding, '\0');
+    char* out = &result[0];
+    for (size_t i = 0; i < count; i += k) {
+        size_t block_size = min(k, count - i);
+        if (block_size == k && starts[i + k] - starts[i] == k) {
+            const char* block = data.data() + starts[i];
+            for (size_t j = 0; j < k; ++j) *out++ = block[order[j]];
+            continue;
+        }
+        for (size_t j = 0; j < k; ++j) {
+            size_t pos = order[j];
+            if (pos < block_size) {
+                size_t length = starts[i + pos + 1] - starts[i + pos];
+                memcpy(out, data.data() + starts[i + pos], length);
+                out += length;
+            } else if (!decrypt) {
+                *out++ = 'X';
+            }
+        }
+    }
+    return result;
+}
+
+KernelTable<RichelieuFunc>& richelieuKernels() {
+    static KernelTable<RichelieuFunc> table({
+        {"generic", richelieuGeneric, true},
+        {"offsets", richelieuOffsets, true},
+    });
+    return table;
+}
+
+string richelieuEncrypt(const string& text, const string& keyStr) {
+    vector<int> key = parseKey(keyStr);
+    return richelieuKernels().get(text.size())(text, key, false);
+}
+
+string richelieuDecrypt(const string& ciphertext, const string& keyStr) {
+    vector<int> key = parseKey(keyStr);
+    return richelieuKernels().get(ciphertext.size())(ciphertext, key, true);
+}
+
+// Ключ смены ключа: символ j нового шифртекста - символ p_old^-1(p_new(j))
+// старого (блоки шифртекста всегда полные, поэтому дополнение сохраняется)
+string richelieuComposeKeys(const string& oldKeyStr, const string& newKeyStr) {
+    vector<int> oldKey = parseKey(oldKeyStr), newKey = parseKey(newKeyStr);
+    if (oldKey.size() != newKey.size()) {
+        throw invalid_argument("Размеры блоков старого и нового ключей Ришелье различаются");
+    }
+    vector<int> inverse(oldKey.size());
+    for (size_t j = 0; j < oldKey.size(); ++j) inverse[oldKey[j] - 1] = static_cast<int>(j);
+
+    string key;
+    for (int position : newKey) key += to_string(inverse[position - 1] + 1) + " ";
+    key.pop_back();
+    return key;
+}
+
+// Потоковая обработка: контекст хранит начало неполного блока - целые
+// символы и незавершенную последовательность UTF-8 в конце порции
+struct RichelieuContext {
+    vector<int> key;
+    bool decrypt = false;
+    string pending;
+};
+
+RichelieuContext* richelieuInit(const string& keyStr, bool decrypt) {
+    return new RichelieuContext{parseKey(keyStr), decrypt, ""};
+}
+
+void richelieuUpdate(RichelieuContext* context, const char* data, size_t size, string& out) {
+    string& pending = context->pending;
+    pending.append(data, size);
+
+    // Конец последнего полного блока: символы считаются по правилам utf8_split,
+    // символ, который не уместился в накопленные байты, ждет следующей порции
+    size_t k = context->key.size(), chars = 0, blocksEnd = 0;
+    for (size_t i = 0; i < pending.size();) {
+        unsigned char c = pending[i];
+        size_t char_len = 1;
+        if ((c & 0xE0) == 0xC0) char_len = 2;
+        else if ((c & 0xF0) == 0xE0) char_len = 3;
+        else if ((c & 0xF8) == 0xF0) char_len = 4;
+        if (i + char_len > pending.size()) break;
+        i += char_len;
+        if (++chars % k == 0) blocksEnd = i;
+    }
+    if (blocksEnd == 0) return;
+
+    // Полные блоки без дополнения - тот же результат, что и в составе всего текста.
+    // Хвост переносится отдельно, чтобы блоки не копировались еще раз.
+    string tail = pending.substr(blocksEnd);
+    pending.resize(blocksEnd);
+    string result = richelieuKernels().get(blocksEnd)(pending, context->key, context->decrypt);
+    if (out.empty()) out = move(result);
+    else out += result;
+    pending = move(tail);
+}
+
+void richelieuFinal(RichelieuContext* context, string& out) {
+    // Остаток - меньше блока; незавершенный символ в конце разбирается по байтам
+    // и неполный блок дополняется X, как при обработке текста целиком
+    if (!context->pending.empty()) {
+        out += richelieuKernels().get(context->pending.size())(context->pending, context->key, context->decrypt);
+    }
+    context->pending.clear();
+}
+
+void richelieuFree(RichelieuContext* context) {
+    delete context;
+}
+
+// Файл проходится порциями STREAM_CHUNK через потоковый контекст: символ
+// UTF-8 и блок перестановки, разрезанные границей порции, переносятся в
+// следующую, последний блок дополняется в конце файла. Пройденные страницы
+// входа освобождаются, поэтому память не зависит от длины файла.
+void richelieuProcessFile(const string& inputFile, const string& outputFile, const string& keyStr, bool decrypt) {
+    MappedFile in(inputFile);
+    // Выход может совпадать с отображенным входом: пишем во временный файл
+    StagedFile staged(outputFile);
+    ofstream out(staged.path(), ios::binary);
+    if (!out) throw runtime_error("Ошибка: не удалось создать файл: " + outputFile);
+
+    RichelieuContext context{parseKey(keyStr), decrypt, ""};
+    string buffer;
+    for (size_t offset = 0; offset < in.size(); offset += STREAM_CHUNK) {
+        size_t n = min(STREAM_CHUNK, in.size() - offset);
+        buffer.clear();
+        richelieuUpdate(&context, in.data() + offset, n, buffer);
+        out.write(buffer.data(), buffer.size());
+        if (!out) throw runtime_error("Ошибка записи в файл: " + outputFile);
+        in.release(offset, n);
+    }
+    buffer.clear();
+    richelieuFinal(&context, buffer);
+    out.write(buffer.data(), buffer.size());
+    out.close();
+    if (!out) throw runtime_error("Ошибка записи в файл: " + outputFile);
+    staged.commit();
+}
+
+void richelieuEncryptFile(const string& inputFile, const string& outputFile, const string& key) {
+    richelieuProcessFile(inputFile, outputFile, key, false);
+}
+
+void richelieuDecryptFile(const string& inputFile, const string& outputFile, const string& key) {
+    richelieuProcessFile(inputFile, outputFile, key, true);
+}
+
+vector<string> richelieuKernelNames(const string& family) {
+    if (family == "richelieu") return richelieuKernels().names();
+    return {};
+}
+
+bool richelieuSelectKernel(const string& family, size_t bucket, const string& name) {
+    if (family == "richelieu") return richelieuKernels().select(bucket, name);
+    return false;
+}
+
 //
 void saveRichelieuKey(const string& key, const string& filename) {
     ofstream file(filename);
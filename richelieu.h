@@ -23,6 +23,48 @@ void saveRichelieuKey(const std::string& key, const std::string& filename);
 // Загрузка ключа из файла
 std::string loadRichelieuKey(const std::string& filename);
 
+// Ключ смены ключа - композиция перестановок: шифрование шифртекста старого
+// ключа этим ключом дает шифртекст нового. Размеры блоков должны совпадать.
+__attribute__((visibility("default")))
+std::string richelieuComposeKeys(const std::string& oldKey, const std::string& newKey);
+
+// Потоковое шифрование/дешифрование: update принимает порции любого размера
+// и дописывает в out готовые блоки; контекст хранит неполный блок и
+// незавершенный символ UTF-8. final дописывает последний блок (с дополнением)
+// и возвращает контекст в начальное состояние для следующего сообщения.
+// Результат совпадает с richelieuEncrypt/richelieuDecrypt от всего сообщения.
+struct RichelieuContext;
+
+__attribute__((visibility("default")))
+RichelieuContext* richelieuInit(const std::string& key, bool decrypt);
+
+__attribute__((visibility("default")))
+void richelieuUpdate(RichelieuContext* context, const char* data, size_t size, std::string& out);
+
+__attribute__((visibility("default")))
+void richelieuFinal(RichelieuContext* context, std::string& out);
+
+__attribute__((visibility("default")))
+void richelieuFree(RichelieuContext* context);
+
+// Шифрование/дешифрование файла порциями через потоковый контекст: память
+// не зависит от длины файла, результат совпадает с обработкой файла целиком
+// (включая дополнение X последнего блока при шифровании)
+__attribute__((visibility("default")))
+void richelieuEncryptFile(const std::string& inputFile, const std::string& outputFile, const std::string& key);
+
+__attribute__((visibility("default")))
+void richelieuDecryptFile(const std::string& inputFile, const std::string& outputFile, const std::string& key);
+
+// Варианты ядра перестановки ("richelieu": generic - символ как строка,
+// offsets - символы как смещения) и выбор варианта для корзины размеров
+// (см. kernel_table.h)
+__attribute__((visibility("default")))
+std::vector<std::string> richelieuKernelNames(const std::string& family);
+
+__attribute__((visibility("default")))
+bool richelieuSelectKernel(const std::string& family, size_t bucket, const std::string& name);
+
 #ifdef __cplusplus
 }
 #endif
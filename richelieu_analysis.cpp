@@ -0,0 +1,210 @@
+#include "richelieu_analysis.h"
+#include "text_model.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using textmodel::Language;
+using textmodel::QuadgramModel;
+
+// Из richelieu.cpp
+vector<string> utf8_split(const string& str);
+
+namespace {
+
+// Символов шифртекста, по которым оценивается перестановка
+const size_t SAMPLE_CHARS = 3000;
+// Перезапусков отжига по умолчанию
+const unsigned DEFAULT_RESTARTS = 8;
+
+// Оценка расшифровки при перестановке perm: открытый символ на позиции j
+// блока равен символу шифртекста на позиции perm[j] того же блока
+class PermutationScorer {
+public:
+    PermutationScorer(const vector<int>& symbols, size_t blockSize, const QuadgramModel& model)
+        : symbols_(symbols), n_(blockSize), model_(model) {}
+
+    double total(const vector<int>& perm) const {
+        double score = 0;
+        for (size_t r = 0; r < n_; ++r) score += startingAt(perm, r);
+        return score;
+    }
+
+    // Изменение оценки при обмене perm[x] и perm[y]. Пересчитываются только
+    // квадграммы, задевающие позиции x и y в каждом блоке, - O(blocks).
+    // Обмен остается примененным.
+    double swapDelta(vector<int>& perm, size_t x, size_t y) const {
+        size_t residues[8];
+        int count = 0;
+        for (size_t pos : {x, y}) {
+            for (size_t k = 0; k < 4; ++k) {
+                size_t r = (pos + n_ * 4 - k) % n_;
+                if (find(residues, residues + count, r) == residues + count) residues[count++] = r;
+            }
+        }
+
+        double before = 0, after = 0;
+        for (int i = 0; i < count; ++i) before += startingAt(perm, residues[i]);
+        swap(perm[x], perm[y]);
+        for (int i = 0; i < count; ++i) after += startingAt(perm, residues[i]);
+        return after - before;
+    }
+
+private:
+    // Сумма квадграмм, начинающихся на позиции r каждого блока. Смещения
+    // четырех символов относительно начала блока одинаковы для всех блоков.
+    double startingAt(const vector<int>& perm, size_t r) const {
+        size_t offset[4];
+        for (size_t i = 0; i < 4; ++i) {
+            size_t pos = r + i;
+            offset[i] = pos / n_ * n_ + perm[pos % n_];
+        }
+
+        double score = 0;
+        const int* sym = symbols_.data();
+        for (size_t start = 0; start + r + 3 < symbols_.size(); start += n_) {
+            score += model_.score(sym[start + offset[0]], sym[start + offset[1]],
+                                  sym[start + offset[2]], sym[start + offset[3]]);
+        }
+        return score;
+    }
+
+    const vector<int>& symbols_;
+    size_t n_;
+    const QuadgramModel& model_;
+};
+
+struct Candidate {
+    vector<int> perm;
+    double score = -INFINITY;
+};
+
+// Один запуск отжига со случайной начальной перестановки и доводкой обменами
+Candidate anneal(const PermutationScorer& scorer, size_t n, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_int_distribution<size_t> slot(0, n - 1);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+
+    vector<int> perm(n);
+    iota(perm.begin(), perm.end(), 0);
+    shuffle(perm.begin(), perm.end(), gen);
+    double current = scorer.total(perm);
+
+    // Начальная температура - порядка типичного изменения оценки
+    double typical = 0;
+    const int probes = 32;
+    for (int i = 0; i < probes; ++i) {
+        size_t x = slot(gen), y = slot(gen);
+        if (x == y) continue;
+        typical += fabs(scorer.swapDelta(perm, x, y));
+        swap(perm[x], perm[y]);
+    }
+    double startTemperature = max(typical / probes, 1e-3);
+
+    Candidate best{perm, current};
+    const size_t iterations = 5000 + 30 * n * n;
+    for (size_t it = 0; it < iterations; ++it) {
+        size_t x = slot(gen), y = slot(gen);
+        if (x == y) continue;
+        double temperature = startTemperature * (1.0 - static_cast<double>(it) / iterations);
+        double delta = scorer.swapDelta(perm, x, y);
+        if (delta >= 0 || (temperature > 0 && unit(gen) < exp(delta / temperature))) {
+            current += delta;
+            if (current > best.score) best = {perm, current};
+        } else {
+            swap(perm[x], perm[y]); //откат
+        }
+    }
+
+    // Доводка. Сдвиг перестановки по кругу дает почти тот же текст, сдвинутый
+    // на несколько символов (ошибки только на границах блоков), - такой
+    // локальный максимум обменами не покинуть, поэтому проверяются и сдвиги.
+    perm = best.perm;
+    current = best.score;
+    for (bool improved = true; improved;) {
+        improved = false;
+        for (size_t shift = 1; shift < n; ++shift) {
+            vector<int> rotated(n);
+            for (size_t j = 0; j < n; ++j) rotated[j] = perm[(j + shift) % n];
+            double score = scorer.total(rotated);
+            if (score > current + 1e-9) {
+                perm = rotated;
+                current = score;
+                improved = true;
+            }
+        }
+        for (size_t x = 0; x < n; ++x) {
+            for (size_t y = x + 1; y < n; ++y) {
+                double delta = scorer.swapDelta(perm, x, y);
+                if (delta > 1e-9) {
+                    current += delta;
+                    improved = true;
+                } else {
+                    swap(perm[x], perm[y]);
+                }
+            }
+        }
+    }
+    return {perm, current};
+}
+
+} // namespace
+
+RichelieuSolution richelieuSolve(const string& ciphertext, int blockSize, const string& language,
+                                 const string& corpus, unsigned threads, unsigned restarts) {
+    if (blockSize <= 0) throw invalid_argument("Размер блока должен быть положительным");
+    const size_t n = static_cast<size_t>(blockSize);
+
+    Language lang;
+    if (language == "ru") lang = Language::RUSSIAN;
+    else if (language == "en") lang = Language::ENGLISH;
+    else if (language.empty()) lang = textmodel::detectLanguage(ciphertext);
+    else throw invalid_argument("Неизвестный язык: " + language);
+
+    RichelieuSolution result;
+    result.language = lang == Language::RUSSIAN ? "ru" : "en";
+
+    // Символы тех же блоков, что и при шифровании (только полные блоки)
+    vector<string> characters = utf8_split(ciphertext);
+    size_t usable = min(characters.size(), max(SAMPLE_CHARS, n * 4)) / n * n;
+    if (usable < 4 || usable < n) throw invalid_argument("Недостаточно данных для анализа");
+
+    QuadgramModel model(lang, corpus);
+    vector<int> symbols(usable);
+    for (size_t i = 0; i < usable; ++i) symbols[i] = model.symbol(textmodel::decodeUtf8(characters[i]));
+    PermutationScorer scorer(symbols, n, model);
+
+    Candidate best;
+    if (n == 1) {
+        best.perm = {0};
+        best.score = scorer.total(best.perm);
+    } else {
+        if (restarts == 0) restarts = DEFAULT_RESTARTS;
+        threads = resolveThreads(threads, restarts);
+        vector<Candidate> partial(threads);
+        random_device rd;
+        unsigned baseSeed = rd();
+        parallelRanges(threads, restarts, [&](unsigned t, size_t first, size_t last) {
+            for (size_t r = first; r < last; ++r) {
+                Candidate candidate = anneal(scorer, n, baseSeed + static_cast<unsigned>(r));
+                if (candidate.score > partial[t].score) partial[t] = candidate;
+            }
+        });
+        for (const Candidate& candidate : partial) {
+            if (candidate.score > best.score) best = candidate;
+        }
+    }
+
+    // Ключ шифрования: позиция perm[j] шифртекста получена из позиции j
+    vector<int> key(n);
+    for (size_t j = 0; j < n; ++j) key[best.perm[j]] = static_cast<int>(j) + 1;
+    for (int k : key) result.key += to_string(k) + " ";
+    result.key.pop_back();
+    result.score = best.score / (usable - 3);
+    return result;
+}
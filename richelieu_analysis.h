@@ -0,0 +1,29 @@
+#ifndef RICHELIEU_ANALYSIS_H
+#define RICHELIEU_ANALYSIS_H
+
+#include <string>
+
+// Результат подбора перестановки Ришелье
+struct RichelieuSolution {
+    std::string key;       // ключ в формате generateRichelieuKey
+    double score = 0;      // log10-правдоподобие квадграмм на символ
+    std::string language;  // "ru" или "en"
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Подбор перестановки по шифртексту при известном размере блока.
+// Параллельный отжиг с перезапусками, оценка по таблице квадграмм.
+// language - "ru", "en" или пусто (определить по тексту); corpus - образец
+// текста для таблицы (пустой - встроенный); threads = 0 - по числу ядер.
+__attribute__((visibility("default")))
+RichelieuSolution richelieuSolve(const std::string& ciphertext, int blockSize, const std::string& language,
+                                 const std::string& corpus, unsigned threads, unsigned restarts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RICHELIEU_ANALYSIS_H
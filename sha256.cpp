@@ -0,0 +1,153 @@
+#include "sha256.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t rotr(uint32_t x, int r) {
+    return (x >> r) | (x << (32 - r));
+}
+
+// HMAC с заранее посчитанными состояниями после блоков ipad и opad:
+// в PBKDF2 каждая итерация стоит двух сжатий вместо четырех
+struct Hmac {
+    Sha256 inner;
+    Sha256 outer;
+
+    Hmac(const void* key, size_t keySize) {
+        unsigned char block[64] = {};
+        if (keySize > sizeof(block)) {
+            Sha256Digest digest = sha256(key, keySize);
+            memcpy(block, digest.data(), digest.size());
+        } else {
+            memcpy(block, key, keySize);
+        }
+        unsigned char pad[64];
+        for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x36;
+        inner.update(pad, sizeof(pad));
+        for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x5c;
+        outer.update(pad, sizeof(pad));
+    }
+
+    Sha256Digest compute(const void* data, size_t size) const {
+        Sha256 in = inner;
+        in.update(data, size);
+        Sha256Digest digest = in.finish();
+        Sha256 out = outer;
+        out.update(digest.data(), digest.size());
+        return out.finish();
+    }
+};
+
+} // namespace
+
+Sha256::Sha256() {
+    static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(state_, initial, sizeof(state_));
+}
+
+void Sha256::compress(const unsigned char* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = static_cast<uint32_t>(block[4 * i]) << 24 | static_cast<uint32_t>(block[4 * i + 1]) << 16
+               | static_cast<uint32_t>(block[4 * i + 2]) << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    length_ += size;
+    if (buffered_ > 0) {
+        size_t take = size < 64 - buffered_ ? size : 64 - buffered_;
+        memcpy(buffer_ + buffered_, bytes, take);
+        buffered_ += take;
+        bytes += take;
+        size -= take;
+        if (buffered_ < 64) return;
+        compress(buffer_);
+        buffered_ = 0;
+    }
+    for (; size >= 64; bytes += 64, size -= 64) compress(bytes);
+    memcpy(buffer_, bytes, size);
+    buffered_ = size;
+}
+
+Sha256Digest Sha256::finish() {
+    uint64_t bits = length_ * 8;
+    unsigned char tail[72] = {0x80};
+    size_t padding = (buffered_ < 56 ? 56 : 120) - buffered_;
+    for (int i = 0; i < 8; ++i) tail[padding + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+    update(tail, padding + 8);
+
+    Sha256Digest digest;
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 4; ++j) digest[4 * i + j] = static_cast<uint8_t>(state_[i] >> (24 - 8 * j));
+    }
+    return digest;
+}
+
+Sha256Digest sha256(const void* data, size_t size) {
+    Sha256 hash;
+    hash.update(data, size);
+    return hash.finish();
+}
+
+Sha256Digest hmacSha256(const void* key, size_t keySize, const void* data, size_t size) {
+    return Hmac(key, keySize).compute(data, size);
+}
+
+std::string pbkdf2Sha256(const void* password, size_t passwordSize, const void* salt, size_t saltSize,
+                         uint32_t iterations, size_t size) {
+    const Hmac hmac(password, passwordSize);
+    std::string result;
+    for (uint32_t block = 1; result.size() < size; ++block) {
+        std::string first(static_cast<const char*>(salt), saltSize);
+        for (int i = 3; i >= 0; --i) first += static_cast<char>(block >> (8 * i));
+        Sha256Digest u = hmac.compute(first.data(), first.size());
+        Sha256Digest t = u;
+        for (uint32_t i = 1; i < iterations; ++i) {
+            u = hmac.compute(u.data(), u.size());
+            for (size_t j = 0; j < t.size(); ++j) t[j] ^= u[j];
+        }
+        result.append(reinterpret_cast<const char*>(t.data()), std::min(t.size(), size - result.size()));
+    }
+    return result;
+}
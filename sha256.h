@@ -0,0 +1,37 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// SHA-256 (FIPS 180-4), HMAC-SHA256 (RFC 2104) и PBKDF2-HMAC-SHA256
+// (RFC 8018) для проверочного значения ключа и выведенных из ключа секретов.
+// Данные не шифруются этим кодом, поэтому скорость вторична.
+using Sha256Digest = std::array<uint8_t, 32>;
+
+class Sha256 {
+public:
+    Sha256();
+    void update(const void* data, size_t size);
+    Sha256Digest finish();
+
+private:
+    void compress(const unsigned char* block);
+
+    uint32_t state_[8];
+    unsigned char buffer_[64];
+    size_t buffered_ = 0;
+    uint64_t length_ = 0;
+};
+
+Sha256Digest sha256(const void* data, size_t size);
+
+Sha256Digest hmacSha256(const void* key, size_t keySize, const void* data, size_t size);
+
+// Первые size байтов PBKDF2 с iterations итерациями
+std::string pbkdf2Sha256(const void* password, size_t passwordSize, const void* salt, size_t saltSize,
+                         uint32_t iterations, size_t size);
+
+#endif
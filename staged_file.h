@@ -0,0 +1,76 @@
+#ifndef STAGED_FILE_H
+#define STAGED_FILE_H
+
+#include <filesystem>
+#include <string>
+#include <stdexcept>
+#include <system_error>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Файл результата, который пишется во временный файл рядом с целевым и
+// заменяет его переименованием только в commit(). До этого целевой файл не
+// тронут: вход, отображенный из того же файла, остается читаемым (после
+// rename отображение держит прежний inode), а при ошибке вместо обрезанного
+// результата остается прежний файл - временный удаляет деструктор. Если путь
+// существует и это не обычный файл (/dev/null, /dev/stdout), запись идет
+// прямо в него. Заголовочный, как MappedFile, - для программы и библиотек.
+class StagedFile {
+public:
+    explicit StagedFile(const std::string& target) : target_(target), path_(target) {
+        namespace fs = std::filesystem;
+        fs::path targetPath(target);
+        if (targetPath.has_parent_path()) fs::create_directories(targetPath.parent_path());
+
+        std::error_code error;
+        fs::file_status status = fs::status(targetPath, error);
+        if (fs::exists(status) && !fs::is_regular_file(status)) return;
+
+        std::string pattern = target + ".tmpXXXXXX";
+        int fd = mkstemp(&pattern[0]);
+        if (fd < 0) throw std::runtime_error("Ошибка: не удалось создать временный файл для " + target);
+        // mkstemp создает файл с правами 0600: права прежнего файла или
+        // обычные для нового (0666 без umask)
+        mode_t mode;
+        if (fs::exists(status)) {
+            mode = static_cast<mode_t>(status.permissions() & fs::perms::mask);
+        } else {
+            mode_t mask = umask(0);
+            umask(mask);
+            mode = 0666 & ~mask;
+        }
+        fchmod(fd, mode);
+        close(fd);
+        path_ = pattern;
+        staged_ = true;
+    }
+
+    ~StagedFile() {
+        if (staged_ && !committed_) unlink(path_.c_str());
+    }
+
+    // Куда писать результат
+    const std::string& path() const { return path_; }
+
+    // Замена целевого файла записанным результатом
+    void commit() {
+        if (committed_) return;
+        if (staged_ && std::rename(path_.c_str(), target_.c_str()) != 0) {
+            throw std::runtime_error("Ошибка: не удалось заменить файл: " + target_);
+        }
+        committed_ = true;
+    }
+
+    StagedFile(const StagedFile&) = delete;
+    StagedFile& operator=(const StagedFile&) = delete;
+
+private:
+    std::string target_;
+    std::string path_;
+    bool staged_ = false;
+    bool committed_ = false;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "text_model.h"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+namespace textmodel {
+
+namespace {
+
+// Частоты букв (в процентах) для встроенного эталона
+const double ENGLISH_FREQ[26] = {
+    8.17, 1.49, 2.78, 4.25, 12.70, 2.23, 2.02, 6.09, 6.97, 0.15, 0.77, 4.03, 2.41,
+    6.75, 7.51, 1.93, 0.10, 5.99, 6.33, 9.06, 2.76, 0.98, 2.36, 0.15, 1.97, 0.07
+};
+// а..я (U+0430..U+044F), ё учтена вместе с е
+const double RUSSIAN_FREQ[32] = {
+    8.01, 1.59, 4.54, 1.70, 2.98, 8.45, 0.94, 1.65, 7.35, 1.21, 3.49, 4.40, 3.21, 6.70, 10.97, 2.81,
+    4.73, 5.47, 6.26, 2.62, 0.26, 0.97, 0.48, 1.44, 0.73, 0.36, 0.04, 1.90, 1.74, 0.32, 0.64, 2.01
+};
+
+void addUtf8(array<double, 256>& weights, unsigned codePoint, double weight) {
+    weights[0xC0 | (codePoint >> 6)] += weight;
+    weights[0x80 | (codePoint & 0x3F)] += weight;
+}
+
+
+// Встроенные образцы текста для таблиц квадграмм
+const char* ENGLISH_CORPUS = R"(The old town stands on the bank of a wide river, and every morning the fishermen push their boats into the water before the sun rises over the hills. Most of the houses near the harbour were built more than two hundred years ago, and their walls still carry the marks of floods and storms. In the summer the streets are full of visitors who come to walk along the river, to eat fresh fish in the small restaurants and to listen to the music that plays in the square until late at night. In the winter the town becomes quiet again, the shops close early and the people who live there have time to talk to each other.
+My grandfather worked in the harbour for almost forty years. He used to say that the river was the real master of the town, because it decided when the boats could leave and when they had to stay at home. He knew the name of every captain and the history of every ship, and when he told those stories in the evening, the children would sit around the table without making a sound. He believed that a person should always finish the work he started, that a promise must be kept even when it becomes difficult, and that there is nothing shameful in asking for help.
+When I was a student, I spent a whole year in the capital, studying mathematics and living in a small room on the fifth floor of an old building. The city was loud and fast, and at first I found it hard to sleep because of the traffic and the voices in the street below my window. Later I learned to enjoy the noise, the long walks through the parks, the libraries that stayed open until midnight and the conversations with friends about books, science and the future. We were sure that we would change the world, although none of us knew exactly how.
+The history of writing is also the history of secret writing. As soon as people learned to record their thoughts on clay, stone or paper, they wanted to hide some of those thoughts from strangers. Generals sent orders that only their officers could read, merchants protected the prices of their goods, and lovers exchanged letters that their families were not supposed to understand. The simplest methods replaced each letter with another one, while other methods kept the letters unchanged but mixed up their order. A careful reader who knows which letters and which groups of letters are common in the language can often break such a cipher with nothing more than a pencil, a sheet of paper and a great deal of patience.
+Today computers do this work in a fraction of a second. They count how often each combination of letters appears, compare the result with the statistics of ordinary text and try thousands of possible keys until the message becomes readable. The same ideas are used to check spelling, to recognise speech and to translate from one language into another, which shows that the study of old ciphers is not only a game but also a useful way to understand how language works.)";
+
+const char* RUSSIAN_CORPUS = R"(Старый город стоит на берегу широкой реки, и каждое утро рыбаки выводят свои лодки на воду еще до того, как солнце поднимется над холмами. Большинство домов возле пристани построены больше двухсот лет назад, и на их стенах до сих пор видны следы наводнений и бурь. Летом улицы полны приезжих, которые гуляют вдоль реки, едят свежую рыбу в маленьких ресторанах и слушают музыку, которая играет на площади до поздней ночи. Зимой город снова становится тихим, магазины закрываются рано, а у людей, которые здесь живут, появляется время поговорить друг с другом.
+Мой дед проработал на пристани почти сорок лет. Он говорил, что настоящий хозяин города это река, потому что именно она решает, когда лодки могут уйти, а когда им придется остаться дома. Он знал имя каждого капитана и историю каждого судна, и когда вечером он рассказывал свои истории, дети сидели вокруг стола и не издавали ни звука. Он считал, что человек всегда должен доводить начатое дело до конца, что обещание нужно выполнять даже тогда, когда это трудно, и что нет ничего стыдного в том, чтобы попросить о помощи.
+Когда я был студентом, я провел целый год в столице, изучал математику и жил в маленькой комнате на пятом этаже старого дома. Город был шумным и быстрым, и сначала мне было трудно уснуть из за машин и голосов на улице под окном. Позже я научился любить этот шум, долгие прогулки по паркам, библиотеки, которые работали до полуночи, и разговоры с друзьями о книгах, науке и будущем. Мы были уверены, что изменим мир, хотя никто из нас точно не знал, как именно.
+История письменности это еще и история тайнописи. Как только люди научились записывать свои мысли на глине, камне или бумаге, им захотелось скрыть часть этих мыслей от чужих глаз. Полководцы отправляли приказы, которые могли прочитать только их офицеры, купцы берегли цены на свои товары, а влюбленные обменивались письмами, которые не должны были понять их родные. Самые простые способы заменяли каждую букву другой, а другие способы оставляли буквы прежними, но меняли их порядок. Внимательный читатель, который знает, какие буквы и сочетания букв часто встречаются в языке, нередко может разгадать такой шифр с помощью одного карандаша, листа бумаги и большого терпения.
+Сегодня компьютеры выполняют эту работу за доли секунды. Они считают, как часто встречается каждое сочетание букв, сравнивают результат со статистикой обычного текста и перебирают тысячи возможных ключей, пока сообщение не станет читаемым. Те же идеи используются для проверки орфографии, распознавания речи и перевода с одного языка на другой, а значит, изучение старых шифров это не только игра, но и полезный способ понять, как устроен язык.)";
+
+const int ENGLISH_LETTERS = 26;
+const int RUSSIAN_LETTERS = 32;
+
+// Перебор кодовых точек строки UTF-8 (некорректные байты - как есть)
+template <typename Func>
+void forEachCodePoint(const string& text, Func func) {
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = text[i];
+        size_t length = 1;
+        uint32_t codePoint = c;
+        if ((c & 0xE0) == 0xC0) { length = 2; codePoint = c & 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { length = 3; codePoint = c & 0x0F; }
+        else if ((c & 0xF8) == 0xF0) { length = 4; codePoint = c & 0x07; }
+
+        if (i + length > text.size()) { //обрезанная последовательность
+            length = 1;
+            codePoint = c;
+        }
+        for (size_t k = 1; k < length; ++k) {
+            codePoint = (codePoint << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+        }
+        func(codePoint);
+        i += length;
+    }
+}
+
+} // namespace
+
+// Распределение байтов смеси английского и русского текста в UTF-8
+array<double, 256> builtinByteReference() {
+    array<double, 256> english{};
+    for (int i = 0; i < 26; ++i) {
+        english['a' + i] += ENGLISH_FREQ[i] * 0.80 * 0.97;
+        english['A' + i] += ENGLISH_FREQ[i] * 0.80 * 0.03;
+    }
+    english[' '] += 17.0;
+    for (char c : string(".,\n-'\"")) english[static_cast<unsigned char>(c)] += 0.4;
+    for (char c = '0'; c <= '9'; ++c) english[static_cast<unsigned char>(c)] += 0.06;
+
+    array<double, 256> russian{};
+    for (int i = 0; i < 32; ++i) {
+        addUtf8(russian, 0x430 + i, RUSSIAN_FREQ[i] * 0.83 * 0.97);
+        addUtf8(russian, 0x410 + i, RUSSIAN_FREQ[i] * 0.83 * 0.03);
+    }
+    russian[' '] += 14.0;
+    for (char c : string(".,\n-")) russian[static_cast<unsigned char>(c)] += 0.5;
+    for (char c = '0'; c <= '9'; ++c) russian[static_cast<unsigned char>(c)] += 0.05;
+
+    double englishTotal = 0, russianTotal = 0;
+    for (int b = 0; b < 256; ++b) {
+        englishTotal += english[b];
+        russianTotal += russian[b];
+    }
+    array<double, 256> reference{};
+    for (int b = 0; b < 256; ++b) {
+        reference[b] = 0.5 * english[b] / englishTotal + 0.5 * russian[b] / russianTotal;
+    }
+    return reference;
+}
+
+// Логарифмы эталонных вероятностей (со сглаживанием невстречающихся байтов)
+array<double, 256> byteLogProbabilities(const string& sample) {
+    array<double, 256> reference{};
+    if (sample.empty()) {
+        reference = builtinByteReference();
+    } else {
+        for (unsigned char c : sample) reference[c] += 1.0;
+    }
+
+    double total = 0;
+    for (double v : reference) total += v;
+    const double floor = total * 1e-5;
+    array<double, 256> logs{};
+    for (int b = 0; b < 256; ++b) {
+        logs[b] = log((reference[b] + floor) / (total + 256 * floor));
+    }
+    return logs;
+}
+
+uint32_t decodeUtf8(const string& character) {
+    uint32_t result = 0;
+    bool first = true;
+    forEachCodePoint(character, [&](uint32_t codePoint) {
+        if (first) result = codePoint;
+        first = false;
+    });
+    return result;
+}
+
+Language detectLanguage(const string& utf8Text) {
+    size_t cyrillic = 0, latin = 0;
+    forEachCodePoint(utf8Text, [&](uint32_t codePoint) {
+        if ((codePoint >= 0x410 && codePoint <= 0x44F) || codePoint == 0x401 || codePoint == 0x451) ++cyrillic;
+        else if ((codePoint | 0x20) >= 'a' && (codePoint | 0x20) <= 'z') ++latin;
+    });
+    return cyrillic > latin ? Language::RUSSIAN : Language::ENGLISH;
+}
+
+QuadgramModel::QuadgramModel(Language language, const string& corpus)
+    : language_(language),
+      size_(language == Language::RUSSIAN ? RUSSIAN_LETTERS + 1 : ENGLISH_LETTERS + 1) {
+    string text = corpus;
+    if (text.empty()) text = language == Language::RUSSIAN ? RUSSIAN_CORPUS : ENGLISH_CORPUS;
+
+    vector<int> symbols;
+    forEachCodePoint(text, [&](uint32_t codePoint) { symbols.push_back(symbol(codePoint)); });
+
+    vector<uint32_t> counts(static_cast<size_t>(size_) * size_ * size_ * size_, 0);
+    double total = 0;
+    for (size_t i = 0; i + 3 < symbols.size(); ++i) {
+        counts[((symbols[i] * size_ + symbols[i + 1]) * size_ + symbols[i + 2]) * size_ + symbols[i + 3]]++;
+        total += 1;
+    }
+    if (total == 0) throw invalid_argument("Образец текста слишком короткий для таблицы квадграмм");
+
+    // Невстречавшиеся квадграммы получают малую, но ненулевую вероятность
+    const float floor = static_cast<float>(log10(0.01 / total));
+    table_.resize(counts.size());
+    for (size_t i = 0; i < counts.size(); ++i) {
+        table_[i] = counts[i] ? static_cast<float>(log10(counts[i] / total)) : floor;
+    }
+}
+
+double QuadgramModel::averageScore(const string& utf8Text) const {
+    int window[4];
+    size_t count = 0;
+    double total = 0;
+    forEachCodePoint(utf8Text, [&](uint32_t codePoint) {
+        window[count % 4] = symbol(codePoint);
+        if (++count >= 4) {
+            total += score(window[count % 4], window[(count + 1) % 4], window[(count + 2) % 4], window[(count + 3) % 4]);
+        }
+    });
+    return count >= 4 ? total / (count - 3) : 0;
+}
+
+int QuadgramModel::symbol(uint32_t codePoint) const {
+    if (language_ == Language::RUSSIAN) {
+        if (codePoint == 0x401 || codePoint == 0x451) return 5; //ё как е
+        if (codePoint >= 0x430 && codePoint <= 0x44F) return codePoint - 0x430;
+        if (codePoint >= 0x410 && codePoint <= 0x42F) return codePoint - 0x410;
+        return RUSSIAN_LETTERS;
+    }
+    if (codePoint >= 'a' && codePoint <= 'z') return codePoint - 'a';
+    if (codePoint >= 'A' && codePoint <= 'Z') return codePoint - 'A';
+    return ENGLISH_LETTERS;
+}
+
+} // namespace textmodel
@@ -0,0 +1,58 @@
+#ifndef TEXT_MODEL_H
+#define TEXT_MODEL_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Общая модель открытого текста для криптоанализа (компилируется в библиотеки шифров)
+namespace textmodel {
+
+// Распределение байтов смеси английского и русского текста в UTF-8
+std::array<double, 256> builtinByteReference();
+
+// Логарифмы вероятностей байтов по образцу открытого текста
+// (пустой образец - встроенное распределение), со сглаживанием
+std::array<double, 256> byteLogProbabilities(const std::string& sample);
+
+enum class Language {
+    ENGLISH,
+    RUSSIAN
+};
+
+// Кодовая точка одного символа UTF-8 (как их выделяет utf8_split)
+uint32_t decodeUtf8(const std::string& character);
+
+// Язык текста по преобладанию кириллических или латинских букв
+Language detectLanguage(const std::string& utf8Text);
+
+// Таблица логарифмов частот квадграмм (четверок символов). Алфавит -
+// буквы языка без учета регистра и один общий символ для всего остального.
+class QuadgramModel {
+public:
+    // corpus - образец текста в UTF-8 (пустой - встроенный образец языка)
+    QuadgramModel(Language language, const std::string& corpus);
+
+    int alphabetSize() const { return size_; }
+
+    // Номер символа в алфавите модели
+    int symbol(uint32_t codePoint) const;
+
+    float score(int a, int b, int c, int d) const {
+        return table_[((a * size_ + b) * size_ + c) * size_ + d];
+    }
+
+    // Средняя оценка квадграмм текста UTF-8 (0, если в нем меньше 4 символов) -
+    // для сравнения вариантов расшифровки одного шифртекста
+    double averageScore(const std::string& utf8Text) const;
+
+private:
+    Language language_;
+    int size_;
+    std::vector<float> table_;
+};
+
+} // namespace textmodel
+
+#endif
@@ -0,0 +1,188 @@
+#include "trace.h"
+
+#ifdef RGR_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Событий в буфере одного потока (около 2 МиБ на поток)
+const size_t TRACE_CAPACITY = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    int64_t begin; //нс от включения трассировки
+    int64_t duration;
+    uint64_t bytes;
+};
+
+// Буфер одного потока. Пишет только владелец; count публикуется после
+// записи события, поэтому выгрузка видит только записанные события.
+struct ThreadTrace {
+    unique_ptr<TraceEvent[]> events{new TraceEvent[TRACE_CAPACITY]};
+    atomic<uint64_t> count{0};
+    atomic<const char*> name{nullptr};
+    unsigned tid = 0;
+};
+
+// События завершившегося потока: только записанные, без кольцевого буфера
+struct FinishedTrace {
+    vector<TraceEvent> events;
+    const char* name;
+    unsigned tid;
+    uint64_t lost;
+};
+
+// Буферы работающих потоков и события завершившихся: при выходе из потока
+// его события переносятся в g_finished, а буфер освобождается, поэтому
+// память не растет на размер буфера с каждым созданным потоком
+mutex g_threadsMutex;
+vector<ThreadTrace*> g_live;
+vector<FinishedTrace> g_finished;
+atomic<unsigned> g_threads{0};
+atomic<bool> g_enabled{false};
+TraceTime g_epoch;
+string g_path;
+
+// Владелец буфера потока; для главного потока деструктор срабатывает при
+// выходе до выгрузки из atexit
+struct LocalTrace {
+    ThreadTrace* trace = nullptr;
+
+    ~LocalTrace() {
+        if (!trace) return;
+        uint64_t count = trace->count.load(memory_order_relaxed);
+        uint64_t first = count > TRACE_CAPACITY ? count - TRACE_CAPACITY : 0;
+        FinishedTrace finished{{}, trace->name.load(memory_order_relaxed), trace->tid, first};
+        finished.events.reserve(count - first);
+        for (uint64_t i = first; i < count; ++i) finished.events.push_back(trace->events[i % TRACE_CAPACITY]);
+
+        lock_guard<mutex> lock(g_threadsMutex);
+        g_finished.push_back(move(finished));
+        g_live.erase(find(g_live.begin(), g_live.end(), trace));
+        delete trace;
+    }
+};
+
+ThreadTrace& localTrace() {
+    thread_local LocalTrace local;
+    if (!local.trace) {
+        unique_ptr<ThreadTrace> trace(new ThreadTrace());
+        trace->tid = ++g_threads;
+        lock_guard<mutex> lock(g_threadsMutex);
+        g_live.push_back(trace.get());
+        local.trace = trace.release();
+    }
+    return *local.trace;
+}
+
+int64_t sinceEpoch(TraceTime time) {
+    return chrono::duration_cast<chrono::nanoseconds>(time - g_epoch).count();
+}
+
+// Имена - литералы программы, но кавычки и \ экранируются на всякий случай
+void writeString(ostream& out, const char* text) {
+    out << '"';
+    for (const char* p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') out << '\\';
+        out << *p;
+    }
+    out << '"';
+}
+
+void dumpAtExit() {
+    traceDump();
+}
+
+} // namespace
+
+void traceEnable(const string& path) {
+    g_epoch = chrono::steady_clock::now();
+    g_path = path;
+    localTrace().name = "main";
+    g_enabled.store(true, memory_order_release);
+    atexit(dumpAtExit);
+}
+
+bool traceEnabled() {
+    return g_enabled.load(memory_order_relaxed);
+}
+
+void traceRecord(const char* name, const char* category, TraceTime begin, TraceTime end, uint64_t bytes) {
+    ThreadTrace& trace = localTrace();
+    uint64_t count = trace.count.load(memory_order_relaxed);
+    TraceEvent& event = trace.events[count % TRACE_CAPACITY];
+    event.name = name;
+    event.category = category;
+    event.begin = sinceEpoch(begin);
+    event.duration = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+    event.bytes = bytes;
+    trace.count.store(count + 1, memory_order_release);
+}
+
+void traceThreadName(const char* name) {
+    if (traceEnabled()) localTrace().name.store(name, memory_order_relaxed);
+}
+
+// Полные события ("ph":"X") - начало и длительность в одной записи, поэтому
+// вытеснение старых событий из кольца не оставляет непарных начал и концов
+void traceDump() {
+    if (!traceEnabled()) return;
+    ofstream out(g_path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Ошибка: не удалось записать трассировку в " << g_path << endl;
+        return;
+    }
+    const int pid = static_cast<int>(getpid());
+    uint64_t lost = 0;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << fixed << setprecision(3);
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"rgr\"}}";
+    // Сначала метаданные потока, затем его события начиная с first
+    auto writeThread = [&](const char* name, unsigned tid) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << (name ? name : "worker") << " " << tid << "\"}}";
+        out << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid
+            << ",\"args\":{\"sort_index\":" << tid << "}}";
+    };
+    auto writeEvent = [&](const TraceEvent& event, unsigned tid) {
+        out << ",\n{\"name\":";
+        writeString(out, event.name);
+        out << ",\"cat\":";
+        writeString(out, event.category);
+        out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+            << ",\"ts\":" << event.begin / 1e3 << ",\"dur\":" << event.duration / 1e3;
+        if (event.bytes) out << ",\"args\":{\"bytes\":" << event.bytes << "}";
+        out << "}";
+    };
+
+    lock_guard<mutex> lock(g_threadsMutex);
+    for (const FinishedTrace& trace : g_finished) {
+        writeThread(trace.name, trace.tid);
+        lost += trace.lost;
+        for (const TraceEvent& event : trace.events) writeEvent(event, trace.tid);
+    }
+    for (ThreadTrace* trace : g_live) {
+        writeThread(trace->name.load(memory_order_relaxed), trace->tid);
+        uint64_t count = trace->count.load(memory_order_acquire);
+        uint64_t first = count > TRACE_CAPACITY ? count - TRACE_CAPACITY : 0;
+        lost += first;
+        for (uint64_t i = first; i < count; ++i) writeEvent(trace->events[i % TRACE_CAPACITY], trace->tid);
+    }
+    out << "\n]}\n";
+    if (!out.flush()) cerr << "Ошибка: не удалось записать трассировку в " << g_path << endl;
+    if (lost) cerr << "Предупреждение: трассировка переполнена, потеряно ранних событий: " << lost << endl;
+}
+
+#endif // RGR_TRACE
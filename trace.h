@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Трассировка этапов конвейера (чтение, загрузка ключа, шифрование
+// фрагментов, сжатие, запись) с выгрузкой в формате Chrome Trace Event
+// (открывается в chrome://tracing или ui.perfetto.dev): на временной шкале
+// каждого потока видно, где этапы перекрываются и где поток простаивает.
+// Собирается только с -DRGR_TRACE (make TRACE=1); без него макросы
+// раскрываются в пустые операторы и программа не содержит кода трассировки.
+//
+// Каждый поток пишет события в свой кольцевой буфер без блокировок (при
+// переполнении теряются самые старые). При завершении потока его события
+// переносятся в общий список, а буфер освобождается; все выгружается при выходе.
+
+#ifdef RGR_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+typedef std::chrono::steady_clock::time_point TraceTime;
+
+// Включение трассировки с выгрузкой в path при выходе.
+// Вызывать до создания других потоков.
+void traceEnable(const std::string& path);
+
+bool traceEnabled();
+
+// Событие [begin, end) текущего потока; name и category - строки со
+// статическим временем жизни (в буфер попадает только указатель)
+void traceRecord(const char* name, const char* category, TraceTime begin, TraceTime end, uint64_t bytes = 0);
+
+// Имя текущего потока на временной шкале (к нему добавляется номер потока)
+void traceThreadName(const char* name);
+
+// Выгрузка буферов всех потоков (вызывается при выходе)
+void traceDump();
+
+// Событие на время жизни объекта
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category, uint64_t bytes = 0)
+        : name_(name), category_(category), bytes_(bytes), start_(std::chrono::steady_clock::now()) {}
+
+    ~TraceScope() {
+        if (traceEnabled()) traceRecord(name_, category_, start_, std::chrono::steady_clock::now(), bytes_);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    const char* category_;
+    uint64_t bytes_;
+    TraceTime start_;
+};
+
+#define RGR_TRACE_JOIN2(a, b) a##b
+#define RGR_TRACE_JOIN(a, b) RGR_TRACE_JOIN2(a, b)
+// RGR_TRACE_SCOPE(имя, категория[, байты]) - событие до конца блока
+#define RGR_TRACE_SCOPE(...) TraceScope RGR_TRACE_JOIN(traceScope_, __LINE__)(__VA_ARGS__)
+#define RGR_TRACE_THREAD(name) traceThreadName(name)
+
+#else
+
+#define RGR_TRACE_SCOPE(...) ((void)0)
+#define RGR_TRACE_THREAD(name) ((void)0)
+
+#endif // RGR_TRACE
+
+#endif // TRACE_H
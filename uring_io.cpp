@@ -0,0 +1,340 @@
+#include "uring_io.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const unsigned QUEUE_DEPTH = 32;               // блоков одновременно в полете
+const size_t IO_BLOCK = 1 << 20;               // размер блока и буфера
+const size_t DIRECT_ALIGN = 4096;              // выравнивание для O_DIRECT
+const uint64_t DIRECT_THRESHOLD = 64ULL << 20; // файлы от этого размера - с O_DIRECT
+
+// Кольца отправки и завершения, отображенные из ядра
+class Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) throw runtime_error(string("io_uring_setup: ") + strerror(errno));
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) sqRingSize_ = cqRingSize_ = max(sqRingSize_, cqRingSize_);
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+
+        sqRing_ = mapRegion(sqRingSize_, IORING_OFF_SQ_RING);
+        cqRing_ = singleMmap ? sqRing_ : mapRegion(cqRingSize_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe*>(mapRegion(sqesSize_, IORING_OFF_SQES));
+        if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+            int error = errno;
+            release();
+            throw runtime_error(string("io_uring mmap: ") + strerror(error));
+        }
+
+        char* sq = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        entries_ = params.sq_entries;
+        tail_ = *sqTail_;
+    }
+
+    ~Ring() { release(); }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    void registerBuffers(const vector<iovec>& buffers) {
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers.data(),
+                    static_cast<unsigned>(buffers.size())) < 0) {
+            throw runtime_error(string("io_uring_register: ") + strerror(errno));
+        }
+    }
+
+    // Очищенная запись очереди отправки (nullptr - очередь заполнена)
+    io_uring_sqe* nextSqe() {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (tail_ - head >= entries_) return nullptr;
+        unsigned index = tail_ & sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        ++tail_;
+        return sqe;
+    }
+
+    // Отправка подготовленных записей и ожидание minComplete завершений
+    void submit(unsigned minComplete) {
+        __atomic_store_n(sqTail_, tail_, __ATOMIC_RELEASE);
+        unsigned pending = tail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+        while (syscall(__NR_io_uring_enter, fd_, pending, minComplete, flags, nullptr, 0) < 0) {
+            if (errno != EINTR) throw runtime_error(string("io_uring_enter: ") + strerror(errno));
+        }
+    }
+
+    bool popCompletion(uint64_t& userData, int& result) {
+        unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        userData = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* mapRegion(size_t size, off_t offset) {
+        return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    }
+
+    void release() {
+        if (sqes_ && sqes_ != MAP_FAILED) munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != MAP_FAILED && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqRing_ && sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        sqes_ = nullptr;
+        cqRing_ = sqRing_ = nullptr;
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqRingSize_ = 0, cqRingSize_ = 0, sqesSize_ = 0;
+    unsigned *sqHead_ = nullptr, *sqTail_ = nullptr, *sqArray_ = nullptr, sqMask_ = 0;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr, cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned entries_ = 0;
+    unsigned tail_ = 0; // хвост очереди отправки, еще не переданный ядру
+};
+
+// Открытые файлы задания (закрываются при выходе из области видимости)
+struct OpenFile {
+    int fd = -1;
+    bool direct = false;
+    uint64_t size = 0;
+};
+
+struct OpenFiles {
+    vector<OpenFile> files;
+    ~OpenFiles() {
+        for (const OpenFile& file : files) {
+            if (file.fd >= 0) close(file.fd);
+        }
+    }
+};
+
+// Часть файла, которая читается или пишется одним запросом
+struct Block {
+    size_t file;
+    uint64_t offset;
+    size_t length;
+};
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Блоки файлов по IO_BLOCK
+deque<Block> splitBlocks(const vector<OpenFile>& files) {
+    deque<Block> blocks;
+    for (size_t f = 0; f < files.size(); ++f) {
+        for (uint64_t offset = 0; offset < files[f].size; offset += IO_BLOCK) {
+            blocks.push_back({f, offset, static_cast<size_t>(min<uint64_t>(IO_BLOCK, files[f].size - offset))});
+        }
+    }
+    return blocks;
+}
+
+// Прогон блоков через кольцо. prepare(block, buffer) вызывается перед
+// отправкой (для записи - копирование данных в буфер), complete(block, buffer,
+// bytes) - после завершения. Недочитанный или недописанный остаток блока
+// отправляется снова. При ошибке новые блоки не отправляются, а после
+// завершения уже отправленных выбрасывается исключение.
+template <typename Prepare, typename Complete>
+void runBlocks(const vector<OpenFile>& files, const vector<string>& names, deque<Block> blocks, bool write,
+               Prepare prepare, Complete complete) {
+    if (blocks.empty()) return;
+    unsigned depth = static_cast<unsigned>(min<size_t>(QUEUE_DEPTH, blocks.size()));
+
+    void* memory = nullptr;
+    if (posix_memalign(&memory, DIRECT_ALIGN, depth * IO_BLOCK) != 0) throw bad_alloc();
+    unique_ptr<char, void (*)(void*)> pool(static_cast<char*>(memory), free);
+
+    Ring ring(depth);
+    vector<iovec> buffers(depth);
+    for (unsigned slot = 0; slot < depth; ++slot) buffers[slot] = {pool.get() + slot * IO_BLOCK, IO_BLOCK};
+    ring.registerBuffers(buffers);
+
+    vector<Block> slotBlock(depth);
+    vector<unsigned> freeSlots;
+    for (unsigned slot = depth; slot > 0; --slot) freeSlots.push_back(slot - 1);
+    unsigned inflight = 0;
+    int error = 0;
+    size_t errorFile = 0;
+
+    while ((error == 0 && !blocks.empty()) || inflight > 0) {
+        while (error == 0 && !blocks.empty() && !freeSlots.empty()) {
+            io_uring_sqe* sqe = ring.nextSqe();
+            if (!sqe) break;
+            unsigned slot = freeSlots.back();
+            freeSlots.pop_back();
+            Block block = blocks.front();
+            blocks.pop_front();
+
+            char* buffer = pool.get() + slot * IO_BLOCK;
+            const OpenFile& file = files[block.file];
+            prepare(block, buffer);
+            sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->fd = file.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(buffer);
+            sqe->len = static_cast<uint32_t>(file.direct ? alignUp(block.length, DIRECT_ALIGN) : block.length);
+            sqe->off = block.offset;
+            sqe->buf_index = static_cast<uint16_t>(slot);
+            sqe->user_data = slot;
+            slotBlock[slot] = block;
+            ++inflight;
+        }
+
+        ring.submit(inflight > 0 ? 1 : 0);
+        uint64_t slot;
+        int result;
+        while (ring.popCompletion(slot, result)) {
+            Block block = slotBlock[slot];
+            --inflight;
+            freeSlots.push_back(static_cast<unsigned>(slot));
+            if (result <= 0) {
+                //0 байт - файл укоротился во время чтения
+                if (error == 0) {
+                    error = result < 0 ? -result : EIO;
+                    errorFile = block.file;
+                }
+                continue;
+            }
+            size_t done = min<size_t>(static_cast<size_t>(result), block.length);
+            complete(block, pool.get() + slot * IO_BLOCK, done);
+            if (done < block.length) blocks.push_front({block.file, block.offset + done, block.length - done});
+        }
+    }
+
+    if (error != 0) {
+        throw runtime_error(string(write ? "Ошибка записи в файл: " : "Ошибка чтения файла: ")
+                            + names[errorFile] + ": " + strerror(error));
+    }
+}
+
+} // namespace
+
+bool uringSupported() {
+    static const bool supported = [] {
+        try {
+            Ring ring(2);
+            return true;
+        } catch (const exception&) {
+            return false; //ядро без io_uring или вызов запрещен
+        }
+    }();
+    return supported;
+}
+
+vector<string> uringReadFiles(const vector<string>& filenames) {
+    OpenFiles open_;
+    vector<OpenFile>& files = open_.files;
+    for (const string& name : filenames) {
+        OpenFile file;
+        file.fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        files.push_back(file);
+        struct stat st;
+        if (file.fd < 0 || fstat(file.fd, &st) != 0) {
+            throw runtime_error("Ошибка: файл не существует или недоступен: " + name);
+        }
+        files.back().size = static_cast<uint64_t>(st.st_size);
+
+        // Большой файл читается мимо кэша страниц, если файловая система позволяет
+        if (files.back().size >= DIRECT_THRESHOLD) {
+            int direct = open(name.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+            if (direct >= 0) {
+                close(files.back().fd);
+                files.back().fd = direct;
+                files.back().direct = true;
+            }
+        }
+    }
+
+    vector<string> contents(files.size());
+    for (size_t f = 0; f < files.size(); ++f) contents[f].resize(files[f].size);
+    runBlocks(files, filenames, splitBlocks(files), false,
+              [](const Block&, char*) {},
+              [&](const Block& block, const char* buffer, size_t bytes) {
+                  memcpy(&contents[block.file][block.offset], buffer, bytes);
+              });
+    return contents;
+}
+
+void uringWriteFiles(const vector<string>& filenames, const vector<const string*>& contents) {
+    if (filenames.size() != contents.size()) throw invalid_argument("Число файлов и данных не совпадает");
+
+    OpenFiles open_;
+    vector<OpenFile>& files = open_.files;
+    for (size_t f = 0; f < filenames.size(); ++f) {
+        const char* name = filenames[f].c_str();
+        OpenFile file;
+        file.size = contents[f]->size();
+        file.direct = file.size >= DIRECT_THRESHOLD;
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        file.fd = file.direct ? open(name, flags | O_DIRECT, 0644) : -1;
+        if (file.fd < 0) {
+            file.direct = false;
+            file.fd = open(name, flags, 0644);
+        }
+        files.push_back(file);
+        if (file.fd < 0) throw runtime_error("Ошибка: не удалось создать файл или директорию: " + filenames[f]);
+
+        // Место выделяется заранее одним экстентом; не все файловые системы умеют
+        if (file.size > 0) fallocate(file.fd, 0, 0, static_cast<off_t>(file.size));
+    }
+
+    runBlocks(files, filenames, splitBlocks(files), true,
+              [&](const Block& block, char* buffer) {
+                  memcpy(buffer, contents[block.file]->data() + block.offset, block.length);
+                  if (files[block.file].direct) {
+                      //O_DIRECT пишет блоками по DIRECT_ALIGN, хвост обрезается ниже
+                      memset(buffer + block.length, 0, alignUp(block.length, DIRECT_ALIGN) - block.length);
+                  }
+              },
+              [](const Block&, const char*, size_t) {});
+
+    for (size_t f = 0; f < files.size(); ++f) {
+        if (files[f].direct && ftruncate(files[f].fd, static_cast<off_t>(files[f].size)) != 0) {
+            throw runtime_error("Ошибка записи в файл: " + filenames[f]);
+        }
+        int fd = files[f].fd;
+        files[f].fd = -1;
+        if (close(fd) != 0) throw runtime_error("Ошибка записи в файл: " + filenames[f]);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include <string>
+#include <vector>
+
+// Файловый ввод-вывод через io_uring (системные вызовы напрямую, без liburing).
+// Файл делится на блоки, до 32 блоков по 1 МиБ одновременно в полете
+// в зарегистрированных буферах; выходной файл заранее размечается fallocate,
+// большие файлы открываются с O_DIRECT (если файловая система позволяет).
+
+// Ядро поддерживает io_uring (проверяется один раз)
+bool uringSupported();
+
+// Чтение файлов целиком; блоки всех файлов читаются вперемешку
+std::vector<std::string> uringReadFiles(const std::vector<std::string>& filenames);
+
+// Запись файлов целиком (files[i] - имя, contents[i] - данные)
+void uringWriteFiles(const std::vector<std::string>& filenames, const std::vector<const std::string*>& contents);
+
+#endif
@@ -1,36 +1,207 @@
 #include "vigenere.h"
+#include "mapped_file.h"
+#include "staged_file.h"
+#include "kernel_table.h"
 #include <algorithm>
+#include <vector>
 #include <random>
 #include <fstream>
 #include <stdexcept>
 #include <filesystem>
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 namespace fs = std::filesystem;
 
-// Шифрование/дешифрование бинарных данных
-string vigenereProcess(const string& data, const string& key, bool decrypt) {
-    if (key.empty()) throw invalid_argument("Ключ не может быть пустым");
-    
-    string result;
-    result.reserve(data.size()); // резерв памяти
-    
-    for (size_t i = 0; i < data.size(); ++i) {
-        unsigned char dataByte = data[i];
-        unsigned char keyByte = key[i % key.size()];
-        
-        // Побайтовый сдвиг по модулю 256
-        int shift = keyByte; 
-        if (decrypt) shift = -shift;
-        
-        int resultByte = (dataByte + shift) % 256; //основа шифрования (формула)
-        if (resultByte < 0) resultByte += 256;
-        
-        result += static_cast<char>(resultByte); // коррекция отрицательных
+// Отрезок потока, который обрабатывается за раз при ключе в файле
+const size_t STREAM_CHUNK = 8 << 20;
+
+// Ключ-зерно: магия и 128 бит зерна; байты гаммы вычисляются по позиции
+const char SEED_MAGIC[8] = {'R', 'G', 'R', 'V', 'S', 'E', 'E', 'D'};
+const size_t SEED_KEY_SIZE = sizeof(SEED_MAGIC) + 16;
+
+// Гамма генерируется плитками, которые помещаются в L1
+const size_t KEYSTREAM_TILE = 4096;
+
+// Сообщения пакета не длиннее плитки собираются в нее вплотную
+const size_t BATCH_TILE = 16384;
+
+bool isSeedKey(const char* key, size_t keySize) {
+    return keySize == SEED_KEY_SIZE && memcmp(key, SEED_MAGIC, sizeof(SEED_MAGIC)) == 0;
+}
+
+// Финализатор SplitMix64
+inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Блок гаммы номер counter (8 байтов) зависит только от зерна и номера,
+// поэтому гамма с любой позиции вычисляется сразу, без прохода от начала
+inline uint64_t keystreamBlock(uint64_t seed0, uint64_t seed1, uint64_t counter) {
+    return mix64(mix64(seed0 + counter * 0x9E3779B97F4A7C15ULL) ^ seed1);
+}
+
+typedef void (*KeystreamFunc)(uint64_t, uint64_t, uint64_t, size_t, uint64_t*);
+
+void keystreamScalar(uint64_t seed0, uint64_t seed1, uint64_t first, size_t count, uint64_t* out) {
+    for (size_t i = 0; i < count; ++i) out[i] = keystreamBlock(seed0, seed1, first + i);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx512f,avx512dq")))
+inline __m512i mix64Avx512(__m512i x) {
+    const __m512i m1 = _mm512_set1_epi64(static_cast<long long>(0xBF58476D1CE4E5B9ULL));
+    const __m512i m2 = _mm512_set1_epi64(static_cast<long long>(0x94D049BB133111EBULL));
+    x = _mm512_mullo_epi64(_mm512_xor_si512(x, _mm512_srli_epi64(x, 30)), m1);
+    x = _mm512_mullo_epi64(_mm512_xor_si512(x, _mm512_srli_epi64(x, 27)), m2);
+    return _mm512_xor_si512(x, _mm512_srli_epi64(x, 31));
+}
+
+// Восемь блоков за раз: 64-битное умножение есть только в AVX-512DQ
+__attribute__((target("avx512f,avx512dq")))
+void keystreamAvx512(uint64_t seed0, uint64_t seed1, uint64_t first, size_t count, uint64_t* out) {
+    const __m512i gamma = _mm512_set1_epi64(static_cast<long long>(0x9E3779B97F4A7C15ULL));
+    const __m512i s0 = _mm512_set1_epi64(static_cast<long long>(seed0));
+    const __m512i s1 = _mm512_set1_epi64(static_cast<long long>(seed1));
+
+    __m512i counter = _mm512_add_epi64(_mm512_set1_epi64(static_cast<long long>(first)),
+                                       _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+    const __m512i eight = _mm512_set1_epi64(8);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i x = mix64Avx512(_mm512_add_epi64(s0, _mm512_mullo_epi64(counter, gamma)));
+        _mm512_storeu_si512(out + i, mix64Avx512(_mm512_xor_si512(x, s1)));
+        counter = _mm512_add_epi64(counter, eight);
+    }
+    keystreamScalar(seed0, seed1, first + i, count - i, out + i);
+}
+#endif
+
+KernelTable<KeystreamFunc>& keystreamKernels() {
+    static KernelTable<KeystreamFunc> table({
+        {"scalar", keystreamScalar, true},
+#if defined(__x86_64__)
+        {"avx512", keystreamAvx512, __builtin_cpu_supports("avx512dq") != 0},
+#endif
+    });
+    return table;
+}
+
+typedef void (*ShiftFunc)(const unsigned char*, const unsigned char*, size_t, bool, unsigned char*);
+
+// Сдвиг n байтов in на байты k (арифметика unsigned char - по модулю 256)
+void shiftScalar(const unsigned char* in, const unsigned char* k, size_t n, bool decrypt, unsigned char* out) {
+    if (decrypt) {
+        for (size_t i = 0; i < n; ++i) out[i] = static_cast<unsigned char>(in[i] - k[i]);
+    } else {
+        for (size_t i = 0; i < n; ++i) out[i] = static_cast<unsigned char>(in[i] + k[i]);
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+void shiftAvx2(const unsigned char* in, const unsigned char* k, size_t n, bool decrypt, unsigned char* out) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(k + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), decrypt ? _mm256_sub_epi8(x, y) : _mm256_add_epi8(x, y));
+    }
+    shiftScalar(in + i, k + i, n - i, decrypt, out + i);
+}
+
+// 64 байта за итерацию, хвост - под маской без скалярного цикла
+__attribute__((target("avx512f,avx512bw")))
+void shiftAvx512(const unsigned char* in, const unsigned char* k, size_t n, bool decrypt, unsigned char* out) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512(in + i), y = _mm512_loadu_si512(k + i);
+        _mm512_storeu_si512(out + i, decrypt ? _mm512_sub_epi8(x, y) : _mm512_add_epi8(x, y));
+    }
+    if (i < n) {
+        __mmask64 mask = (1ULL << (n - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(mask, in + i), y = _mm512_maskz_loadu_epi8(mask, k + i);
+        _mm512_mask_storeu_epi8(out + i, mask, decrypt ? _mm512_sub_epi8(x, y) : _mm512_add_epi8(x, y));
+    }
+}
+#endif
+
+KernelTable<ShiftFunc>& shiftKernels() {
+    static KernelTable<ShiftFunc> table({
+        {"scalar", shiftScalar, true},
+#if defined(__x86_64__)
+        {"avx2", shiftAvx2, __builtin_cpu_supports("avx2") != 0},
+        {"avx512", shiftAvx512, __builtin_cpu_supports("avx512bw") != 0},
+#endif
+    });
+    return table;
+}
+
+// Шифрование гаммой из зерна: байт позиции p - байт p % 8 блока p / 8
+void applySeeded(const unsigned char* in, size_t size, const char* key, uint64_t offset, bool decrypt,
+                 unsigned char* out) {
+    const KeystreamFunc keystream = keystreamKernels().get(size);
+    const ShiftFunc shift = shiftKernels().get(size);
+    uint64_t seed0, seed1;
+    memcpy(&seed0, key + sizeof(SEED_MAGIC), 8);
+    memcpy(&seed1, key + sizeof(SEED_MAGIC) + 8, 8);
+
+    uint64_t blocks[KEYSTREAM_TILE / 8 + 1];
+    for (size_t done = 0; done < size;) {
+        uint64_t position = offset + done;
+        size_t skip = static_cast<size_t>(position % 8);
+        size_t run = min(size - done, KEYSTREAM_TILE);
+        keystream(seed0, seed1, position / 8, (skip + run + 7) / 8, blocks);
+        const unsigned char* k = reinterpret_cast<const unsigned char*>(blocks) + skip; //little-endian
+        shift(in + done, k, run, decrypt, out + done);
+        done += run;
+    }
+}
+
+// Сдвиг байтов data на байты ключа, начиная с позиции offset исходного
+// потока (байт ключа зависит только от позиции); out может совпадать с data
+void vigenereApply(const char* data, size_t size, const char* key, size_t keySize, uint64_t offset,
+                   bool decrypt, char* out) {
+    if (keySize == 0) throw invalid_argument("Ключ не может быть пустым");
+
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* k = reinterpret_cast<const unsigned char*>(key);
+    unsigned char* o = reinterpret_cast<unsigned char*>(out);
+    if (isSeedKey(key, keySize)) {
+        applySeeded(in, size, key, offset, decrypt, o);
+        return;
+    }
+
+    const ShiftFunc shift = shiftKernels().get(size);
+    size_t keyPos = offset % keySize;
+    // Ключ проходится непрерывными отрезками, без остатка от деления на каждый байт
+    for (size_t done = 0; done < size;) {
+        size_t run = min(size - done, keySize - keyPos);
+        shift(in + done, k + keyPos, run, decrypt, o + done);
+        done += run;
+        keyPos = 0;
     }
+}
+
+// Шифрование/дешифрование бинарных данных, начинающихся со смещения offset
+string vigenereProcessAt(const string& data, const string& key, uint64_t offset, bool decrypt) {
+    if (key.empty()) throw invalid_argument("Ключ не может быть пустым");
+
+    string result(data.size(), '\0');
+    vigenereApply(data.data(), data.size(), key.data(), key.size(), offset, decrypt, &result[0]);
     return result;
 }
 
+// Шифрование/дешифрование бинарных данных
+string vigenereProcess(const string& data, const string& key, bool decrypt) {
+    return vigenereProcessAt(data, key, 0, decrypt);
+}
+
 // Шифрование
 string vigenereEncrypt(const string& data, const string& key) {
     return vigenereProcess(data, key, false);
@@ -41,6 +212,139 @@ string vigenereDecrypt(const string& ciphertext, const string& key) {
     return vigenereProcess(ciphertext, key, true);
 }
 
+// Шифрование фрагмента, который начинается со смещения offset
+string vigenereEncryptAt(const string& data, const string& key, uint64_t offset) {
+    return vigenereProcessAt(data, key, offset, false);
+}
+
+// Дешифрование фрагмента, который начинается со смещения offset
+string vigenereDecryptAt(const string& ciphertext, const string& key, uint64_t offset) {
+    return vigenereProcessAt(ciphertext, key, offset, true);
+}
+
+// Пакет: сообщения не длиннее BATCH_TILE копируются в буфер результата вплотную,
+// рядом в плитку копируется начало гаммы их ключа, и вся плитка сдвигается
+// одним проходом - 64-байтные регистры заполнены и при 16-байтных сообщениях.
+// Гамма каждого ключа (повторенный ключ или развернутое зерно) строится один раз.
+CipherBatch vigenereProcessBatch(const CipherMessage* messages, size_t count,
+                                 const string* keys, size_t keyCount, bool decrypt) {
+    CipherBatch batch;
+    batch.offsets.assign(count + 1, 0);
+    vector<size_t> longest(keyCount, 0);
+    for (size_t i = 0; i < count; ++i) {
+        if (messages[i].key >= keyCount) throw out_of_range("Сообщение пакета ссылается на несуществующий ключ");
+        if (keys[messages[i].key].empty()) throw invalid_argument("Ключ не может быть пустым");
+        batch.offsets[i + 1] = batch.offsets[i] + messages[i].size;
+        if (messages[i].size <= BATCH_TILE) longest[messages[i].key] = max(longest[messages[i].key], messages[i].size);
+    }
+    batch.arena.resize(batch.offsets[count]);
+    unsigned char* arena = reinterpret_cast<unsigned char*>(&batch.arena[0]);
+
+    // Гамма ключа k на длину самого длинного короткого сообщения с этим ключом:
+    // шифрование нулей дает ее для обоих видов ключа
+    vector<string> streams(keyCount);
+    for (size_t k = 0; k < keyCount; ++k) {
+        if (longest[k] == 0) continue;
+        streams[k].assign(longest[k], '\0');
+        vigenereApply(streams[k].data(), longest[k], keys[k].data(), keys[k].size(), 0, false, &streams[k][0]);
+    }
+
+    const ShiftFunc shift = shiftKernels().get(BATCH_TILE);
+    vector<unsigned char> tile(BATCH_TILE);
+    uint64_t tileStart = 0, tileEnd = 0;
+    auto flush = [&] {
+        shift(arena + tileStart, tile.data(), tileEnd - tileStart, decrypt, arena + tileStart);
+        tileStart = tileEnd;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        const CipherMessage& message = messages[i];
+        if (message.size == 0) continue;
+        if (message.size > BATCH_TILE) {
+            flush();
+            const string& key = keys[message.key];
+            vigenereApply(message.data, message.size, key.data(), key.size(), 0, decrypt,
+                          &batch.arena[batch.offsets[i]]);
+            tileStart = tileEnd = batch.offsets[i + 1];
+            continue;
+        }
+        if (tileEnd - tileStart + message.size > BATCH_TILE) flush();
+        memcpy(arena + tileEnd, message.data, message.size);
+        memcpy(tile.data() + (tileEnd - tileStart), streams[message.key].data(), message.size);
+        tileEnd += message.size;
+    }
+    flush();
+    return batch;
+}
+
+CipherBatch vigenereEncryptBatch(const CipherMessage* messages, size_t count, const string* keys, size_t keyCount) {
+    return vigenereProcessBatch(messages, count, keys, keyCount, false);
+}
+
+CipherBatch vigenereDecryptBatch(const CipherMessage* messages, size_t count, const string* keys, size_t keyCount) {
+    return vigenereProcessBatch(messages, count, keys, keyCount, true);
+}
+
+// Смена ключа: шифртекст сдвигается на разность гамм нового и старого ключей.
+// Разность строится плитками в L1, открытый текст не возникает даже в ней.
+void vigenereRekeyApply(const char* data, size_t size, const char* oldKey, size_t oldKeySize, const char* newKey,
+                        size_t newKeySize, uint64_t offset, char* out) {
+    if (oldKeySize == 0 || newKeySize == 0) throw invalid_argument("Ключ не может быть пустым");
+    const ShiftFunc shift = shiftKernels().get(size);
+    char difference[KEYSTREAM_TILE];
+    for (size_t done = 0; done < size;) {
+        size_t run = min(size - done, KEYSTREAM_TILE);
+        memset(difference, 0, run);
+        vigenereApply(difference, run, newKey, newKeySize, offset + done, false, difference);
+        vigenereApply(difference, run, oldKey, oldKeySize, offset + done, true, difference);
+        shift(reinterpret_cast<const unsigned char*>(data) + done, reinterpret_cast<const unsigned char*>(difference),
+              run, false, reinterpret_cast<unsigned char*>(out) + done);
+        done += run;
+    }
+}
+
+// Потоковая обработка: состояние - только позиция в потоке (ключ-зерно
+// и повторяющийся ключ одинаково вычисляются по позиции). Ключ не
+// копируется: бегущий ключ длиной с данные остается в отображении вызывающего.
+struct VigenereContext {
+    const char* key = nullptr;
+    size_t keySize = 0;
+    bool decrypt = false;
+    uint64_t position = 0;
+};
+
+VigenereContext* vigenereInit(const char* key, size_t keySize, bool decrypt) {
+    if (keySize == 0) throw invalid_argument("Ключ не может быть пустым");
+    return new VigenereContext{key, keySize, decrypt, 0};
+}
+
+void vigenereUpdate(VigenereContext* context, const char* data, size_t size, string& out) {
+    size_t at = out.size();
+    out.resize(at + size);
+    if (size == 0) return;
+    vigenereApply(data, size, context->key, context->keySize, context->position, context->decrypt, &out[at]);
+    context->position += size;
+}
+
+void vigenereFinal(VigenereContext* context, string&) {
+    context->position = 0; //шифр побайтный - незавершенных данных не бывает
+}
+
+void vigenereFree(VigenereContext* context) {
+    delete context;
+}
+
+vector<string> vigenereKernelNames(const string& family) {
+    if (family == "vigenere") return shiftKernels().names();
+    if (family == "vigenere-seed") return keystreamKernels().names();
+    return {};
+}
+
+bool vigenereSelectKernel(const string& family, size_t bucket, const string& name) {
+    if (family == "vigenere") return shiftKernels().select(bucket, name);
+    if (family == "vigenere-seed") return keystreamKernels().select(bucket, name);
+    return false;
+}
+
 void vigenereEncryptFile(const std::string& inputFile, const std::string& outputFile,
                         const std::string& key) {
     if (!fs::exists(inputFile)) {
@@ -85,6 +389,58 @@ void vigenereDecryptFile(const std::string& inputFile, const std::string& output
     out.write(decrypted.data(), decrypted.size());
 }
 
+// Дешифрование диапазона файла: отображаются только нужные страницы
+string vigenereDecryptFileRange(const std::string& inputFile, uint64_t offset, uint64_t length,
+                                const std::string& key) {
+    MappedFile in(inputFile, offset, length);
+    return vigenereDecryptAt(string(in.data(), in.size()), key, offset);
+}
+
+// Потоковая обработка с ключом в файле (бегущий ключ длиной с данные).
+// Данные и ключ отображаются в память и проходятся синхронно отрезками по
+// STREAM_CHUNK; пройденные страницы сразу освобождаются, так что резидентная
+// память не растет с длиной ключа, а ядро читает оба файла последовательно.
+void vigenereProcessFileKeyFile(const std::string& inputFile, const std::string& outputFile,
+                                const std::string& keyFile, bool decrypt) {
+    MappedFile in(inputFile);
+    MappedFile key(keyFile);
+    if (key.size() == 0) throw invalid_argument("Ключ не может быть пустым");
+
+    // Выход может совпадать с отображенным входом: пишем во временный файл
+    StagedFile staged(outputFile);
+    ofstream out(staged.path(), ios::binary);
+    if (!out) throw runtime_error("Ошибка: не удалось создать файл: " + outputFile);
+
+    string buffer(min(STREAM_CHUNK, in.size()), '\0');
+    for (size_t offset = 0; offset < in.size(); offset += STREAM_CHUNK) {
+        size_t n = min(STREAM_CHUNK, in.size() - offset);
+        vigenereApply(in.data() + offset, n, key.data(), key.size(), offset, decrypt, &buffer[0]);
+        out.write(buffer.data(), n);
+        if (!out) throw runtime_error("Ошибка записи в файл: " + outputFile);
+
+        in.release(offset, n);
+        if (key.size() >= STREAM_CHUNK) { //короткий повторяющийся ключ нужен целиком
+            size_t keyPos = offset % key.size();
+            size_t first = min(n, key.size() - keyPos);
+            key.release(keyPos, first);
+            if (first < n) key.release(0, n - first);
+        }
+    }
+    out.close();
+    if (!out) throw runtime_error("Ошибка записи в файл: " + outputFile);
+    staged.commit();
+}
+
+void vigenereEncryptFileKeyFile(const std::string& inputFile, const std::string& outputFile,
+                                const std::string& keyFile) {
+    vigenereProcessFileKeyFile(inputFile, outputFile, keyFile, false);
+}
+
+void vigenereDecryptFileKeyFile(const std::string& inputFile, const std::string& outputFile,
+                                const std::string& keyFile) {
+    vigenereProcessFileKeyFile(inputFile, outputFile, keyFile, true);
+}
+
 // Генерация ключа (случайные байты)
 string generateVigenereKey(int length) {
     if (length <= 0) throw invalid_argument("Длина ключа должна быть положительной");
@@ -100,6 +456,17 @@ string generateVigenereKey(int length) {
     return key;
 }
 
+// Генерация ключа-зерна для гаммы неограниченной длины
+string generateVigenereSeedKey() {
+    random_device rd;
+    string key(SEED_MAGIC, sizeof(SEED_MAGIC));
+    for (size_t i = 0; i < 16; i += 4) {
+        uint32_t word = rd();
+        key.append(reinterpret_cast<const char*>(&word), 4);
+    }
+    return key;
+}
+
 // Сохранение ключа в бинарный файл
 void saveVigenereKey(const string& key, const string& filename) {
     ofstream file(filename, ios::binary);
@@ -2,6 +2,9 @@
 #define VIGENERE_H
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include "cipher_batch.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,9 +16,77 @@ std::string vigenereEncrypt(const std::string& text, const std::string& key);
 // Дешифрование текста
 std::string vigenereDecrypt(const std::string& ciphertext, const std::string& key);
 
+// Шифрование/дешифрование фрагмента, который начинается со смещения offset
+// исходных данных (ключ применяется с позиции offset % key.size())
+__attribute__((visibility("default")))
+std::string vigenereEncryptAt(const std::string& text, const std::string& key, uint64_t offset);
+
+__attribute__((visibility("default")))
+std::string vigenereDecryptAt(const std::string& ciphertext, const std::string& key, uint64_t offset);
+
+// Ядро шифра на сырых буферах: size байтов data, стоящих со смещения offset
+// потока, сдвигаются на байты key (keySize байт) и пишутся в out (можно in-place).
+// Ключ-зерно (см. generateVigenereSeedKey) не повторяется, а разворачивается
+// в гамму: байты ключа вычисляются по позиции и нигде не хранятся.
+__attribute__((visibility("default")))
+void vigenereApply(const char* data, size_t size, const char* key, size_t keySize, uint64_t offset,
+                   bool decrypt, char* out);
+
+// Пакетное шифрование/дешифрование: сообщение i обрабатывается ключом
+// keys[messages[i].key] с позиции 0, результаты - подряд в одном буфере.
+// Короткие сообщения укладываются в буфер вплотную вместе с нужным отрезком
+// гаммы, и сдвиг выполняется одним векторным проходом по всему отрезку.
+__attribute__((visibility("default")))
+CipherBatch vigenereEncryptBatch(const CipherMessage* messages, size_t count,
+                                 const std::string* keys, size_t keyCount);
+
+__attribute__((visibility("default")))
+CipherBatch vigenereDecryptBatch(const CipherMessage* messages, size_t count,
+                                 const std::string* keys, size_t keyCount);
+
+// Смена ключа: size байтов шифртекста старого ключа со смещения offset
+// переводятся в шифртекст нового ключа за один проход (можно in-place)
+__attribute__((visibility("default")))
+void vigenereRekeyApply(const char* data, size_t size, const char* oldKey, size_t oldKeySize, const char* newKey,
+                        size_t newKeySize, uint64_t offset, char* out);
+
+// Потоковое шифрование/дешифрование: update принимает порции любого размера
+// и сразу дописывает результат в out (контекст хранит позицию в ключе);
+// final возвращает контекст в начальное состояние для следующего сообщения.
+// Результат совпадает с vigenereEncrypt/vigenereDecrypt от всего сообщения.
+// Контекст не копирует ключ: key должен жить до vigenereFree.
+struct VigenereContext;
+
+__attribute__((visibility("default")))
+VigenereContext* vigenereInit(const char* key, size_t keySize, bool decrypt);
+
+__attribute__((visibility("default")))
+void vigenereUpdate(VigenereContext* context, const char* data, size_t size, std::string& out);
+
+__attribute__((visibility("default")))
+void vigenereFinal(VigenereContext* context, std::string& out);
+
+__attribute__((visibility("default")))
+void vigenereFree(VigenereContext* context);
+
+// Варианты ядер семейства ("vigenere" - сдвиг на ключ, "vigenere-seed" -
+// генератор гаммы из зерна), доступные на этом процессоре, и выбор варианта
+// для корзины размеров (см. kernel_table.h)
+__attribute__((visibility("default")))
+std::vector<std::string> vigenereKernelNames(const std::string& family);
+
+__attribute__((visibility("default")))
+bool vigenereSelectKernel(const std::string& family, size_t bucket, const std::string& name);
+
 // Генерация ключа (случайная строка)
 std::string generateVigenereKey(int length);
 
+// Генерация ключа-зерна: 24 байта ("RGRVSEED" и 128 бит зерна). Гамма из него
+// строится счетным генератором, поэтому период не ограничен, а любой фрагмент
+// шифруется независимо (параллельно и с произвольного смещения)
+__attribute__((visibility("default")))
+std::string generateVigenereSeedKey();
+
 // Сохранение ключа в файл
 void saveVigenereKey(const std::string& key, const std::string& filename);
 
@@ -27,6 +98,21 @@ __attribute__((visibility("default")))
 void vigenereDecryptFile(const std::string& inputFile, const std::string& outputFile,
                         const std::string& key);
 
+// Дешифрование байтов [offset, offset + length) файла без чтения всего файла
+__attribute__((visibility("default")))
+std::string vigenereDecryptFileRange(const std::string& inputFile, uint64_t offset, uint64_t length,
+                                     const std::string& key);
+
+// Шифрование/дешифрование файла с ключом в файле keyFile без загрузки ключа
+// в память: данные и ключ проходятся синхронно через отображение в память
+__attribute__((visibility("default")))
+void vigenereEncryptFileKeyFile(const std::string& inputFile, const std::string& outputFile,
+                                const std::string& keyFile);
+
+__attribute__((visibility("default")))
+void vigenereDecryptFileKeyFile(const std::string& inputFile, const std::string& outputFile,
+                                const std::string& keyFile);
+
 // Загрузка ключа из файла
 std::string loadVigenereKey(const std::string& filename);
 
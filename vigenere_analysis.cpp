@@ -0,0 +1,216 @@
+#include "vigenere_analysis.h"
+#include "text_model.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include <cstdint>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Автокорреляция считается по началу данных: этого достаточно для оценки
+// периода, а время не растет с размером корпуса
+const size_t AUTOCORRELATION_SAMPLE = 64u << 20;
+// Блок данных, который остается в кэше, пока перебираются все сдвиги
+const size_t AUTOCORRELATION_BLOCK = 64u << 10;
+// Период считается найденным, если его оценка не хуже этой доли от лучшей
+const double PERIOD_THRESHOLD = 0.9;
+
+typedef uint64_t (*CountEqualFunc)(const unsigned char*, const unsigned char*, size_t);
+
+// Число позиций, где a[i] == b[i]
+uint64_t countEqualScalar(const unsigned char* a, const unsigned char* b, size_t n) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += a[i] == b[i];
+    }
+    return count;
+}
+
+#if defined(__x86_64__)
+uint64_t countEqualSse2(const unsigned char* a, const unsigned char* b, size_t n) {
+    uint64_t count = 0;
+    size_t i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= n) {
+        // Байтовые счетчики переполнятся после 255 итераций
+        __m128i acc = zero;
+        for (int iter = 0; iter < 255 && i + 16 <= n; ++iter, i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(x, y)); //совпадение = -1
+        }
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += _mm_cvtsi128_si64(sums) + _mm_extract_epi16(sums, 4);
+    }
+    return count + countEqualScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+uint64_t countEqualAvx2(const unsigned char* a, const unsigned char* b, size_t n) {
+    uint64_t count = 0;
+    size_t i = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    while (i + 32 <= n) {
+        __m256i acc = zero;
+        for (int iter = 0; iter < 255 && i + 32 <= n; ++iter, i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(x, y));
+        }
+        __m256i sums = _mm256_sad_epu8(acc, zero);
+        count += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+               + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    }
+    return count + countEqualScalar(a + i, b + i, n - i);
+}
+#endif
+
+CountEqualFunc selectCountEqual() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) return countEqualAvx2;
+    return countEqualSse2;
+#else
+    return countEqualScalar;
+#endif
+}
+
+// Доля совпадений c[i] == c[i+s] для s = 1..maxPeriod
+vector<double> autocorrelation(const unsigned char* data, size_t n, size_t maxPeriod, unsigned threads) {
+    CountEqualFunc countEqual = selectCountEqual();
+    size_t blocks = (n + AUTOCORRELATION_BLOCK - 1) / AUTOCORRELATION_BLOCK;
+    threads = resolveThreads(threads, blocks);
+
+    vector<vector<uint64_t>> partial(threads, vector<uint64_t>(maxPeriod + 1, 0));
+    parallelRanges(threads, blocks, [&](unsigned t, size_t firstBlock, size_t lastBlock) {
+        vector<uint64_t>& counts = partial[t];
+        for (size_t block = firstBlock; block < lastBlock; ++block) {
+            size_t begin = block * AUTOCORRELATION_BLOCK;
+            size_t end = min(n, begin + AUTOCORRELATION_BLOCK);
+            // блок остается в кэше, пока перебираются все сдвиги
+            for (size_t s = 1; s <= maxPeriod; ++s) {
+                size_t limit = min(end, n - s);
+                if (limit > begin) counts[s] += countEqual(data + begin, data + begin + s, limit - begin);
+            }
+        }
+    });
+
+    vector<double> coincidence(maxPeriod);
+    for (size_t s = 1; s <= maxPeriod; ++s) {
+        uint64_t total = 0;
+        for (const auto& counts : partial) total += counts[s];
+        coincidence[s - 1] = static_cast<double>(total) / (n - s);
+    }
+    return coincidence;
+}
+
+// Гистограммы байтов для каждого столбца (позиции i % period)
+vector<uint64_t> columnHistograms(const unsigned char* data, size_t size, size_t period, unsigned threads) {
+    threads = resolveThreads(threads, size / (1u << 20) + 1);
+    vector<vector<uint64_t>> partial(threads);
+
+    parallelRanges(threads, size, [&](unsigned t, size_t begin, size_t end) {
+        if (period == 1) {
+            // Четыре копии таблицы, чтобы соседние одинаковые байты
+            // не упирались в зависимость по одному счетчику
+            vector<uint64_t> copies(4 * 256, 0);
+            size_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                copies[data[i]]++;
+                copies[256 + data[i + 1]]++;
+                copies[512 + data[i + 2]]++;
+                copies[768 + data[i + 3]]++;
+            }
+            for (; i < end; ++i) copies[data[i]]++;
+            partial[t].assign(256, 0);
+            for (int c = 0; c < 4; ++c) {
+                for (int b = 0; b < 256; ++b) partial[t][b] += copies[c * 256 + b];
+            }
+            return;
+        }
+
+        vector<uint64_t>& hist = partial[t];
+        hist.assign(period * 256, 0);
+        size_t column = begin % period;
+        for (size_t i = begin; i < end; ++i) {
+            hist[column * 256 + data[i]]++;
+            if (++column == period) column = 0;
+        }
+    });
+
+    vector<uint64_t> histogram(period * 256, 0);
+    for (const auto& hist : partial) {
+        for (size_t i = 0; i < hist.size(); ++i) histogram[i] += hist[i];
+    }
+    return histogram;
+}
+
+// Байт ключа, при котором расшифровка столбца больше всего похожа на эталон
+unsigned char bestKeyByte(const uint64_t* hist, const array<double, 256>& logReference) {
+    double bestScore = -INFINITY;
+    int bestKey = 0;
+    for (int k = 0; k < 256; ++k) {
+        double score = 0;
+        for (int c = 0; c < 256; ++c) {
+            if (hist[c]) score += hist[c] * logReference[(c - k) & 0xFF]; //p = c - k mod 256
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            bestKey = k;
+        }
+    }
+    return static_cast<unsigned char>(bestKey);
+}
+
+} // namespace
+
+VigenereAnalysis vigenereAnalyze(const char* data, size_t size, size_t maxPeriod,
+                                 const string& referenceSample, unsigned threads) {
+    if (size < 2) throw invalid_argument("Недостаточно данных для анализа");
+    if (maxPeriod == 0) throw invalid_argument("Максимальный период должен быть положительным");
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t sample = min(size, AUTOCORRELATION_SAMPLE);
+    maxPeriod = min(maxPeriod, sample / 2 > 0 ? sample / 2 : 1);
+
+    VigenereAnalysis result;
+    result.coincidence = autocorrelation(bytes, sample, maxPeriod, threads);
+
+    // Для истинного периода совпадают все кратные ему сдвиги
+    result.periodScores.resize(maxPeriod);
+    double bestScore = 0;
+    for (size_t p = 1; p <= maxPeriod; ++p) {
+        double sum = 0;
+        size_t count = 0;
+        for (size_t m = p; m <= maxPeriod; m += p) {
+            sum += result.coincidence[m - 1];
+            ++count;
+        }
+        result.periodScores[p - 1] = sum / count;
+        bestScore = max(bestScore, result.periodScores[p - 1]);
+    }
+
+    // Наименьший период с оценкой около лучшей (кратные ему дают то же самое)
+    result.keyLength = 1;
+    for (size_t p = 1; p <= maxPeriod; ++p) {
+        if (result.periodScores[p - 1] >= bestScore * PERIOD_THRESHOLD) {
+            result.keyLength = p;
+            break;
+        }
+    }
+
+    array<double, 256> logReference = textmodel::byteLogProbabilities(referenceSample);
+    vector<uint64_t> histogram = columnHistograms(bytes, size, result.keyLength, threads);
+    result.key.resize(result.keyLength);
+    for (size_t j = 0; j < result.keyLength; ++j) {
+        result.key[j] = static_cast<char>(bestKeyByte(&histogram[j * 256], logReference));
+    }
+    return result;
+}
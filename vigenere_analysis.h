@@ -0,0 +1,32 @@
+#ifndef VIGENERE_ANALYSIS_H
+#define VIGENERE_ANALYSIS_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Результат анализа шифртекста Виженера
+struct VigenereAnalysis {
+    size_t keyLength = 0;              // оценка длины ключа
+    std::string key;                   // восстановленный ключ (байты, как в saveVigenereKey)
+    std::vector<double> coincidence;   // доля c[i] == c[i+s] для сдвига s (индекс s-1)
+    std::vector<double> periodScores;  // средняя доля совпадений на кратных периода (индекс p-1)
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Оценка длины ключа автокорреляцией и восстановление байтов ключа
+// частотным анализом столбцов. referenceSample - образец открытого текста
+// для эталонного распределения байтов (пустой - встроенное распределение
+// русского и английского текста в UTF-8). threads = 0 - по числу ядер.
+__attribute__((visibility("default")))
+VigenereAnalysis vigenereAnalyze(const char* data, size_t size, size_t maxPeriod,
+                                 const std::string& referenceSample, unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VIGENERE_ANALYSIS_H